@@ -0,0 +1,99 @@
+/**
+ * @file benchmarks/fec_setup.cpp
+ * @brief Definitions for the Reed-Solomon codec setup benchmark.
+ */
+// standard includes
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// local includes
+#include "fec_setup.h"
+#include <src/rs_cache.h>
+
+namespace bench {
+  namespace {
+    // The most data and parity shards a Reed-Solomon codec supports
+    constexpr std::size_t DATA_SHARDS_MAX = 255;
+
+    // What Moonlight asks for, and what the benchmark's sessions use
+    constexpr std::size_t MIN_PARITY_SHARDS = 2;
+
+    // Same as the stream's codec cache
+    constexpr std::size_t CACHE_CAPACITY = 32;
+
+    /**
+     * @brief Split the packets of a frame into FEC blocks the way the video sender does.
+     * @return The number of data and parity shards of each block.
+     */
+    std::vector<std::pair<int, int>>
+    fec_blocks(std::size_t packets, std::size_t fec_percentage) {
+      std::vector<std::pair<int, int>> blocks;
+
+      auto max_data_shards = (DATA_SHARDS_MAX * 100) / (100 + fec_percentage);
+      auto block_count = (packets + max_data_shards - 1) / max_data_shards;
+      for (std::size_t x = 0; x < block_count; ++x) {
+        auto data_shards = packets * (x + 1) / block_count - packets * x / block_count;
+        auto parity_shards = std::max((data_shards * fec_percentage + 99) / 100, MIN_PARITY_SHARDS);
+
+        blocks.emplace_back((int) data_shards, (int) parity_shards);
+      }
+
+      return blocks;
+    }
+
+    template <class F>
+    double
+    time_us(F &&f) {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+  }  // namespace
+
+  fec_setup_result_t
+  run_fec_setup(int fec_percentage, std::size_t frames) {
+    // Frames of about 20 Mbps at 60 fps, with a keyframe of several times the size every 2 seconds
+    std::mt19937 random { 0 };
+    std::normal_distribution<double> frame_packets { 30.0, 10.0 };
+
+    std::vector<std::pair<int, int>> blocks;
+    for (std::size_t x = 0; x < frames; ++x) {
+      auto packets = x % 120 == 0 ? 400 : std::clamp((int) frame_packets(random), 1, 200);
+      for (auto &block : fec_blocks(packets, fec_percentage)) {
+        blocks.emplace_back(block);
+      }
+    }
+
+    std::vector<double> uncached;
+    for (auto &[data_shards, parity_shards] : blocks) {
+      uncached.emplace_back(time_us([&, data_shards = data_shards, parity_shards = parity_shards]() {
+        auto rs = reed_solomon_new(data_shards, parity_shards);
+        if (rs) {
+          reed_solomon_release(rs);
+        }
+      }));
+    }
+
+    rs_cache::cache_t cache { CACHE_CAPACITY };
+    std::vector<double> cached;
+    for (auto &[data_shards, parity_shards] : blocks) {
+      cached.emplace_back(time_us([&, data_shards = data_shards, parity_shards = parity_shards]() {
+        cache.get(data_shards, parity_shards);
+      }));
+    }
+
+    auto stats = cache.stats();
+
+    fec_setup_result_t result {};
+    result.blocks = blocks.size();
+    result.geometries = std::set<std::pair<int, int>>(std::begin(blocks), std::end(blocks)).size();
+    result.uncached = percentiles(std::move(uncached));
+    result.cached = percentiles(std::move(cached));
+    result.hit_rate = blocks.empty() ? 0.0 : (double) stats.hits / blocks.size();
+
+    return result;
+  }
+}  // namespace bench
@@ -0,0 +1,36 @@
+/**
+ * @file benchmarks/fec_setup.h
+ * @brief Declarations for the Reed-Solomon codec setup benchmark.
+ */
+#pragma once
+
+// standard includes
+#include <cstdint>
+
+// local includes
+#include "pipeline.h"
+
+namespace bench {
+  /**
+   * @brief Measurements of the codec setup of each FEC block.
+   */
+  struct fec_setup_result_t {
+    std::uint64_t blocks;  ///< FEC blocks set up by each method
+    std::uint64_t geometries;  ///< Distinct shard geometries among the blocks
+    percentiles_t uncached;  ///< Setup time of a new codec for every block, in microseconds
+    percentiles_t cached;  ///< Setup time of a codec from `rs_cache`, in microseconds
+    double hit_rate;  ///< Share of the blocks whose codec was cached
+  };
+
+  /**
+   * @brief Time the Reed-Solomon codec setup of the FEC blocks of a simulated stream.
+   * @details The frame sizes vary like those of a stream, with a large frame every few seconds. Each block's codec
+   * is set up once with `reed_solomon_new()` and released right away, as before codecs were cached, and once
+   * through a cache with the same capacity as the stream's. No parity is generated.
+   * @param fec_percentage The FEC percentage of the stream.
+   * @param frames The number of frames to simulate.
+   * @return The measurements.
+   */
+  fec_setup_result_t
+  run_fec_setup(int fec_percentage, std::size_t frames);
+}  // namespace bench
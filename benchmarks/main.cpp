@@ -0,0 +1,477 @@
+/**
+ * @file benchmarks/main.cpp
+ * @brief Entry point of the streaming pipeline benchmark.
+ */
+// standard includes
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// local includes
+#include "fec_setup.h"
+#include "pipeline.h"
+#include "send.h"
+#include <src/config.h>
+#include <src/globals.h>
+#include <src/input.h>
+#include <src/logging.h>
+#include <src/platform/common.h>
+#include <src/utility.h>
+#include <src/video.h>
+
+extern "C" {
+#include <src/rswrapper.h>
+}
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief The options of the benchmark, each list is a dimension of the matrix.
+   */
+  struct options_t {
+    std::vector<std::string> benchmarks { "pipeline" };
+
+    std::vector<std::pair<int, int>> resolutions { { 1280, 720 }, { 1920, 1080 } };
+    std::vector<int> video_formats { 0 };
+    std::vector<int> fec_percentages { 20 };
+    std::vector<int> sessions { 1 };
+    std::vector<bool> encryption { false };
+    std::vector<std::string> send_backends { "sendmsg" };
+    std::vector<bool> gso { true };
+
+    int framerate = 60;
+    int bitrate = 20000;
+    std::chrono::seconds warmup = 2s;
+    std::chrono::seconds duration = 10s;
+    std::string pattern = "gradient";
+    int port = config::sunshine.port;
+    int min_log_level = 3;
+  };
+
+  constexpr std::string_view codec_names[] { "h264"sv, "hevc"sv, "av1"sv };
+  constexpr std::string_view benchmark_names[] { "pipeline"sv, "send"sv, "fec-setup"sv };
+  constexpr std::string_view send_backend_names[] { "sendmsg"sv, "io_uring"sv };
+
+  void
+  print_help(const char *name) {
+    std::cout
+      << "Usage: "sv << name << " [options]"sv << std::endl
+      << std::endl
+      << "pipeline: Streams the synthetic display to clients on the loopback interface using the software encoder,"sv << std::endl
+      << "and reports the latency of each pipeline stage, the frame rate and the CPU time per frame."sv << std::endl
+      << "The send backends and GSO settings are dimensions of the pipeline matrix too."sv << std::endl
+      << "send: Sends batches of video-sized packets on the loopback interface as fast as possible,"sv << std::endl
+      << "and reports the packets and bytes handed to the kernel per second."sv << std::endl
+      << "fec-setup: Sets up the Reed-Solomon codecs of the FEC blocks of a simulated minute of video,"sv << std::endl
+      << "with a new codec for every block and through the codec cache, and reports both setup times."sv << std::endl
+      << "Every combination of the listed values is measured."sv << std::endl
+      << std::endl
+      << "Options:"sv << std::endl
+      << "  --run=NAME,...          pipeline, send and/or fec-setup [pipeline]"sv << std::endl
+      << "  --resolutions=WxH,...   Stream resolutions [1280x720,1920x1080]"sv << std::endl
+      << "  --codecs=NAME,...       h264, hevc and/or av1 [h264]"sv << std::endl
+      << "  --fec=PERCENT,...       FEC percentages [20]"sv << std::endl
+      << "  --sessions=N,...        Number of concurrent sessions [1]"sv << std::endl
+      << "  --encryption=MODE       off, on or both [off]"sv << std::endl
+      << "  --backends=NAME,...     Send backends, sendmsg and/or io_uring, Linux only [sendmsg]"sv << std::endl
+      << "  --gso=MODE              UDP GSO off, on or both, Linux only [on]"sv << std::endl
+      << "  --fps=N                 Frame rate [60]"sv << std::endl
+      << "  --bitrate=KBPS          Bitrate of each session [20000]"sv << std::endl
+      << "  --warmup=SECONDS        Time to stream before measuring [2]"sv << std::endl
+      << "  --duration=SECONDS      Time to measure each combination [10]"sv << std::endl
+      << "  --pattern=NAME          Synthetic display test pattern [gradient]"sv << std::endl
+      << "  --port=PORT             Base port, the stream uses the same offsets as Sunshine ["sv << config::sunshine.port << ']' << std::endl
+      << "  --min-log-level=N       0 - verbose ... 5 - fatal [3]"sv << std::endl
+      << "  --help                  Show this help"sv << std::endl
+      << std::endl
+      << "Stages, in milliseconds:"sv << std::endl
+      << "  capture   Age of a captured frame when the encoder picks it up"sv << std::endl
+      << "  convert   Color conversion of a frame"sv << std::endl
+      << "  encode    Encoding of a frame"sv << std::endl
+      << "  fec       Parity generation of each FEC block"sv << std::endl
+      << "  encrypt   Encryption of each FEC block"sv << std::endl
+      << "  pacing    How far past its deadline the pacing timer woke, each time the sender waits for it"sv << std::endl
+      << "  send      Each batch of packets handed to the kernel"sv << std::endl
+      << "  receive   Time between the first and last packet of a frame at the client"sv << std::endl
+      << "  host      Time from capture until the frame is packetized"sv << std::endl;
+  }
+
+  /**
+   * @brief Parse the values an on/off dimension takes.
+   */
+  std::vector<bool>
+  parse_toggle(const std::string &value) {
+    if (value == "off"sv) {
+      return { false };
+    }
+    if (value == "on"sv) {
+      return { true };
+    }
+    if (value == "both"sv) {
+      return { false, true };
+    }
+
+    throw std::invalid_argument { value };
+  }
+
+  std::vector<std::string>
+  split(const std::string &list) {
+    std::vector<std::string> items;
+
+    std::stringstream stream { list };
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+      if (!item.empty()) {
+        items.emplace_back(std::move(item));
+      }
+    }
+
+    return items;
+  }
+
+  /**
+   * @brief Parse the command line.
+   * @return The options, or `std::nullopt` if the benchmark shouldn't run.
+   */
+  std::optional<options_t>
+  parse(int argc, char *argv[]) {
+    options_t options;
+
+    for (auto x = 1; x < argc; ++x) {
+      std::string_view arg { argv[x] };
+      if (arg == "--help"sv) {
+        print_help(argv[0]);
+        return std::nullopt;
+      }
+
+      auto separator = arg.find('=');
+      if (arg.substr(0, 2) != "--"sv || separator == std::string_view::npos) {
+        std::cerr << "Invalid argument: "sv << arg << std::endl;
+        return std::nullopt;
+      }
+
+      auto name = arg.substr(2, separator - 2);
+      auto value = std::string { arg.substr(separator + 1) };
+
+      try {
+        if (name == "run"sv) {
+          options.benchmarks = split(value);
+          for (auto &benchmark : options.benchmarks) {
+            if (std::find(std::begin(benchmark_names), std::end(benchmark_names), benchmark) == std::end(benchmark_names)) {
+              throw std::invalid_argument { benchmark };
+            }
+          }
+        }
+        else if (name == "resolutions"sv) {
+          options.resolutions.clear();
+          for (auto &resolution : split(value)) {
+            auto x_pos = resolution.find('x');
+            if (x_pos == std::string::npos) {
+              throw std::invalid_argument { resolution };
+            }
+
+            options.resolutions.emplace_back(std::stoi(resolution.substr(0, x_pos)), std::stoi(resolution.substr(x_pos + 1)));
+          }
+        }
+        else if (name == "codecs"sv) {
+          options.video_formats.clear();
+          for (auto &codec : split(value)) {
+            auto it = std::find(std::begin(codec_names), std::end(codec_names), codec);
+            if (it == std::end(codec_names)) {
+              throw std::invalid_argument { codec };
+            }
+
+            options.video_formats.emplace_back(it - std::begin(codec_names));
+          }
+        }
+        else if (name == "fec"sv) {
+          options.fec_percentages.clear();
+          for (auto &percentage : split(value)) {
+            options.fec_percentages.emplace_back(std::stoi(percentage));
+          }
+        }
+        else if (name == "sessions"sv) {
+          options.sessions.clear();
+          for (auto &sessions : split(value)) {
+            options.sessions.emplace_back(std::stoi(sessions));
+          }
+        }
+        else if (name == "encryption"sv) {
+          options.encryption = parse_toggle(value);
+        }
+        else if (name == "backends"sv) {
+          options.send_backends = split(value);
+          for (auto &send_backend : options.send_backends) {
+            if (std::find(std::begin(send_backend_names), std::end(send_backend_names), send_backend) == std::end(send_backend_names)) {
+              throw std::invalid_argument { send_backend };
+            }
+          }
+        }
+        else if (name == "gso"sv) {
+          options.gso = parse_toggle(value);
+        }
+        else if (name == "fps"sv) {
+          options.framerate = std::stoi(value);
+        }
+        else if (name == "bitrate"sv) {
+          options.bitrate = std::stoi(value);
+        }
+        else if (name == "warmup"sv) {
+          options.warmup = std::chrono::seconds { std::stoi(value) };
+        }
+        else if (name == "duration"sv) {
+          options.duration = std::chrono::seconds { std::stoi(value) };
+        }
+        else if (name == "pattern"sv) {
+          options.pattern = value;
+        }
+        else if (name == "port"sv) {
+          options.port = std::stoi(value);
+        }
+        else if (name == "min-log-level"sv) {
+          options.min_log_level = std::stoi(value);
+        }
+        else {
+          std::cerr << "Unknown option: "sv << name << std::endl;
+          return std::nullopt;
+        }
+      }
+      catch (const std::exception &) {
+        std::cerr << "Invalid value for "sv << name << ": "sv << value << std::endl;
+        return std::nullopt;
+      }
+    }
+
+    if (options.benchmarks.empty() || options.resolutions.empty() || options.video_formats.empty() || options.fec_percentages.empty() ||
+        options.sessions.empty() || options.send_backends.empty()) {
+      std::cerr << "Every dimension of the matrix needs at least one value"sv << std::endl;
+      return std::nullopt;
+    }
+
+    return options;
+  }
+
+  bool
+  is_codec_enabled(int video_format) {
+    switch (video_format) {
+      case 1:
+        return video::active_hevc_mode != 1;
+      case 2:
+        return video::active_av1_mode != 1;
+      default:
+        return true;
+    }
+  }
+
+  void
+  print_result(const bench::case_t &bench_case, const bench::result_t &result) {
+    std::cout
+      << std::fixed << std::setprecision(2)
+      << bench_case.width << 'x' << bench_case.height << ' ' << codec_names[bench_case.video_format]
+      << ", FEC "sv << bench_case.fec_percentage << '%'
+      << ", "sv << bench_case.sessions << (bench_case.sessions == 1 ? " session"sv : " sessions"sv)
+      << (bench_case.encryption ? ", encrypted"sv : ""sv)
+      << ", "sv << bench_case.send_backend << (bench_case.gso ? ""sv : " without GSO"sv) << std::endl
+      << "  "sv << result.fps << " fps, "sv << result.cpu_per_frame << " ms CPU per frame, "sv
+      << result.bytes * 8 / 1000.0 / std::max(result.frames, (std::uint64_t) 1) << " kbit per frame"sv << std::endl
+      << "  "sv << std::left << std::setw(10) << "stage"sv << std::right
+      << std::setw(10) << "samples"sv << std::setw(10) << "p50"sv << std::setw(10) << "p90"sv
+      << std::setw(10) << "p99"sv << std::setw(10) << "max"sv << std::endl;
+
+    // Pacing overshoot is in the microseconds
+    std::cout << std::setprecision(3);
+    for (auto &stage : bench::stage_names) {
+      auto &p = result.stages.at(stage);
+      std::cout
+        << "  "sv << std::left << std::setw(10) << stage << std::right
+        << std::setw(10) << p.samples << std::setw(10) << p.p50 << std::setw(10) << p.p90
+        << std::setw(10) << p.p99 << std::setw(10) << p.max << std::endl;
+    }
+
+    std::cout << std::endl;
+  }
+
+  void
+  print_send_result(const bench::send_case_t &send_case, const bench::send_result_t &result) {
+    auto seconds = std::max(result.seconds, 1e-9);
+
+    std::cout
+      << std::fixed << std::setprecision(2)
+      << send_case.send_backend << ", GSO "sv << (send_case.gso ? "on"sv : "off"sv) << std::endl
+      << "  "sv << result.packets / seconds << " packets/s, "sv << result.bytes / seconds / 1e6 << " MB/s sent"sv << std::endl
+      << "  "sv << result.received_packets / seconds << " packets/s, "sv << result.received_bytes / seconds / 1e6 << " MB/s received"sv << std::endl
+      << "  "sv << result.cpu_per_packet << " us CPU per packet, "sv << result.stalls << " stalls"sv << std::endl
+      << std::endl;
+  }
+
+  void
+  print_fec_setup_result(int fec_percentage, const bench::fec_setup_result_t &result) {
+    std::cout
+      << std::fixed << std::setprecision(2)
+      << "FEC "sv << fec_percentage << "%, "sv << result.blocks << " blocks with "sv << result.geometries << " shard geometries, "sv
+      << result.hit_rate * 100 << "% cache hits"sv << std::endl
+      << "  "sv << std::left << std::setw(10) << "setup"sv << std::right
+      << std::setw(10) << "p50"sv << std::setw(10) << "p90"sv << std::setw(10) << "p99"sv << std::setw(10) << "max"sv
+      << "  (us)"sv << std::endl;
+
+    for (auto &[name, p] : { std::pair { "uncached"sv, result.uncached }, std::pair { "cached"sv, result.cached } }) {
+      std::cout
+        << "  "sv << std::left << std::setw(10) << name << std::right
+        << std::setw(10) << p.p50 << std::setw(10) << p.p90 << std::setw(10) << p.p99 << std::setw(10) << p.max << std::endl;
+    }
+
+    std::cout << std::endl;
+  }
+
+  bool
+  should_run(const options_t &options, std::string_view benchmark) {
+    return std::find(std::begin(options.benchmarks), std::end(options.benchmarks), benchmark) != std::end(options.benchmarks);
+  }
+
+  /**
+   * @brief Get every combination of send backend and GSO setting to measure.
+   */
+  std::vector<bench::send_case_t>
+  send_cases(const options_t &options) {
+    std::vector<bench::send_case_t> send_cases;
+    for (auto &send_backend : options.send_backends) {
+      for (auto gso : options.gso) {
+        // Without GSO, batches go out with sendmmsg() no matter the backend
+        if (send_backend == "io_uring"sv && !gso) {
+          std::cout << "io_uring only sends GSO batches, skipping io_uring without GSO"sv << std::endl
+                    << std::endl;
+          continue;
+        }
+
+        send_cases.push_back(bench::send_case_t { send_backend, gso });
+      }
+    }
+
+    return send_cases;
+  }
+
+  /**
+   * @brief Measure the send throughput of every send backend.
+   * @return 0 on success, 1 if a case couldn't run.
+   */
+  int
+  run_send_benchmark(const options_t &options) {
+    auto status = 0;
+    for (auto &send_case : send_cases(options)) {
+      auto result = bench::run_send(send_case, options.duration);
+      if (!result) {
+        status = 1;
+        continue;
+      }
+
+      print_send_result(send_case, *result);
+    }
+
+    return status;
+  }
+}  // namespace
+
+int
+main(int argc, char *argv[]) {
+  mail::man = std::make_shared<safe::mail_raw_t>();
+
+  auto options = parse(argc, argv);
+  if (!options) {
+    return 1;
+  }
+
+  config::sunshine.min_log_level = options->min_log_level;
+  config::sunshine.port = options->port;
+  config::sunshine.address_family = "ipv4";
+
+  // Measure the same work for every run
+  config::video.capture = "synthetic";
+  config::video.encoder = "software";
+  config::video.output_name = options->pattern;
+  config::stream.adaptive_fec = false;
+  config::stream.adaptive_bitrate = false;
+
+  auto log_deinit_guard = logging::init(config::sunshine.min_log_level, "sunshine_bench.log");
+  if (!log_deinit_guard) {
+    std::cerr << "Logging failed to initialize"sv << std::endl;
+  }
+
+  task_pool.start(1);
+  auto task_pool_fg = util::fail_guard([]() {
+    task_pool.stop();
+    task_pool.join();
+  });
+
+  auto platf_deinit_guard = platf::init();
+  if (!platf_deinit_guard) {
+    BOOST_LOG(error) << "Platform failed to initialize"sv;
+  }
+
+  reed_solomon_init();
+  auto input_deinit_guard = input::init();
+
+  auto status = 0;
+  if (should_run(*options, "fec-setup"sv)) {
+    // A minute of video at 60 fps
+    for (auto fec_percentage : options->fec_percentages) {
+      print_fec_setup_result(fec_percentage, bench::run_fec_setup(fec_percentage, 60 * 60));
+    }
+  }
+
+  if (should_run(*options, "send"sv)) {
+    status = run_send_benchmark(*options);
+  }
+
+  if (!should_run(*options, "pipeline"sv)) {
+    return status;
+  }
+
+  if (video::probe_encoders()) {
+    BOOST_LOG(fatal) << "The software encoder can't encode the synthetic display"sv;
+    return 1;
+  }
+
+  auto pipeline_send_cases = send_cases(*options);
+  for (auto &[width, height] : options->resolutions) {
+    for (auto video_format : options->video_formats) {
+      if (!is_codec_enabled(video_format)) {
+        std::cout << codec_names[video_format] << " is not supported by the software encoder, skipping"sv << std::endl
+                  << std::endl;
+        continue;
+      }
+
+      for (auto fec_percentage : options->fec_percentages) {
+        for (auto sessions : options->sessions) {
+          for (auto encryption : options->encryption) {
+            for (auto &send_case : pipeline_send_cases) {
+              bench::case_t bench_case {
+                width,
+                height,
+                options->framerate,
+                options->bitrate,
+                video_format,
+                fec_percentage,
+                sessions,
+                encryption,
+                send_case.send_backend,
+                send_case.gso,
+              };
+
+              auto result = bench::run(bench_case, options->warmup, options->duration);
+              if (!result) {
+                BOOST_LOG(error) << "Couldn't run the benchmark, the ports may be in use. Try another --port."sv;
+                status = 1;
+                continue;
+              }
+
+              print_result(bench_case, *result);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return status;
+}
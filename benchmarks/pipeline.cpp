@@ -0,0 +1,401 @@
+/**
+ * @file benchmarks/pipeline.cpp
+ * @brief Definitions for the end-to-end streaming pipeline benchmark.
+ */
+// standard includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// lib includes
+#include <boost/asio.hpp>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/resource.h>
+#endif
+
+extern "C" {
+// clang-format off
+#include <moonlight-common-c/src/Limelight-internal.h>
+// clang-format on
+}
+
+// local includes
+#include "pipeline.h"
+#include <src/config.h>
+#include <src/crypto.h>
+#include <src/logging.h>
+#include <src/network.h>
+#include <src/rtsp.h>
+#include <src/stream.h>
+#include <src/utility.h>
+
+using namespace std::literals;
+
+namespace bench {
+  namespace asio = boost::asio;
+  using udp = asio::ip::udp;
+
+  const std::vector<std::string> stage_names {
+    "capture",
+    "convert",
+    "encode",
+    "fec",
+    "encrypt",
+    "pacing",
+    "send",
+    "receive",
+    "host",
+  };
+
+  namespace {
+    /**
+     * @brief A periodic logger of the streaming pipeline, and the stage it measures.
+     */
+    struct stage_logger_t {
+      std::string_view message;
+      std::string_view stage;
+      double to_ms;  ///< Factor converting the logged values to milliseconds
+    };
+
+    /**
+     * @brief The periodic loggers of the streaming pipeline.
+     * @details `capture` is the age of a captured frame when the encoder picks it up, `pacing` how far past its
+     * deadline the pacing timer woke, and `host` the time from capture until the frame is packetized, as reported
+     * to the client.
+     */
+    constexpr stage_logger_t stage_loggers[] {
+      { "Video: capture to encode latency"sv, "capture"sv, 1.0 },
+      { "Video: convert latency"sv, "convert"sv, 1.0 },
+      { "Video: encode latency"sv, "encode"sv, 1.0 },
+      { "Network: each FEC block latency"sv, "fec"sv, 1.0 },
+      { "Network: each FEC block encryption latency"sv, "encrypt"sv, 1.0 },
+      { "Network: pacing timer overshoot"sv, "pacing"sv, 0.001 },
+      { "Network: each send_batch() latency"sv, "send"sv, 1.0 },
+      { "Frame processing latency"sv, "host"sv, 1.0 },
+    };
+
+    /**
+     * @brief Collects the latency samples of all stages, from any thread.
+     */
+    class collector_t {
+    public:
+      void
+      collect_logger(std::string_view message, double value) {
+        for (auto &logger : stage_loggers) {
+          if (message == logger.message) {
+            collect(logger.stage, value * logger.to_ms);
+            return;
+          }
+        }
+      }
+
+      void
+      collect(std::string_view stage, double value) {
+        std::lock_guard lg { mutex };
+        samples[std::string { stage }].push_back(value);
+      }
+
+      void
+      reset() {
+        std::lock_guard lg { mutex };
+        samples.clear();
+      }
+
+      std::map<std::string, std::vector<double>>
+      take() {
+        std::lock_guard lg { mutex };
+        return std::move(samples);
+      }
+
+    private:
+      std::mutex mutex;
+      std::map<std::string, std::vector<double>> samples;
+    };
+
+    /**
+     * @brief A minimal client for a single session.
+     * @details It pings the video and audio ports like Moonlight does, so the session starts streaming to it,
+     * and counts the video frames it receives. Audio is not read.
+     */
+    class receiver_t {
+    public:
+      receiver_t(asio::io_context &io, collector_t &collector, std::string ping_payload, bool encrypted):
+          video_sock { io, udp::endpoint { asio::ip::address_v4::loopback(), 0 } },
+          audio_sock { io, udp::endpoint { asio::ip::address_v4::loopback(), 0 } },
+          ping_timer { io },
+          collector { collector },
+          ping_payload { std::move(ping_payload) },
+          encrypted { encrypted } {
+        video_sock.set_option(asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+        ping();
+        receive();
+      }
+
+      /**
+       * @brief Start counting from zero.
+       */
+      void
+      reset() {
+        frames = 0;
+        bytes = 0;
+      }
+
+      std::atomic_uint64_t frames = 0;
+      std::atomic_uint64_t bytes = 0;
+
+    private:
+      void
+      ping() {
+        SS_PING packet {};
+        std::copy_n(ping_payload.data(), std::min(ping_payload.size(), sizeof(packet.payload)), packet.payload);
+        packet.sequenceNumber = util::endian::big(++ping_sequence_number);
+
+        auto loopback = asio::ip::address_v4::loopback();
+        boost::system::error_code ec;
+        video_sock.send_to(asio::buffer(&packet, sizeof(packet)), udp::endpoint { loopback, net::map_port(stream::VIDEO_STREAM_PORT) }, 0, ec);
+        audio_sock.send_to(asio::buffer(&packet, sizeof(packet)), udp::endpoint { loopback, net::map_port(stream::AUDIO_STREAM_PORT) }, 0, ec);
+
+        // Moonlight keeps pinging while streaming, and so do we
+        ping_timer.expires_after(500ms);
+        ping_timer.async_wait([this](const boost::system::error_code &ec) {
+          if (!ec) {
+            ping();
+          }
+        });
+      }
+
+      void
+      receive() {
+        video_sock.async_receive(asio::buffer(buffer), [this](const boost::system::error_code &ec, std::size_t size) {
+          if (ec == asio::error::operation_aborted) {
+            return;
+          }
+
+          if (!ec) {
+            on_packet(size);
+          }
+
+          receive();
+        });
+      }
+
+      void
+      on_packet(std::size_t size) {
+        std::uint32_t frame_index;
+        if (encrypted) {
+          // The frame number is the only part of an encrypted packet that's sent in the clear
+          constexpr auto offset = 12;
+          if (size < offset + sizeof(frame_index)) {
+            return;
+          }
+
+          std::memcpy(&frame_index, buffer.data() + offset, sizeof(frame_index));
+        }
+        else {
+          // RTP header and 4 reserved bytes, followed by the video packet header
+          constexpr auto offset = sizeof(RTP_PACKET) + 4;
+          if (size < offset + sizeof(NV_VIDEO_PACKET)) {
+            return;
+          }
+
+          NV_VIDEO_PACKET video_packet;
+          std::memcpy(&video_packet, buffer.data() + offset, sizeof(video_packet));
+          frame_index = video_packet.frameIndex;
+        }
+
+        // The time between the first and the last packet of a frame is how long the client waits for it
+        auto now = std::chrono::steady_clock::now();
+        if (!current_frame || *current_frame != frame_index) {
+          if (current_frame) {
+            collector.collect("receive"sv, std::chrono::duration<double, std::milli>(last_packet - first_packet).count());
+          }
+
+          current_frame = frame_index;
+          first_packet = now;
+          ++frames;
+        }
+        last_packet = now;
+        bytes += size;
+      }
+
+      udp::socket video_sock;
+      udp::socket audio_sock;
+      asio::steady_timer ping_timer;
+
+      collector_t &collector;
+      std::string ping_payload;
+      bool encrypted;
+      std::uint32_t ping_sequence_number = 0;
+
+      std::array<char, 2048> buffer;
+      std::optional<std::uint32_t> current_frame;
+      std::chrono::steady_clock::time_point first_packet;
+      std::chrono::steady_clock::time_point last_packet;
+    };
+  }  // namespace
+
+  std::chrono::duration<double, std::milli>
+  process_cpu_time() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+      return {};
+    }
+
+    auto to_100ns = [](const FILETIME &time) {
+      return ((std::uint64_t) time.dwHighDateTime << 32) | time.dwLowDateTime;
+    };
+    return std::chrono::duration<double, std::ratio<1, 10'000'000>>(to_100ns(kernel) + to_100ns(user));
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+      return {};
+    }
+
+    auto to_us = [](const timeval &time) {
+      return (std::uint64_t) time.tv_sec * 1'000'000 + time.tv_usec;
+    };
+    return std::chrono::microseconds(to_us(usage.ru_utime) + to_us(usage.ru_stime));
+#endif
+  }
+
+  percentiles_t
+  percentiles(std::vector<double> samples) {
+    if (samples.empty()) {
+      return {};
+    }
+
+    std::sort(std::begin(samples), std::end(samples));
+
+    // Nearest-rank percentile
+    auto rank = [&samples](double p) {
+      auto index = (std::size_t) std::ceil(p * samples.size());
+      return samples[std::clamp<std::size_t>(index, 1, samples.size()) - 1];
+    };
+
+    return {
+      samples.size(),
+      rank(0.5),
+      rank(0.9),
+      rank(0.99),
+      samples.back(),
+    };
+  }
+
+  std::optional<result_t>
+  run(const case_t &bench_case, std::chrono::seconds warmup, std::chrono::seconds duration) {
+    auto config_fg = util::fail_guard([stream = config::stream]() {
+      config::stream = stream;
+    });
+    config::stream.fec_percentage = bench_case.fec_percentage;
+    config::stream.send_backend = bench_case.send_backend;
+    config::stream.udp_gso = bench_case.gso;
+
+    // The clients never connect to the control stream, so the sessions must not time out waiting for it
+    config::stream.ping_timeout = warmup + duration + 10s;
+
+    collector_t collector;
+    logging::set_periodic_observer([&collector](std::string_view message, double value) {
+      collector.collect_logger(message, value);
+    });
+    auto observer_fg = util::fail_guard([]() {
+      logging::set_periodic_observer(nullptr);
+    });
+
+    asio::io_context io;
+    std::vector<std::unique_ptr<receiver_t>> receivers;
+    std::vector<std::shared_ptr<stream::session_t>> sessions;
+
+    std::thread io_thread;
+    auto fg = util::fail_guard([&]() {
+      for (auto &session : sessions) {
+        stream::session::stop(*session);
+      }
+      for (auto &session : sessions) {
+        stream::session::join(*session);
+      }
+
+      io.stop();
+      if (io_thread.joinable()) {
+        io_thread.join();
+      }
+    });
+
+    for (auto x = 0; x < bench_case.sessions; ++x) {
+      rtsp_stream::launch_session_t launch_session {};
+      launch_session.id = x + 1;
+
+      auto gcm_key = crypto::rand(16);
+      auto iv = crypto::rand(16);
+      launch_session.gcm_key.assign(std::begin(gcm_key), std::end(gcm_key));
+      launch_session.iv.assign(std::begin(iv), std::end(iv));
+      launch_session.av_ping_payload = util::hex_vec(crypto::rand(8));
+
+      // What Moonlight asks for by default, for a stereo stream
+      stream::config_t config {};
+      config.audio.channels = 2;
+      config.audio.mask = 0x3;
+      config.audio.packetDuration = 5;
+      config.monitor.width = bench_case.width;
+      config.monitor.height = bench_case.height;
+      config.monitor.framerate = bench_case.framerate;
+      config.monitor.bitrate = bench_case.bitrate;
+      config.monitor.slicesPerFrame = 1;
+      config.monitor.numRefFrames = 0;
+      config.monitor.videoFormat = bench_case.video_format;
+      config.packetsize = 1392;
+      config.minRequiredFecPackets = 2;
+      config.mlFeatureFlags = ML_FF_SESSION_ID_V1;
+      config.controlProtocolType = 1;
+      config.encryptionFlagsEnabled = bench_case.encryption ? SS_ENC_VIDEO : 0;
+
+      auto session = stream::session::alloc(config, launch_session);
+      if (stream::session::start(*session, "127.0.0.1"s)) {
+        BOOST_LOG(error) << "Couldn't start session "sv << x + 1;
+        return std::nullopt;
+      }
+      sessions.emplace_back(std::move(session));
+
+      receivers.emplace_back(std::make_unique<receiver_t>(io, collector, launch_session.av_ping_payload, bench_case.encryption));
+    }
+
+    io_thread = std::thread { [&io]() {
+      io.run();
+    } };
+
+    std::this_thread::sleep_for(warmup);
+
+    collector.reset();
+    for (auto &receiver : receivers) {
+      receiver->reset();
+    }
+    auto cpu_start = process_cpu_time();
+    auto start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(duration);
+
+    result_t result {};
+    for (auto &receiver : receivers) {
+      result.frames += receiver->frames;
+      result.bytes += receiver->bytes;
+    }
+    auto cpu_time = process_cpu_time() - cpu_start;
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    auto samples = collector.take();
+
+    result.fps = result.frames / elapsed.count();
+    result.cpu_per_frame = result.frames ? cpu_time.count() / result.frames : 0.0;
+    for (auto &stage : stage_names) {
+      result.stages[stage] = percentiles(std::move(samples[stage]));
+    }
+
+    return result;
+  }
+}  // namespace bench
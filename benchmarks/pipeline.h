@@ -0,0 +1,85 @@
+/**
+ * @file benchmarks/pipeline.h
+ * @brief Declarations for the end-to-end streaming pipeline benchmark.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace bench {
+  /**
+   * @brief A single configuration of the benchmark matrix.
+   */
+  struct case_t {
+    int width;
+    int height;
+    int framerate;
+    int bitrate;  ///< Video bitrate in Kbps
+    int video_format;  ///< 0 - H.264, 1 - HEVC, 2 - AV1
+    int fec_percentage;
+    int sessions;  ///< Number of concurrent sessions streaming the same display
+    bool encryption;  ///< Whether video is encrypted
+    std::string send_backend;  ///< How packets are handed to the kernel, sendmsg or io_uring
+    bool gso;  ///< Whether batches of video packets may be sent with UDP GSO
+  };
+
+  /**
+   * @brief Latency distribution of a pipeline stage, in milliseconds.
+   */
+  struct percentiles_t {
+    std::size_t samples;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+  };
+
+  /**
+   * @brief Measurements of a single benchmark case.
+   */
+  struct result_t {
+    std::uint64_t frames;  ///< Frames received by all clients together
+    std::uint64_t bytes;  ///< Video bytes received by all clients together
+    double fps;  ///< Frames received per second, by all clients together
+    double cpu_per_frame;  ///< Process CPU time per received frame, in milliseconds
+
+    std::map<std::string, percentiles_t> stages;
+  };
+
+  /**
+   * @brief The pipeline stages that are reported, in the order the frames pass through them.
+   */
+  extern const std::vector<std::string> stage_names;
+
+  /**
+   * @brief Get the CPU time used by all threads of the process so far.
+   */
+  std::chrono::duration<double, std::milli>
+  process_cpu_time();
+
+  /**
+   * @brief Compute the latency distribution of a set of samples.
+   * @param samples The samples, in milliseconds.
+   * @return The distribution, all zeros for no samples.
+   */
+  percentiles_t
+  percentiles(std::vector<double> samples);
+
+  /**
+   * @brief Stream from the synthetic display to clients on the loopback interface, and measure the pipeline.
+   * @details This goes through the same session setup, capture, encode, packetization, FEC, encryption and send
+   * paths as a real stream. The encoder and capture method must have been probed before.
+   * @param bench_case The configuration to measure.
+   * @param warmup How long the stream runs before measuring.
+   * @param duration How long to measure.
+   * @return The measurements, or `std::nullopt` if the sessions couldn't be started.
+   */
+  std::optional<result_t>
+  run(const case_t &bench_case, std::chrono::seconds warmup, std::chrono::seconds duration);
+}  // namespace bench
@@ -0,0 +1,152 @@
+/**
+ * @file benchmarks/send.cpp
+ * @brief Definitions for the loopback send throughput benchmark.
+ */
+// standard includes
+#include <array>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// lib includes
+#include <boost/asio.hpp>
+
+// local includes
+#include "pipeline.h"
+#include "send.h"
+#include <src/config.h>
+#include <src/logging.h>
+#include <src/platform/common.h>
+#include <src/utility.h>
+
+using namespace std::literals;
+
+namespace bench {
+  namespace asio = boost::asio;
+  using udp = asio::ip::udp;
+
+  namespace {
+    // The default packet size Moonlight asks for, plus the largest RTP header
+    constexpr std::size_t PACKET_SIZE = 1392 + 16;
+
+    // About the number of packets of a large frame, so GSO batches are full
+    constexpr std::size_t PACKETS_PER_BATCH = 64;
+
+    // The video sender waits for its sends to complete once per frame, which is about this many batches
+    constexpr std::size_t BATCHES_PER_WAIT = 4;
+  }  // namespace
+
+  std::optional<send_result_t>
+  run_send(const send_case_t &send_case, std::chrono::seconds duration) {
+    auto config_fg = util::fail_guard([stream = config::stream]() {
+      config::stream = stream;
+    });
+    config::stream.send_backend = send_case.send_backend;
+    config::stream.udp_gso = send_case.gso;
+
+    asio::io_context io;
+    boost::system::error_code ec;
+
+    udp::socket send_sock { io };
+    udp::socket receive_sock { io };
+    send_sock.open(udp::v4(), ec);
+    if (!ec) {
+      send_sock.bind(udp::endpoint { asio::ip::address_v4::loopback(), 0 }, ec);
+    }
+    if (!ec) {
+      receive_sock.open(udp::v4(), ec);
+    }
+    if (!ec) {
+      receive_sock.bind(udp::endpoint { asio::ip::address_v4::loopback(), 0 }, ec);
+    }
+    if (ec) {
+      BOOST_LOG(error) << "Couldn't set up loopback sockets: "sv << ec.message();
+      return std::nullopt;
+    }
+    receive_sock.set_option(asio::socket_base::receive_buffer_size(4 * 1024 * 1024), ec);
+
+    // Count what arrives, to see how much the kernel dropped
+    std::atomic_uint64_t received_packets = 0;
+    std::atomic_uint64_t received_bytes = 0;
+    std::array<char, 2048> receive_buffer;
+    std::function<void()> receive = [&]() {
+      receive_sock.async_receive(asio::buffer(receive_buffer), [&](const boost::system::error_code &ec, std::size_t size) {
+        if (ec == asio::error::operation_aborted) {
+          return;
+        }
+
+        if (!ec) {
+          ++received_packets;
+          received_bytes += size;
+        }
+
+        receive();
+      });
+    };
+    receive();
+
+    std::thread io_thread { [&io]() {
+      io.run();
+    } };
+    auto fg = util::fail_guard([&]() {
+      io.stop();
+      io_thread.join();
+    });
+
+    send_result_t result {};
+
+    // The io_uring of a thread is set up with the send backend of its first send, so every case gets its own thread
+    std::thread sender { [&]() {
+      std::vector<char> payload(PACKET_SIZE * PACKETS_PER_BATCH);
+      platf::buffer_descriptor_t payload_buffer { payload.data(), payload.size() };
+
+      auto target_address = receive_sock.local_endpoint().address();
+      auto target_port = receive_sock.local_endpoint().port();
+      auto source_address = send_sock.local_endpoint().address();
+
+      auto cpu_start = process_cpu_time();
+      auto start = std::chrono::steady_clock::now();
+      auto end = start + duration;
+
+      std::size_t batches = 0;
+      while (std::chrono::steady_clock::now() < end) {
+        platf::batched_send_info_t send_info {
+          nullptr,
+          0,
+          std::span { &payload_buffer, 1 },
+          PACKET_SIZE,
+          0,
+          PACKETS_PER_BATCH,
+          (uintptr_t) send_sock.native_handle(),
+          target_address,
+          target_port,
+          source_address,
+        };
+
+        if (platf::send_batch(send_info)) {
+          result.packets += PACKETS_PER_BATCH;
+        }
+        result.stalls += send_info.stalls;
+
+        if (++batches % BATCHES_PER_WAIT == 0) {
+          platf::wait_for_sends();
+        }
+      }
+      platf::wait_for_sends();
+
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      result.cpu_per_packet = result.packets ? (process_cpu_time() - cpu_start).count() * 1000 / result.packets : 0.0;
+    } };
+    sender.join();
+
+    // Let the receiver drain the socket
+    std::this_thread::sleep_for(100ms);
+
+    result.bytes = result.packets * PACKET_SIZE;
+    result.received_packets = received_packets;
+    result.received_bytes = received_bytes;
+
+    return result;
+  }
+}  // namespace bench
@@ -0,0 +1,45 @@
+/**
+ * @file benchmarks/send.h
+ * @brief Declarations for the loopback send throughput benchmark.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace bench {
+  /**
+   * @brief A single configuration of the send throughput benchmark.
+   */
+  struct send_case_t {
+    std::string send_backend;  ///< sendmsg or io_uring
+    bool gso;  ///< Whether batches may be sent with UDP GSO
+  };
+
+  /**
+   * @brief Measurements of a single send throughput case.
+   */
+  struct send_result_t {
+    std::uint64_t packets;  ///< Packets handed to the kernel
+    std::uint64_t bytes;  ///< Bytes handed to the kernel
+    std::uint64_t received_packets;  ///< Packets that reached the receiving socket
+    std::uint64_t received_bytes;  ///< Bytes that reached the receiving socket
+    std::uint64_t stalls;  ///< Times a send waited for socket buffer space
+    double seconds;  ///< Time spent sending
+    double cpu_per_packet;  ///< Process CPU time per packet handed to the kernel, including the receiver, in microseconds
+  };
+
+  /**
+   * @brief Send batches of video-sized packets to a socket on the loopback interface as fast as possible.
+   * @details The packets go through `platf::send_batch()` like a frame's packets do, without encoding, FEC or
+   * pacing, so only the cost of handing them to the kernel is measured.
+   * @param send_case The configuration to measure.
+   * @param duration How long to send.
+   * @return The measurements, or `std::nullopt` if the sockets couldn't be set up.
+   */
+  std::optional<send_result_t>
+  run_send(const send_case_t &send_case, std::chrono::seconds duration);
+}  // namespace bench
@@ -99,6 +99,8 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/audio.cpp"
         "${CMAKE_SOURCE_DIR}/src/audio.h"
         "${CMAKE_SOURCE_DIR}/src/platform/common.h"
+        "${CMAKE_SOURCE_DIR}/src/platform/synthetic.h"
+        "${CMAKE_SOURCE_DIR}/src/platform/synthetic.cpp"
         "${CMAKE_SOURCE_DIR}/src/process.cpp"
         "${CMAKE_SOURCE_DIR}/src/process.h"
         "${CMAKE_SOURCE_DIR}/src/network.cpp"
@@ -115,6 +117,18 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/stat_trackers.cpp"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.h"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.c"
+        "${CMAKE_SOURCE_DIR}/src/rs_cache.h"
+        "${CMAKE_SOURCE_DIR}/src/rs_cache.cpp"
+        "${CMAKE_SOURCE_DIR}/src/pacer.h"
+        "${CMAKE_SOURCE_DIR}/src/pacer.cpp"
+        "${CMAKE_SOURCE_DIR}/src/adaptive_fec.h"
+        "${CMAKE_SOURCE_DIR}/src/adaptive_fec.cpp"
+        "${CMAKE_SOURCE_DIR}/src/adaptive_bitrate.h"
+        "${CMAKE_SOURCE_DIR}/src/adaptive_bitrate.cpp"
+        "${CMAKE_SOURCE_DIR}/src/frame_queue.h"
+        "${CMAKE_SOURCE_DIR}/src/frame_queue.cpp"
+        "${CMAKE_SOURCE_DIR}/src/shard_arena.h"
+        "${CMAKE_SOURCE_DIR}/src/shard_arena.cpp"
         ${PLATFORM_TARGET_FILES})
 
 if(NOT SUNSHINE_ASSETS_DIR_DEF)
@@ -30,6 +30,7 @@ if(NOT Boost_FOUND)
             asio
             crc
             format
+            interprocess
             process
             property_tree)
 
@@ -1,6 +1,7 @@
 option(BUILD_DOCS "Build documentation" ON)
 option(BUILD_TESTS "Build tests" ON)
 option(TESTS_ENABLE_PYTHON_TESTS "Enable Python tests" ON)
+option(BUILD_BENCHMARKS "Build the streaming pipeline benchmark" OFF)
 
 # DirectX11 is not available in GitHub runners, so even software encoding fails
 set(TESTS_SOFTWARE_ENCODER_UNAVAILABLE "fail"
@@ -0,0 +1,114 @@
+/**
+ * @file src/adaptive_bitrate.cpp
+ * @brief Definitions for adapting the encoder bitrate to the congestion of a stream.
+ */
+#include <algorithm>
+
+#include "adaptive_bitrate.h"
+
+using namespace std::literals;
+
+namespace adaptive_bitrate {
+  // Signs of congestion are collected over a window, so a single late frame doesn't count
+  constexpr auto WINDOW = 250ms;
+
+  // A congested window has more loss than this, or this many frames waiting to be sent
+  constexpr double LOSS_THRESHOLD = 0.03;
+  constexpr std::size_t BACKLOG_THRESHOLD = 2;
+
+  // The encoder takes a moment to reach a new bitrate, so cuts are spaced out
+  constexpr double DECREASE = 0.8;
+  constexpr auto DECREASE_INTERVAL = 500ms;
+
+  // Recovery waits for the link to stay clear, then probes upwards in steps of the client's bitrate
+  constexpr auto HOLD = 3s;
+  constexpr double INCREASE_STEP = 0.05;
+  constexpr auto INCREASE_INTERVAL = 1s;
+
+  controller_t::controller_t(int max_bitrate, clock::time_point now):
+      _max { max_bitrate },
+      _min { std::max(1, (int) (max_bitrate * MIN_FRACTION)) },
+      _bitrate { max_bitrate },
+      _window_start { now },
+      _last_congestion { now },
+      _last_change { now } {}
+
+  void
+  controller_t::sent(std::size_t packets) {
+    std::lock_guard lg { _lock };
+
+    _sent += packets;
+  }
+
+  void
+  controller_t::report_loss(std::size_t lost) {
+    std::lock_guard lg { _lock };
+
+    _lost += lost;
+  }
+
+  void
+  controller_t::report_backlog(std::size_t frames) {
+    std::lock_guard lg { _lock };
+
+    _backlog = std::max(_backlog, frames);
+  }
+
+  void
+  controller_t::report_stalls(std::size_t stalls) {
+    std::lock_guard lg { _lock };
+
+    _stalls += stalls;
+  }
+
+  std::optional<int>
+  controller_t::update(clock::time_point now) {
+    std::lock_guard lg { _lock };
+
+    if (_disabled || now - _window_start < WINDOW) {
+      return std::nullopt;
+    }
+
+    // Lost packets were counted as sent too
+    auto loss = _lost ? (double) _lost / std::max(_sent, _lost) : 0.0;
+    auto congested = loss > LOSS_THRESHOLD || _backlog >= BACKLOG_THRESHOLD || _stalls > 0;
+
+    _sent = _lost = _backlog = _stalls = 0;
+    _window_start = now;
+
+    auto bitrate = _bitrate;
+    if (congested) {
+      _last_congestion = now;
+
+      if (now - _last_change >= DECREASE_INTERVAL) {
+        bitrate = std::max(_min, (int) (_bitrate * DECREASE));
+      }
+    }
+    else if (now - _last_congestion >= HOLD && now - _last_change >= INCREASE_INTERVAL) {
+      bitrate = std::min(_max, _bitrate + std::max(1, (int) (_max * INCREASE_STEP)));
+    }
+
+    if (bitrate == _bitrate) {
+      return std::nullopt;
+    }
+
+    _bitrate = bitrate;
+    _last_change = now;
+
+    return bitrate;
+  }
+
+  void
+  controller_t::disable() {
+    std::lock_guard lg { _lock };
+
+    _disabled = true;
+  }
+
+  int
+  controller_t::bitrate() {
+    std::lock_guard lg { _lock };
+
+    return _bitrate;
+  }
+}  // namespace adaptive_bitrate
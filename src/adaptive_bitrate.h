@@ -0,0 +1,102 @@
+/**
+ * @file src/adaptive_bitrate.h
+ * @brief Declarations for adapting the encoder bitrate to the congestion of a stream.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+
+namespace adaptive_bitrate {
+  using clock = std::chrono::steady_clock;
+
+  // The lowest bitrate, as a fraction of the bitrate the client asked for
+  constexpr double MIN_FRACTION = 0.2;
+
+  /**
+   * @brief Chooses the encoder bitrate of a session from signs of congestion.
+   * @details The stream starts at the bitrate the client asked for, which is never exceeded.
+   * Congestion shows up as packet loss reported by the client, frames waiting for the sender,
+   * or sends waiting for socket buffer space. Each of these cuts the bitrate by a fraction.
+   * Once the stream has been free of congestion for a few seconds, the bitrate climbs back in
+   * small steps.
+   */
+  class controller_t {
+  public:
+    /**
+     * @param max_bitrate The bitrate the client asked for in Kbps.
+     * @param now The current time.
+     */
+    controller_t(int max_bitrate, clock::time_point now);
+
+    /**
+     * @brief Count packets sent to the client.
+     * @param packets The number of packets.
+     */
+    void
+    sent(std::size_t packets);
+
+    /**
+     * @brief Record the packets the client reports as lost since its last report.
+     * @param lost The number of lost packets.
+     */
+    void
+    report_loss(std::size_t lost);
+
+    /**
+     * @brief Record how many encoded frames wait to be sent.
+     * @param frames The number of frames waiting behind the one being sent.
+     */
+    void
+    report_backlog(std::size_t frames);
+
+    /**
+     * @brief Record sends that had to wait for socket buffer space.
+     * @param stalls The number of sends that waited.
+     */
+    void
+    report_stalls(std::size_t stalls);
+
+    /**
+     * @brief Decide whether the bitrate should change.
+     * @param now The current time.
+     * @return The new bitrate in Kbps, or `std::nullopt` if it stays the same.
+     */
+    std::optional<int>
+    update(clock::time_point now);
+
+    /**
+     * @brief Stop changing the bitrate, because the encoder can't follow.
+     */
+    void
+    disable();
+
+    /**
+     * @brief Get the current bitrate.
+     * @return The bitrate in Kbps.
+     */
+    int
+    bitrate();
+
+  private:
+    int _max;
+    int _min;
+
+    std::mutex _lock;
+
+    int _bitrate;
+    bool _disabled = false;
+
+    // Signs of congestion since the last decision
+    std::size_t _sent = 0;
+    std::size_t _lost = 0;
+    std::size_t _backlog = 0;
+    std::size_t _stalls = 0;
+
+    clock::time_point _window_start;
+    clock::time_point _last_congestion;
+    clock::time_point _last_change;
+  };
+}  // namespace adaptive_bitrate
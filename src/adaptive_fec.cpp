@@ -0,0 +1,96 @@
+/**
+ * @file src/adaptive_fec.cpp
+ * @brief Definitions for adapting the FEC percentage to the packet loss of a stream.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "adaptive_fec.h"
+
+using namespace std::literals;
+
+namespace adaptive_fec {
+  // Loss comes in bursts, so parity covers a multiple of the average loss rate
+  constexpr double LOSS_MARGIN = 3.0;
+
+  // Weight of a new loss report when the loss rate goes up or down. Clients report every 50 ms,
+  // so a lower loss rate takes a few seconds to be trusted.
+  constexpr double LOSS_RISE = 0.5;
+  constexpr double LOSS_FALL = 0.02;
+  constexpr std::chrono::duration<double> REPORT_INTERVAL = 50ms;
+
+  // Extra percentage after an unrecoverable frame, and how quickly it fades
+  constexpr double FRAME_LOSS_BOOST = 10.0;
+  constexpr std::chrono::duration<double> BOOST_FADE = 4s;
+
+  controller_t::controller_t(int base_percentage, clock::time_point now):
+      _base { base_percentage }, _boost { (double) base_percentage }, _boost_time { now } {}
+
+  int
+  controller_t::percentage(bool idr, clock::time_point now) {
+    std::lock_guard lg { _lock };
+
+    fade_boost(now);
+
+    auto max_percentage = std::max(MAX_PERCENTAGE, _base);
+
+    auto percentage = std::clamp((int) std::ceil(_loss * 100.0 * LOSS_MARGIN + _boost), MIN_PERCENTAGE, max_percentage);
+    if (idr) {
+      percentage = std::clamp(std::max(percentage * 2, _base), MIN_PERCENTAGE, max_percentage);
+    }
+
+    return percentage;
+  }
+
+  void
+  controller_t::sent(std::size_t packets) {
+    std::lock_guard lg { _lock };
+
+    _sent += packets;
+  }
+
+  void
+  controller_t::report_loss(std::size_t lost, std::chrono::milliseconds interval) {
+    std::lock_guard lg { _lock };
+
+    // Reports may arrive before any video was sent
+    if (!_sent && !lost) {
+      return;
+    }
+
+    // Lost packets were counted as sent too
+    auto rate = (double) lost / std::max(_sent, lost);
+    _sent = 0;
+
+    // A report over several intervals weighs as much as that many reports of the same loss.
+    // Clients that don't fill in the interval get the usual weight.
+    auto reports = interval > 0ms ? interval / REPORT_INTERVAL : 1.0;
+    auto weight = 1.0 - std::pow(1.0 - (rate > _loss ? LOSS_RISE : LOSS_FALL), reports);
+
+    _loss += weight * (rate - _loss);
+  }
+
+  void
+  controller_t::report_frame_loss(clock::time_point now) {
+    std::lock_guard lg { _lock };
+
+    // The boost must be up to date, or the next percentage() would fade the new boost too
+    fade_boost(now);
+    _boost = std::min<double>(_boost + FRAME_LOSS_BOOST, MAX_PERCENTAGE);
+  }
+
+  void
+  controller_t::fade_boost(clock::time_point now) {
+    if (now > _boost_time) {
+      _boost *= std::exp(-(now - _boost_time) / BOOST_FADE);
+      _boost_time = now;
+    }
+  }
+
+  double
+  controller_t::loss_rate() {
+    std::lock_guard lg { _lock };
+
+    return _loss;
+  }
+}  // namespace adaptive_fec
@@ -0,0 +1,91 @@
+/**
+ * @file src/adaptive_fec.h
+ * @brief Declarations for adapting the FEC percentage to the packet loss of a stream.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace adaptive_fec {
+  using clock = std::chrono::steady_clock;
+
+  // The lowest percentage, which still lets the client's minimum number of parity packets apply
+  constexpr int MIN_PERCENTAGE = 1;
+
+  // The highest percentage, so a large frame still fits in the FEC blocks of the protocol
+  constexpr int MAX_PERCENTAGE = 100;
+
+  /**
+   * @brief Chooses the FEC percentage of a session from the loss its client reports.
+   * @details Parity follows a moving average of the packet loss rate, rising quickly and
+   * falling slowly. Frames the client couldn't recover add extra parity that fades over a few
+   * seconds, which is also how a stream starts out. Key frames get more protection than others,
+   * because losing one costs another key frame.
+   */
+  class controller_t {
+  public:
+    /**
+     * @param base_percentage The configured FEC percentage, which the stream starts with and key frames never go below.
+     * @param now The current time.
+     */
+    controller_t(int base_percentage, clock::time_point now);
+
+    /**
+     * @brief Get the FEC percentage for the next frame.
+     * @param idr Whether the frame is a key frame.
+     * @param now The current time.
+     * @return The FEC percentage.
+     */
+    int
+    percentage(bool idr, clock::time_point now);
+
+    /**
+     * @brief Count packets sent to the client.
+     * @param packets The number of packets.
+     */
+    void
+    sent(std::size_t packets);
+
+    /**
+     * @brief Record the packets the client reports as lost since its last report.
+     * @param lost The number of lost packets.
+     * @param interval The time the report covers, reports over longer intervals weigh more.
+     */
+    void
+    report_loss(std::size_t lost, std::chrono::milliseconds interval);
+
+    /**
+     * @brief Record that the client couldn't recover a frame.
+     * @param now The current time.
+     */
+    void
+    report_frame_loss(clock::time_point now);
+
+    /**
+     * @brief Get the smoothed packet loss rate.
+     * @return The fraction of packets lost.
+     */
+    double
+    loss_rate();
+
+  private:
+    /**
+     * @brief Let the extra parity of unrecoverable frames fade up to the given time.
+     * @details Must be called with `_lock` held.
+     */
+    void
+    fade_boost(clock::time_point now);
+
+    int _base;
+
+    std::mutex _lock;
+
+    double _loss = 0.0;
+    double _boost;
+    clock::time_point _boost_time;
+
+    std::size_t _sent = 0;
+  };
+}  // namespace adaptive_fec
@@ -18,7 +18,14 @@
 namespace audio {
   using namespace std::literals;
   using opus_t = util::safe_ptr<OpusMSEncoder, opus_multistream_encoder_destroy>;
-  using sample_queue_t = std::shared_ptr<safe::queue_t<std::vector<float>>>;
+  using sample_t = safe::pool_t<std::vector<float>>::ptr_t;
+  using sample_queue_t = std::shared_ptr<safe::queue_t<sample_t>>;
+
+  // Largest encoded packet
+  constexpr std::size_t MAX_PACKET_SIZE = 1400;
+
+  // How much audio may wait for the encoder
+  constexpr auto MAX_QUEUED_SAMPLES = 150ms;
 
   struct audio_ctx_t {
     // We want to change the sink for the first stream only
@@ -98,8 +105,7 @@ namespace audio {
   auto control_shared = safe::make_shared<audio_ctx_t>(start_audio_control, stop_audio_control);
 
   void
-  encodeThread(sample_queue_t samples, config_t config, void *channel_data) {
-    auto packets = mail::man->queue<packet_t>(mail::audio_packets);
+  encodeThread(sample_queue_t samples, safe::mail_raw_t::queue_t<packet_t> packets, config_t config, void *channel_data) {
     auto stream = stream_configs[map_stream(config.channels, config.flags[config_t::HIGH_QUALITY])];
     if (config.flags[config_t::CUSTOM_SURROUND_PARAMS]) {
       apply_surround_params(stream, config.customStreamParams);
@@ -124,11 +130,15 @@ namespace audio {
                     << stream.channelCount << " channels, "sv
                     << stream.bitrate / 1000 << " kbps (total), LOWDELAY"sv;
 
+    // Besides the packets waiting to be sent, one is being encoded and one is being sent
+    auto packet_pool = std::make_shared<safe::pool_t<buffer_t>>(packets->max_elements() + 2, buffer_t { MAX_PACKET_SIZE });
+
     auto frame_size = config.packetDuration * stream.sampleRate / 1000;
     while (auto sample = samples->pop()) {
-      buffer_t packet { 1400 };
+      auto packet = packet_pool->acquire();
+      packet->fake_resize(MAX_PACKET_SIZE);
 
-      int bytes = opus_multistream_encode_float(opus.get(), sample->data(), frame_size, std::begin(packet), packet.size());
+      int bytes = opus_multistream_encode_float(opus.get(), sample->data(), frame_size, std::begin(*packet), packet->size());
       if (bytes < 0) {
         BOOST_LOG(error) << "Couldn't encode audio: "sv << opus_strerror(bytes);
         packets->stop();
@@ -136,7 +146,7 @@ namespace audio {
         return;
       }
 
-      packet.fake_resize(bytes);
+      packet->fake_resize(bytes);
       packets->raise(channel_data, std::move(packet));
     }
   }
@@ -215,8 +225,15 @@ namespace audio {
     // Capture takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::critical);
 
-    auto samples = std::make_shared<sample_queue_t::element_type>(30);
-    std::thread thread { encodeThread, samples, config, channel_data };
+    int samples_per_frame = frame_size * stream.channelCount;
+
+    // Sample buffers are recycled between capture and encode. Besides the queued buffers,
+    // one is being captured into and one is being encoded.
+    auto max_queued = std::max<int>(4, MAX_QUEUED_SAMPLES / std::chrono::milliseconds { config.packetDuration });
+    auto samples = std::make_shared<sample_queue_t::element_type>(max_queued);
+    auto sample_pool = std::make_shared<safe::pool_t<std::vector<float>>>(max_queued + 2, std::vector<float>(samples_per_frame));
+
+    std::thread thread { encodeThread, samples, mail->queue<packet_t>(mail::audio_packets), config, channel_data };
 
     auto fg = util::fail_guard([&]() {
       samples->stop();
@@ -225,13 +242,10 @@ namespace audio {
       shutdown_event->view();
     });
 
-    int samples_per_frame = frame_size * stream.channelCount;
-
     while (!shutdown_event->peek()) {
-      std::vector<float> sample_buffer;
-      sample_buffer.resize(samples_per_frame);
+      auto sample_buffer = sample_pool->acquire();
 
-      auto status = mic->sample(sample_buffer);
+      auto status = mic->sample(*sample_buffer);
       switch (status) {
         case platf::capture_e::ok:
           break;
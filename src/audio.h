@@ -4,6 +4,8 @@
  */
 #pragma once
 
+#include <bitset>
+
 #include "thread_safe.h"
 #include "utility.h"
 namespace audio {
@@ -53,7 +55,10 @@ namespace audio {
   };
 
   using buffer_t = util::buffer_t<std::uint8_t>;
-  using packet_t = std::pair<void *, buffer_t>;
+
+  // Encoded packets are recycled once they're sent, so packets are handed out by a pool
+  using packet_buffer_t = safe::pool_t<buffer_t>::ptr_t;
+  using packet_t = std::pair<void *, packet_buffer_t>;
   void
   capture(safe::mail_t mail, config_t config, void *channel_data);
 }  // namespace audio
@@ -251,4 +251,122 @@ namespace cbs {
 
     return ((CodedBitstreamH265Context *) ctx->priv_data)->active_sps->vui_parameters_present_flag;
   }
+
+  /**
+   * @brief Find the next Annex B start code.
+   * @return The offset of the next 00 00 01 sequence, or `size` if there is none.
+   */
+  static std::size_t
+  find_start_code(const std::uint8_t *data, std::size_t begin, std::size_t size) {
+    for (auto x = begin; x + 2 < size; ++x) {
+      if (data[x + 2] > 1) {
+        // Neither of the next two positions can start a start code
+        x += 2;
+      }
+      else if (data[x] == 0 && data[x + 1] == 0 && data[x + 2] == 1) {
+        return x;
+      }
+    }
+
+    return size;
+  }
+
+  /**
+   * @brief Strip the start code written by `write()` from a NAL unit.
+   */
+  static std::string_view
+  strip_start_code(const util::buffer_t<std::uint8_t> &nal) {
+    std::string_view view { (const char *) std::begin(nal), nal.size() };
+
+    auto begin = view.find('\x01');
+    return begin == std::string_view::npos ? std::string_view {} : view.substr(begin + 1);
+  }
+
+  static bool
+  is_slice(int codec_id, std::uint8_t nal_header) {
+    if (codec_id == AV_CODEC_ID_H264) {
+      auto type = nal_header & 0x1F;
+      return type >= 1 && type <= 5;
+    }
+
+    // H.265 VCL NAL unit types are all below 32
+    return ((nal_header >> 1) & 0x3F) < 32;
+  }
+
+  /**
+   * The parameter sets are located by walking the NAL units of the packet until the first slice.
+   * Start codes of the packet are kept as they are, only the NAL units themselves are swapped.
+   */
+  int
+  replace_parameter_sets(AVPacket *packet, int codec_id, std::initializer_list<const nal_t *> nals) {
+    struct splice_t {
+      std::size_t begin;
+      std::size_t end;
+      std::string_view _new;
+    };
+
+    std::vector<splice_t> splices;
+
+    auto data = packet->data;
+    auto size = (std::size_t) packet->size;
+
+    auto next = find_start_code(data, 0, size);
+    while (next < size) {
+      auto nal_begin = next + 3;
+      if (nal_begin >= size || is_slice(codec_id, data[nal_begin])) {
+        break;
+      }
+
+      next = find_start_code(data, nal_begin, size);
+
+      // Zero bytes in front of the next start code don't belong to this NAL unit
+      auto nal_end = next;
+      while (nal_end > nal_begin && data[nal_end - 1] == 0) {
+        --nal_end;
+      }
+
+      std::string_view nal_unit { (const char *) data + nal_begin, nal_end - nal_begin };
+      for (auto nal : nals) {
+        if (!nal->old.size() || strip_start_code(nal->old) != nal_unit) {
+          continue;
+        }
+
+        splices.emplace_back(splice_t { nal_begin, nal_end, strip_start_code(nal->_new) });
+        break;
+      }
+    }
+
+    if (splices.empty()) {
+      return 0;
+    }
+
+    auto new_size = size;
+    for (auto &splice : splices) {
+      new_size += splice._new.size() - (splice.end - splice.begin);
+    }
+
+    auto buf = av_buffer_alloc(new_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf) {
+      BOOST_LOG(error) << "Couldn't allocate packet for parameter set replacement"sv;
+      return -1;
+    }
+
+    // Copy the data in between the replaced NAL units, then the rest of the packet
+    auto out = buf->data;
+    std::size_t copied = 0;
+    for (auto &splice : splices) {
+      out = std::copy(data + copied, data + splice.begin, out);
+      out = std::copy(std::begin(splice._new), std::end(splice._new), out);
+      copied = splice.end;
+    }
+    out = std::copy(data + copied, data + size, out);
+    std::fill_n(out, AV_INPUT_BUFFER_PADDING_SIZE, 0);
+
+    av_buffer_unref(&packet->buf);
+    packet->buf = buf;
+    packet->data = buf->data;
+    packet->size = new_size;
+
+    return 0;
+  }
 }  // namespace cbs
@@ -4,6 +4,8 @@
  */
 #pragma once
 
+#include <initializer_list>
+
 #include "utility.h"
 
 struct AVPacket;
@@ -38,4 +40,16 @@ namespace cbs {
    */
   bool
   validate_sps(const AVPacket *packet, int codec_id);
+
+  /**
+   * @brief Replaces the rewritten parameter sets of a packet in place.
+   * @details Only the NAL units in front of the first slice are inspected. The packet is copied once
+   * into a new buffer if any parameter set was replaced, so the payload is final afterwards.
+   * @param packet The Annex B packet to rewrite.
+   * @param codec_id The ID of the codec used (either AV_CODEC_ID_H264 or AV_CODEC_ID_H265).
+   * @param nals The parameter sets to replace. Empty ones are ignored.
+   * @return 0 on success, -1 if the new buffer couldn't be allocated.
+   */
+  int
+  replace_parameter_sets(AVPacket *packet, int codec_id, std::initializer_list<const nal_t *> nals);
 }  // namespace cbs
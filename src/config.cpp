@@ -378,6 +378,7 @@ namespace config {
     {},  // encoder
     {},  // adapter_name
     {},  // output_name
+    {},  // synthetic_replay
   };
 
   audio_t audio {
@@ -392,6 +393,15 @@ namespace config {
     APPS_JSON_PATH,
 
     20,  // fecPercentage
+    false,  // adaptive_fec
+    false,  // adaptive_bitrate
+    0us,  // pacing_spin
+    false,  // kernel_pacing
+    800,  // egress_limit
+    0,  // session_egress_limit
+    false,  // zerocopy_send
+    "sendmsg"s,  // send_backend
+    true,  // udp_gso
     1,  // channels
 
     ENCRYPTION_MODE_NEVER,  // lan_encryption_mode
@@ -1031,6 +1041,7 @@ namespace config {
     string_f(vars, "encoder", video.encoder);
     string_f(vars, "adapter_name", video.adapter_name);
     string_f(vars, "output_name", video.output_name);
+    path_f(vars, "synthetic_replay", video.synthetic_replay);
     int_between_f(vars, "min_fps_factor", video.min_fps_factor, { 1, 3 });
 
     path_f(vars, "pkey", nvhttp.pkey);
@@ -1067,6 +1078,21 @@ namespace config {
 
     path_f(vars, "file_apps", stream.file_apps);
     int_between_f(vars, "fec_percentage", stream.fec_percentage, { 1, 255 });
+    bool_f(vars, "adaptive_fec", stream.adaptive_fec);
+    bool_f(vars, "adaptive_bitrate", stream.adaptive_bitrate);
+
+    int spin = -1;
+    int_between_f(vars, "pacing_spin", spin, { 0, 1000 });
+    if (spin != -1) {
+      stream.pacing_spin = std::chrono::microseconds(spin);
+    }
+
+    bool_f(vars, "kernel_pacing", stream.kernel_pacing);
+    int_between_f(vars, "egress_limit", stream.egress_limit, { 0, std::numeric_limits<int>::max() });
+    int_between_f(vars, "session_egress_limit", stream.session_egress_limit, { 0, std::numeric_limits<int>::max() });
+    bool_f(vars, "zerocopy_send", stream.zerocopy_send);
+    string_restricted_f(vars, "send_backend", stream.send_backend, { "sendmsg"sv, "io_uring"sv });
+    bool_f(vars, "udp_gso", stream.udp_gso);
 
     map_int_int_f(vars, "keybindings"s, input.keybindings);
 
@@ -75,6 +75,9 @@ namespace config {
     std::string encoder;
     std::string adapter_name;
     std::string output_name;
+
+    // Raw BGR0 frames the synthetic display replays
+    std::string synthetic_replay;
   };
 
   struct audio_t {
@@ -94,6 +97,32 @@ namespace config {
 
     int fec_percentage;
 
+    // Adapt the FEC percentage of each session to the loss its client reports
+    bool adaptive_fec;
+
+    // Lower the encoder bitrate of a session while its link is congested, and raise it again once it clears
+    bool adaptive_bitrate;
+
+    // Linux only: how long the pacing timer busy-waits before its deadline instead of sleeping
+    std::chrono::microseconds pacing_spin;
+
+    // Linux only: let the queueing discipline pace video packets using SO_TXTIME launch times
+    bool kernel_pacing;
+
+    // Video egress bandwidth ceilings in Mbps for all sessions together and for each session, 0 for no limit
+    int egress_limit;
+    int session_egress_limit;
+
+    // Linux only: send large batches of video packets without copying them into the kernel
+    bool zerocopy_send;
+
+    // Linux only: how packets are handed to the kernel
+    // sendmsg|io_uring
+    std::string send_backend;
+
+    // Linux only: let the kernel split batches of video packets with UDP GSO
+    bool udp_gso;
+
     // max unique instances of video and audio streams
     int channels;
 
@@ -3,6 +3,7 @@
  * @brief Definitions for cryptography functions.
  */
 #include "crypto.h"
+#include <algorithm>
 #include <openssl/pem.h>
 
 namespace crypto {
@@ -215,12 +216,118 @@ namespace crypto {
       return update_outlen + final_outlen;
     }
 
+    /**
+     * @brief Encrypts a plaintext split across two buffers with the given GCM context.
+     * @return The total length of the ciphertext. Returns -1 in case of an error.
+     */
+    static int
+    encrypt_gcm(cipher_ctx_t &ctx, aes_t *key, bool padding, const std::string_view &plaintext1, const std::string_view &plaintext2, std::uint8_t *tag, std::uint8_t *ciphertext, aes_t *iv) {
+      if (!ctx && init_encrypt_gcm(ctx, key, iv, padding)) {
+        return -1;
+      }
+
+      // Calling with cipher == nullptr results in a parameter change
+      // without requiring a reallocation of the internal cipher ctx.
+      if (EVP_EncryptInit_ex(ctx.get(), nullptr, nullptr, nullptr, iv->data()) != 1) {
+        return -1;
+      }
+
+      int update1_outlen = 0, update2_outlen = 0, final_outlen;
+
+      // Encrypt both parts into the caller's buffer
+      if (!plaintext1.empty() &&
+          EVP_EncryptUpdate(ctx.get(), ciphertext, &update1_outlen, (const std::uint8_t *) plaintext1.data(), plaintext1.size()) != 1) {
+        return -1;
+      }
+
+      if (!plaintext2.empty() &&
+          EVP_EncryptUpdate(ctx.get(), ciphertext + update1_outlen, &update2_outlen, (const std::uint8_t *) plaintext2.data(), plaintext2.size()) != 1) {
+        return -1;
+      }
+
+      // GCM encryption won't ever fill ciphertext here but we have to call it anyway
+      if (EVP_EncryptFinal_ex(ctx.get(), ciphertext + update1_outlen + update2_outlen, &final_outlen) != 1) {
+        return -1;
+      }
+
+      if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, tag_size, tag) != 1) {
+        return -1;
+      }
+
+      return update1_outlen + update2_outlen + final_outlen;
+    }
+
+    /**
+     * This function works like the single buffer version, but feeds both plaintext buffers into the same
+     * GCM operation. This avoids having to copy them into a contiguous buffer before encryption.
+     */
+    int
+    gcm_t::encrypt(const std::string_view &plaintext1, const std::string_view &plaintext2, std::uint8_t *tag, std::uint8_t *ciphertext, aes_t *iv) {
+      return encrypt_gcm(encrypt_ctx, &key, padding, plaintext1, plaintext2, tag, ciphertext, iv);
+    }
+
     int
     gcm_t::encrypt(const std::string_view &plaintext, std::uint8_t *tagged_cipher, aes_t *iv) {
       // This overload handles the common case of [GCM tag][cipher text] buffer layout
       return encrypt(plaintext, tagged_cipher, tagged_cipher + tag_size, iv);
     }
 
+    /**
+     * The batch is split into contiguous ranges of shards. The first range is encrypted on the calling
+     * thread and the others on the pool. Every range has its own cipher context, since a context can
+     * only be used by a single thread at a time. Small batches aren't split, because handing them off
+     * to another thread would cost more than it saves.
+     */
+    int
+    gcm_t::encrypt_batch(std::span<const gcm_shard_t> shards, std::span<aes_t> ivs, thread_pool_util::ThreadPool &pool, std::size_t workers) {
+      constexpr std::size_t MIN_BYTES_PER_RANGE = 64 * 1024;
+
+      if (shards.size() != ivs.size()) {
+        return -1;
+      }
+
+      std::size_t bytes = 0;
+      for (auto &shard : shards) {
+        bytes += shard.plaintext1.size() + shard.plaintext2.size();
+      }
+
+      auto ranges = std::clamp<std::size_t>(bytes / MIN_BYTES_PER_RANGE, 1, std::max<std::size_t>(workers, 1));
+      ranges = std::min(ranges, std::max<std::size_t>(shards.size(), 1));
+      if (batch_ctx.size() < ranges) {
+        batch_ctx.resize(ranges);
+      }
+
+      auto encrypt_range = [this, shards, ivs](std::size_t range, std::size_t begin, std::size_t end) {
+        for (auto x = begin; x < end; ++x) {
+          auto &shard = shards[x];
+          if (encrypt_gcm(batch_ctx[range], &key, padding, shard.plaintext1, shard.plaintext2, shard.tag, shard.ciphertext, &ivs[x]) < 0) {
+            return -1;
+          }
+        }
+
+        return 0;
+      };
+
+      auto range_size = (shards.size() + ranges - 1) / ranges;
+
+      std::vector<std::future<int>> tasks;
+      for (std::size_t range = 1; range < ranges; ++range) {
+        auto begin = std::min(range * range_size, shards.size());
+        auto end = std::min(begin + range_size, shards.size());
+
+        tasks.emplace_back(pool.push(encrypt_range, range, begin, end));
+      }
+
+      auto result = encrypt_range(0, 0, std::min(range_size, shards.size()));
+      for (auto &task : tasks) {
+        if (task.get() < 0) {
+          result = -1;
+        }
+      }
+
+      return result;
+    }
+
     int
     ecb_t::decrypt(const std::string_view &cipher, std::vector<std::uint8_t> &plaintext) {
       auto fg = util::fail_guard([this]() {
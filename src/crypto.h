@@ -5,11 +5,13 @@
 #pragma once
 
 #include <array>
+#include <span>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
 #include <openssl/x509.h>
 
+#include "thread_pool.h"
 #include "utility.h"
 
 namespace crypto {
@@ -116,6 +118,18 @@ namespace crypto {
       decrypt(const std::string_view &cipher, std::vector<std::uint8_t> &plaintext);
     };
 
+    /**
+     * @brief A plaintext to be encrypted by `gcm_t::encrypt_batch()`.
+     */
+    struct gcm_shard_t {
+      std::string_view plaintext1;
+      std::string_view plaintext2;
+
+      // Where the GCM tag and the ciphertext of both plaintext parts are written
+      std::uint8_t *tag;
+      std::uint8_t *ciphertext;
+    };
+
     class gcm_t: public cipher_t {
     public:
       gcm_t() = default;
@@ -136,6 +150,18 @@ namespace crypto {
       int
       encrypt(const std::string_view &plaintext, std::uint8_t *tag, std::uint8_t *ciphertext, aes_t *iv);
 
+      /**
+       * @brief Encrypts a plaintext split across two buffers using AES GCM mode.
+       * @param plaintext1 The first part of the plaintext.
+       * @param plaintext2 The second part of the plaintext.
+       * @param tag The buffer where the GCM tag will be written.
+       * @param ciphertext The buffer where the ciphertext of both parts will be written back to back.
+       * @param iv The initialization vector to be used for the encryption.
+       * @return The total length of the ciphertext. Returns -1 in case of an error.
+       */
+      int
+      encrypt(const std::string_view &plaintext1, const std::string_view &plaintext2, std::uint8_t *tag, std::uint8_t *ciphertext, aes_t *iv);
+
       /**
        * @brief Encrypts the plaintext using AES GCM mode.
        * length of cipher must be at least: round_to_pkcs7_padded(plaintext.size()) + crypto::cipher::tag_size
@@ -147,8 +173,25 @@ namespace crypto {
       int
       encrypt(const std::string_view &plaintext, std::uint8_t *tagged_cipher, aes_t *iv);
 
+      /**
+       * @brief Encrypts a batch of plaintexts using AES GCM mode, spread over several threads.
+       * @details Each plaintext is encrypted with the IV at the same index, exactly as if
+       * `encrypt()` was called for each of them in order.
+       * @param shards The plaintexts to be encrypted and the buffers for their results.
+       * @param ivs The initialization vector of each plaintext.
+       * @param pool The thread pool to encrypt on, next to the calling thread.
+       * @param workers The maximum number of threads to encrypt on, including the calling thread.
+       * @return 0 on success. Returns -1 if any of the plaintexts couldn't be encrypted.
+       */
+      int
+      encrypt_batch(std::span<const gcm_shard_t> shards, std::span<aes_t> ivs, thread_pool_util::ThreadPool &pool, std::size_t workers);
+
       int
       decrypt(const std::string_view &cipher, std::vector<std::uint8_t> &plaintext, aes_t *iv);
+
+    private:
+      // Each range of a batch is encrypted with its own context, so ranges can be encrypted concurrently
+      std::vector<cipher_ctx_t> batch_ctx;
     };
 
     class cbc_t: public cipher_t {
@@ -0,0 +1,173 @@
+/**
+ * @file src/frame_queue.cpp
+ * @brief Definitions for the queue of encoded frames waiting to be sent.
+ */
+#include <algorithm>
+
+#include "frame_queue.h"
+
+namespace video {
+  frame_queue_t::frame_queue_t(std::size_t max_frames, std::size_t max_bytes, clock::duration max_age, recover_f recover):
+      _max_frames { max_frames }, _max_bytes { max_bytes }, _max_age { max_age }, _recover { std::move(recover) } {}
+
+  void
+  frame_queue_t::raise(packet_t &&packet) {
+    std::optional<std::pair<std::int64_t, std::int64_t>> frames;
+    {
+      std::lock_guard lg { _lock };
+
+      if (!_continue) {
+        return;
+      }
+
+      ++_stats.frames;
+
+      // Until the encoder recovers, its frames reference the dropped ones
+      if (_broken && !packet->is_idr() && !packet->after_ref_frame_invalidation) {
+        ++_stats.dropped_frames;
+        _stats.dropped_bytes += packet->data_size();
+
+        // Keep asking, in case the encoder couldn't act on the request
+        if (++_dropped_while_broken % _max_frames == 0) {
+          ++_stats.recoveries;
+          frames = std::make_pair(_broken_first_frame, packet->frame_index());
+        }
+      }
+      else {
+        _broken = false;
+
+        auto now = clock::now();
+        auto size = packet->data_size();
+        _queue.emplace_back(entry_t { std::move(packet), size, now });
+        _bytes += size;
+
+        frames = trim(now);
+        _stats.max_depth = std::max(_stats.max_depth, _queue.size());
+
+        _cv.notify_all();
+      }
+    }
+
+    recover(frames);
+  }
+
+  packet_t
+  frame_queue_t::pop(clock::duration *wait) {
+    std::optional<std::pair<std::int64_t, std::int64_t>> frames;
+    packet_t packet;
+    {
+      std::unique_lock ul { _lock };
+
+      while (_continue) {
+        // Frames may have gone stale while the sender was busy
+        if (auto dropped = trim(clock::now())) {
+          frames = dropped;
+        }
+
+        if (!_queue.empty()) {
+          auto &entry = _queue.front();
+
+          auto waited = clock::now() - entry.queued;
+          ++_stats.popped;
+          _stats.total_wait += waited;
+          _stats.max_wait = std::max(_stats.max_wait, waited);
+          if (wait) {
+            *wait = waited;
+          }
+
+          _bytes -= entry.size;
+          packet = std::move(entry.packet);
+          _queue.pop_front();
+
+          break;
+        }
+
+        _cv.wait(ul);
+      }
+    }
+
+    recover(frames);
+
+    return packet;
+  }
+
+  bool
+  frame_queue_t::peek() {
+    std::lock_guard lg { _lock };
+
+    return _continue && !_queue.empty();
+  }
+
+  std::size_t
+  frame_queue_t::size() {
+    std::lock_guard lg { _lock };
+
+    return _queue.size();
+  }
+
+  void
+  frame_queue_t::stop() {
+    std::lock_guard lg { _lock };
+
+    _continue = false;
+
+    _cv.notify_all();
+  }
+
+  frame_queue_t::stats_t
+  frame_queue_t::stats() {
+    std::lock_guard lg { _lock };
+
+    return _stats;
+  }
+
+  std::optional<std::pair<std::int64_t, std::int64_t>>
+  frame_queue_t::trim(clock::time_point now) {
+    while (_queue.size() > 1 && (_queue.size() > _max_frames || _bytes > _max_bytes || now - _queue.front().queued > _max_age)) {
+      // Nothing after a key frame references the frames before it
+      auto last = std::prev(_queue.rend());
+      auto idr = std::find_if(_queue.rbegin(), last, [](auto &entry) {
+        return entry.packet->is_idr();
+      });
+      if (idr != last) {
+        drop(std::begin(_queue), std::prev(idr.base()));
+
+        continue;
+      }
+
+      // Each frame references the one before it, so the frames after the oldest one can't be decoded without it.
+      // A leading key frame is kept, because it doesn't depend on anything.
+      auto first = _queue.front().packet->is_idr() ? std::next(std::begin(_queue)) : std::begin(_queue);
+
+      auto frames = std::make_pair(first->packet->frame_index(), _queue.back().packet->frame_index());
+      drop(first, std::end(_queue));
+
+      _broken = true;
+      _broken_first_frame = frames.first;
+      _dropped_while_broken = 0;
+      ++_stats.recoveries;
+
+      return frames;
+    }
+
+    return std::nullopt;
+  }
+
+  void
+  frame_queue_t::drop(std::deque<entry_t>::iterator begin, std::deque<entry_t>::iterator end) {
+    for (auto it = begin; it != end; ++it) {
+      ++_stats.dropped_frames;
+      _stats.dropped_bytes += it->size;
+      _bytes -= it->size;
+    }
+
+    _queue.erase(begin, end);
+  }
+
+  void
+  frame_queue_t::recover(const std::optional<std::pair<std::int64_t, std::int64_t>> &frames) {
+    if (frames && _recover) {
+      _recover(frames->first, frames->second);
+    }
+  }
+}  // namespace video
@@ -0,0 +1,158 @@
+/**
+ * @file src/frame_queue.h
+ * @brief Declarations for the queue of encoded frames waiting to be sent.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+#include "video.h"
+
+namespace video {
+  /**
+   * @brief A queue of encoded frames, which drops frames in a way the client can recover from.
+   * @details The queue holds a limited number of frames, bytes and time. When it's over any of these
+   * limits, it makes room the cheapest way first:
+   * - Frames before the newest key frame aren't needed to decode anything after it, so they go first.
+   * - Otherwise each frame depends on the ones before it, so dropping the oldest frame breaks
+   *   everything queued after it as well. All but a leading key frame are dropped, and so are new
+   *   frames until the encoder sends a key frame or a frame that no longer references the dropped ones.
+   *   Recovery is requested right away, instead of waiting for the client to notice the gap.
+   */
+  class frame_queue_t {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Asks the encoder to stop referencing frames that were dropped.
+     * @param first_frame The index of the first dropped frame.
+     * @param last_frame The index of the last dropped frame.
+     */
+    using recover_f = std::function<void(std::int64_t first_frame, std::int64_t last_frame)>;
+
+    /**
+     * @brief Counters of the queue since it was created.
+     */
+    struct stats_t {
+      std::uint64_t frames;  ///< Frames raised
+      std::uint64_t dropped_frames;  ///< Frames dropped before being sent
+      std::uint64_t dropped_bytes;  ///< Size of the dropped frames
+      std::uint64_t recoveries;  ///< Times recovery was requested
+      std::uint64_t popped;  ///< Frames handed to the sender
+      std::size_t max_depth;  ///< Most frames waiting at once
+      clock::duration total_wait;  ///< Time the popped frames spent waiting
+      clock::duration max_wait;  ///< Longest time a popped frame spent waiting
+    };
+
+    /**
+     * @param max_frames The highest number of frames in the queue.
+     * @param max_bytes The highest total size of the frames in the queue.
+     * @param max_age How long a frame may wait in the queue.
+     * @param recover Called when frames other frames depend on were dropped.
+     */
+    frame_queue_t(std::size_t max_frames, std::size_t max_bytes, clock::duration max_age, recover_f recover);
+
+    /**
+     * @brief Add a frame to the queue.
+     * @param packet The encoded frame.
+     */
+    void
+    raise(packet_t &&packet);
+
+    /**
+     * @brief Wait for the next frame.
+     * @param wait Optionally set to how long the frame waited in the queue.
+     * @return The frame, or `nullptr` once the queue is stopped.
+     */
+    packet_t
+    pop(clock::duration *wait = nullptr);
+
+    /**
+     * @brief Check whether a frame is waiting.
+     * @return `true` if `pop()` won't block.
+     */
+    bool
+    peek();
+
+    /**
+     * @brief Get the number of frames waiting.
+     * @return The number of frames.
+     */
+    std::size_t
+    size();
+
+    /**
+     * @brief Stop the queue, which wakes up any thread waiting in `pop()`.
+     */
+    void
+    stop();
+
+    [[nodiscard]] bool
+    running() const {
+      return _continue;
+    }
+
+    /**
+     * @brief Get the counters of the queue.
+     * @return The counters.
+     */
+    stats_t
+    stats();
+
+  private:
+    struct entry_t {
+      packet_t packet;
+      std::size_t size;
+      clock::time_point queued;
+    };
+
+    /**
+     * @brief Drop frames until the queue is within its limits.
+     * @param now The current time.
+     * @return The range of frames to recover from, if reference frames were dropped.
+     */
+    std::optional<std::pair<std::int64_t, std::int64_t>>
+    trim(clock::time_point now);
+
+    /**
+     * @brief Drop the frames in a range of the queue.
+     * @param begin The first frame to drop.
+     * @param end The frame after the last one to drop.
+     */
+    void
+    drop(std::deque<entry_t>::iterator begin, std::deque<entry_t>::iterator end);
+
+    /**
+     * @brief Request recovery outside of the lock, if frames were dropped.
+     * @param frames The range of frames to recover from.
+     */
+    void
+    recover(const std::optional<std::pair<std::int64_t, std::int64_t>> &frames);
+
+    std::size_t _max_frames;
+    std::size_t _max_bytes;
+    clock::duration _max_age;
+    recover_f _recover;
+
+    bool _continue { true };
+
+    std::mutex _lock;
+    std::condition_variable _cv;
+
+    std::deque<entry_t> _queue;
+    std::size_t _bytes = 0;
+
+    // Set while frames are dropped until the encoder recovers
+    bool _broken = false;
+    std::int64_t _broken_first_frame = 0;
+    std::size_t _dropped_while_broken = 0;
+
+    stats_t _stats {};
+  };
+}  // namespace video
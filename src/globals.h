@@ -44,14 +44,15 @@ namespace mail {
   // Global mail
   MAIL(shutdown);
   MAIL(broadcast_shutdown);
-  MAIL(video_packets);
-  MAIL(audio_packets);
   MAIL(switch_display);
 
   // Local mail
   MAIL(touch_port);
+  MAIL(audio_packets);
   MAIL(idr);
   MAIL(invalidate_ref_frames);
+  MAIL(bitrate);
+  MAIL(fixed_bitrate);
   MAIL(gamepad_feedback);
   MAIL(hdr);
 #undef MAIL
@@ -12,7 +12,7 @@ extern "C" {
 #include <bitset>
 #include <chrono>
 #include <cmath>
-#include <list>
+#include <deque>
 #include <thread>
 #include <unordered_map>
 
@@ -35,6 +35,10 @@ using namespace std::literals;
 namespace input {
 
   constexpr auto MAX_GAMEPADS = std::min((std::size_t) platf::MAX_GAMEPADS, sizeof(std::int16_t) * 8);
+
+  // Enough message buffers for a burst from a high polling rate mouse, the pool grows beyond that if needed
+  constexpr std::size_t INITIAL_MESSAGE_BUFFERS = 32;
+
 #define DISABLE_LEFT_BUTTON_DELAY ((thread_pool_util::ThreadPool::task_id_t) 0x01)
 #define ENABLE_LEFT_BUTTON_DELAY nullptr
 
@@ -164,6 +168,7 @@ namespace input {
         client_context { platf::allocate_client_input_context(platf_input) },
         touch_port_event { std::move(touch_port_event) },
         feedback_queue { std::move(feedback_queue) },
+        message_pool { std::make_shared<safe::pool_t<std::vector<uint8_t>>>(INITIAL_MESSAGE_BUFFERS, std::vector<uint8_t> {}) },
         mouse_left_button_timeout {},
         touch_port { { 0, 0, 0, 0 }, 0, 0, 1.0f },
         accumulated_vscroll_delta {},
@@ -178,7 +183,9 @@ namespace input {
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_event;
     platf::feedback_queue_t feedback_queue;
 
-    std::list<std::vector<uint8_t>> input_queue;
+    // Decrypted messages are moved through the queue, and their buffers recycled once processed
+    std::shared_ptr<safe::pool_t<std::vector<uint8_t>>> message_pool;
+    std::deque<input::message_t> input_queue;
     std::mutex input_queue_lock;
 
     thread_pool_util::ThreadPool::task_id_t mouse_left_button_timeout;
@@ -1529,7 +1536,7 @@ namespace input {
   void
   passthrough_next_message(std::shared_ptr<input_t> input) {
     // 'entry' backs the 'payload' pointer, so they must remain in scope together
-    std::vector<uint8_t> entry;
+    input::message_t entry;
     PNV_INPUT_HEADER payload;
 
     // Lock the input queue while batching, but release it before sending
@@ -1544,15 +1551,14 @@ namespace input {
       }
 
       // Pop off the first entry, which we will send
-      entry = input->input_queue.front();
-      payload = (PNV_INPUT_HEADER) entry.data();
+      entry = std::move(input->input_queue.front());
+      payload = (PNV_INPUT_HEADER) entry->data();
       input->input_queue.pop_front();
 
-      // Try to batch with remaining items on the queue
+      // Try to batch with remaining items on the queue, in place
       auto i = input->input_queue.begin();
       while (i != input->input_queue.end()) {
-        auto batchable_entry = *i;
-        auto batchable_payload = (PNV_INPUT_HEADER) batchable_entry.data();
+        auto batchable_payload = (PNV_INPUT_HEADER) (*i)->data();
 
         auto batch_result = batch(payload, batchable_payload);
         if (batch_result == batch_result_e::terminate_batch) {
@@ -1622,13 +1628,18 @@ namespace input {
     }
   }
 
+  message_t
+  acquire_message(std::shared_ptr<input_t> &input) {
+    return input->message_pool->acquire();
+  }
+
   /**
    * @brief Called on the control stream thread to queue an input message.
    * @param input The input context pointer.
    * @param input_data The input message.
    */
   void
-  passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data) {
+  passthrough(std::shared_ptr<input_t> &input, message_t &&input_data) {
     {
       std::lock_guard<std::mutex> lg(input->input_queue_lock);
       input->input_queue.push_back(std::move(input_data));
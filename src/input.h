@@ -12,12 +12,25 @@
 namespace input {
   struct input_t;
 
+  /**
+   * @brief An input message, whose buffer goes back to the pool of its input context when destroyed.
+   */
+  using message_t = safe::pool_t<std::vector<std::uint8_t>>::ptr_t;
+
   void
   print(void *input);
   void
   reset(std::shared_ptr<input_t> &input);
+
+  /**
+   * @brief Get a buffer for the next input message, reusing one of a previous message.
+   * @param input The input context pointer.
+   * @return The buffer, with undefined contents.
+   */
+  message_t
+  acquire_message(std::shared_ptr<input_t> &input);
   void
-  passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data);
+  passthrough(std::shared_ptr<input_t> &input, message_t &&input_data);
 
   [[nodiscard]] std::unique_ptr<platf::deinit_t>
   init();
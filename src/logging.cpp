@@ -37,6 +37,8 @@ bl::sources::severity_logger<int> fatal(5);  // Unrecoverable errors
 BOOST_LOG_ATTRIBUTE_KEYWORD(severity, "Severity", int)
 
 namespace logging {
+  periodic_observer_t observer;
+
   deinit_t::~deinit_t() {
     deinit();
   }
@@ -170,6 +172,16 @@ namespace logging {
       << std::endl;
   }
 
+  void
+  set_periodic_observer(periodic_observer_t new_observer) {
+    observer = std::move(new_observer);
+  }
+
+  const periodic_observer_t &
+  periodic_observer() {
+    return observer;
+  }
+
   std::string
   bracket(const std::string &input) {
     return "["s + input + "]"s;
@@ -4,6 +4,10 @@
  */
 #pragma once
 
+// standard includes
+#include <functional>
+#include <string_view>
+
 // lib includes
 #include <boost/log/common.hpp>
 #include <boost/log/sinks.hpp>
@@ -79,6 +83,28 @@ namespace logging {
   void
   print_help(const char *name);
 
+  /**
+   * @brief Receives every value collected by a periodic logger, along with the logger's message.
+   */
+  using periodic_observer_t = std::function<void(std::string_view message, double value)>;
+
+  /**
+   * @brief Install an observer for the periodic loggers.
+   * @details Loggers created while an observer is installed are enabled regardless of the log level,
+   * and pass every value to the observer. This is used by the benchmarks to compute percentiles.
+   * It must not be changed while loggers are being created.
+   * @param observer The observer, or `nullptr` to remove it.
+   */
+  void
+  set_periodic_observer(periodic_observer_t observer);
+
+  /**
+   * @brief Get the observer for the periodic loggers.
+   * @return The observer, which is empty unless one was installed.
+   */
+  const periodic_observer_t &
+  periodic_observer();
+
   /**
    * @brief A helper class for tracking and logging numerical values across a period of time
    * @examples
@@ -103,11 +129,16 @@ namespace logging {
         message(message),
         units(units),
         interval(interval_in_seconds),
-        enabled(config::sunshine.min_log_level <= severity.default_severity()) {}
+        observer(periodic_observer()),
+        enabled(config::sunshine.min_log_level <= severity.default_severity() || observer) {}
 
     void
     collect_and_log(const T &value) {
       if (enabled) {
+        if (observer) {
+          observer(message, (double) value);
+        }
+
         auto print_info = [&](const T &min_value, const T &max_value, double avg_value) {
           auto f = stat_trackers::two_digits_after_decimal();
           if constexpr (std::is_floating_point_v<T>) {
@@ -141,6 +172,7 @@ namespace logging {
     std::string message;
     std::string units;
     std::chrono::seconds interval;
+    periodic_observer_t observer;
     bool enabled;
     stat_trackers::min_max_avg_tracker<T> tracker;
   };
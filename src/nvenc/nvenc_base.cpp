@@ -362,6 +362,12 @@ namespace nvenc {
       return false;
     }
 
+    // Reconfiguring the encoder takes all of its parameters again
+    encoder_params.dynamic_bitrate = get_encoder_cap(NV_ENC_CAPS_SUPPORT_DYN_BITRATE_CHANGE);
+    encoder_params.init_params = init_params;
+    encoder_params.enc_config = enc_config;
+    encoder_params.init_params.encodeConfig = &encoder_params.enc_config;
+
     if (async_event_handle) {
       NV_ENC_EVENT_PARAMS event_params = { min_struct_version(NV_ENC_EVENT_PARAMS_VER) };
       event_params.completionEvent = async_event_handle;
@@ -543,6 +549,34 @@ namespace nvenc {
     return true;
   }
 
+  bool
+  nvenc_base::set_bitrate(uint32_t bitrate) {
+    if (!encoder || !encoder_params.dynamic_bitrate) return false;
+
+    auto &rc_params = encoder_params.enc_config.rcParams;
+    auto old_rc_params = rc_params;
+
+    // Keep the VBV buffer the same number of frames long
+    rc_params.averageBitRate = bitrate * 1000;
+    if (old_rc_params.vbvBufferSize) {
+      rc_params.vbvBufferSize = (uint64_t) old_rc_params.vbvBufferSize * rc_params.averageBitRate / old_rc_params.averageBitRate;
+    }
+
+    NV_ENC_RECONFIGURE_PARAMS reconfigure_params = { min_struct_version(NV_ENC_RECONFIGURE_PARAMS_VER) };
+    reconfigure_params.reInitEncodeParams = encoder_params.init_params;
+    reconfigure_params.resetEncoder = 0;
+    reconfigure_params.forceIDR = 0;
+
+    if (nvenc_failed(nvenc->nvEncReconfigureEncoder(encoder, &reconfigure_params))) {
+      BOOST_LOG(error) << "NvEncReconfigureEncoder failed: " << last_error_string;
+      rc_params = old_rc_params;
+      return false;
+    }
+
+    BOOST_LOG(debug) << "NvEnc: bitrate changed to " << bitrate << " Kbps";
+    return true;
+  }
+
   bool
   nvenc_base::nvenc_failed(NVENCSTATUS status) {
     auto status_string = [](NVENCSTATUS status) -> std::string {
@@ -36,6 +36,9 @@ namespace nvenc {
     bool
     invalidate_ref_frames(uint64_t first_frame, uint64_t last_frame);
 
+    bool
+    set_bitrate(uint32_t bitrate);
+
   protected:
     virtual bool
     init_library() = 0;
@@ -73,6 +76,9 @@ namespace nvenc {
       NV_ENC_BUFFER_FORMAT buffer_format = NV_ENC_BUFFER_FORMAT_UNDEFINED;
       uint32_t ref_frames_in_dpb = 0;
       bool rfi = false;
+      bool dynamic_bitrate = false;
+      NV_ENC_INITIALIZE_PARAMS init_params = {};
+      NV_ENC_CONFIG enc_config = {};
     } encoder_params;
 
     // Derived classes set these variables
@@ -0,0 +1,143 @@
+/**
+ * @file src/pacer.cpp
+ * @brief Definitions for pacing outgoing video traffic.
+ */
+#include <algorithm>
+
+#include "pacer.h"
+
+namespace pacer {
+  /**
+   * @brief Get the time it takes to send data at a rate.
+   */
+  static clock::duration
+  time_to_send(std::size_t bytes, std::uint64_t rate) {
+    if (rate == UNLIMITED || rate == 0) {
+      return clock::duration::zero();
+    }
+
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>((double) bytes / rate));
+  }
+
+  token_bucket_t::token_bucket_t(std::uint64_t rate, std::size_t burst):
+      _burst { burst } {
+    set_rate(rate);
+  }
+
+  void
+  token_bucket_t::set_rate(std::uint64_t rate) {
+    _rate = std::max<std::uint64_t>(rate, 1);
+    _burst_time = time_to_send(_burst, _rate);
+  }
+
+  std::uint64_t
+  token_bucket_t::rate() const {
+    return _rate;
+  }
+
+  clock::time_point
+  token_bucket_t::reserve(std::size_t bytes, clock::time_point now) {
+    // The bucket can't hold more tokens than the burst allowance, no matter how long it was idle
+    auto tat = std::max(_tat, now);
+
+    // Data may be sent as soon as the bucket would have room for the burst allowance again
+    auto send_time = std::max(now, tat - _burst_time);
+
+    _tat = tat + time_to_send(bytes, _rate);
+
+    return send_time;
+  }
+
+  flow_t::flow_t(egress_t &egress, std::uint64_t cap):
+      _egress { egress }, _cap { cap }, _demand { cap }, _rate { cap } {}
+
+  flow_t::~flow_t() {
+    _egress.leave(this);
+  }
+
+  std::uint64_t
+  flow_t::rate() const {
+    return _rate.load(std::memory_order_relaxed);
+  }
+
+  void
+  flow_t::want(std::uint64_t rate, clock::time_point now) {
+    rate = std::min(rate, _cap);
+
+    // The first report starts the first window
+    if (_window_start == clock::time_point {}) {
+      _window_start = now;
+    }
+
+    _window_peak = std::max(_window_peak, rate);
+
+    // _demand is only written by this flow's sender, so it may be read without the lock here
+    if (_window_peak > _demand) {
+      _egress.set_demand(this, _window_peak);
+    }
+
+    if (now - _window_start >= DEMAND_WINDOW) {
+      if (_window_peak < _demand) {
+        _egress.set_demand(this, _window_peak);
+      }
+
+      _window_peak = 0;
+      _window_start = now;
+    }
+  }
+
+  egress_t::egress_t(std::uint64_t limit):
+      _limit { limit } {}
+
+  std::unique_ptr<flow_t>
+  egress_t::join(std::uint64_t cap) {
+    auto flow = std::make_unique<flow_t>(*this, cap);
+
+    std::lock_guard lg { _lock };
+    _flows.emplace_back(flow.get());
+    rebalance();
+
+    return flow;
+  }
+
+  void
+  egress_t::leave(flow_t *flow) {
+    std::lock_guard lg { _lock };
+
+    _flows.erase(std::remove(std::begin(_flows), std::end(_flows), flow), std::end(_flows));
+    rebalance();
+  }
+
+  void
+  egress_t::set_demand(flow_t *flow, std::uint64_t demand) {
+    std::lock_guard lg { _lock };
+
+    flow->_demand = demand;
+    rebalance();
+  }
+
+  /**
+   * Flows are served in order of increasing demand. Each flow gets its demand if that's below
+   * an even split of the bandwidth that's left, which leaves more for the flows that follow.
+   */
+  void
+  egress_t::rebalance() {
+    std::vector<flow_t *> flows { _flows };
+    std::sort(std::begin(flows), std::end(flows), [](flow_t *l, flow_t *r) {
+      return l->_demand < r->_demand;
+    });
+
+    auto remaining = _limit;
+    for (std::size_t x = 0; x < flows.size(); ++x) {
+      auto flow = flows[x];
+
+      auto share = remaining == UNLIMITED ? UNLIMITED : remaining / (flows.size() - x);
+      auto rate = std::min(flow->_demand, share);
+      flow->_rate.store(rate, std::memory_order_relaxed);
+
+      if (remaining != UNLIMITED) {
+        remaining -= rate;
+      }
+    }
+  }
+}  // namespace pacer
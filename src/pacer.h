@@ -0,0 +1,162 @@
+/**
+ * @file src/pacer.h
+ * @brief Declarations for pacing outgoing video traffic.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pacer {
+  using clock = std::chrono::steady_clock;
+
+  // Rate of a flow that isn't limited by anything
+  constexpr std::uint64_t UNLIMITED = UINT64_MAX;
+
+  /**
+   * @brief A token bucket deciding when data may be sent without exceeding a rate.
+   * @details Implemented as the equivalent generic cell rate algorithm, which tracks when the
+   * bucket would be full again instead of the number of tokens in it. Not thread-safe, each
+   * sender owns its bucket.
+   */
+  class token_bucket_t {
+  public:
+    /**
+     * @param rate The rate in bytes per second.
+     * @param burst The number of bytes that may be sent at once after the bucket was idle.
+     */
+    token_bucket_t(std::uint64_t rate, std::size_t burst);
+
+    /**
+     * @brief Change the rate, without affecting data already reserved.
+     * @param rate The rate in bytes per second.
+     */
+    void
+    set_rate(std::uint64_t rate);
+
+    /**
+     * @brief Get the current rate.
+     * @return The rate in bytes per second.
+     */
+    std::uint64_t
+    rate() const;
+
+    /**
+     * @brief Reserve bandwidth for sending data.
+     * @param bytes The number of bytes to send.
+     * @param now The current time.
+     * @return When the data may be sent, which is `now` if the bucket has enough tokens.
+     */
+    clock::time_point
+    reserve(std::size_t bytes, clock::time_point now);
+
+  private:
+    std::size_t _burst;
+
+    std::uint64_t _rate;
+    clock::duration _burst_time;
+
+    // Theoretical arrival time, when the bucket will be full again
+    clock::time_point _tat {};
+  };
+
+  class egress_t;
+
+  // How long the rate a flow wants is measured before its demand may drop
+  constexpr auto DEMAND_WINDOW = std::chrono::seconds { 1 };
+
+  /**
+   * @brief The share of the egress bandwidth of one sender.
+   * @details Leaves the egress when destroyed, which redistributes its share among the others.
+   */
+  class flow_t {
+  public:
+    flow_t(egress_t &egress, std::uint64_t cap);
+    ~flow_t();
+
+    flow_t(const flow_t &) = delete;
+    flow_t &
+    operator=(const flow_t &) = delete;
+
+    /**
+     * @brief Get the highest rate this flow may currently send at.
+     * @return The rate in bytes per second.
+     */
+    std::uint64_t
+    rate() const;
+
+    /**
+     * @brief Report the rate the sender wants to send its current data at.
+     * @details The highest rate wanted during a measurement window becomes the demand of the
+     * flow. The demand rises right away, but only falls when a window ends, so bandwidth the
+     * sender stopped using goes to the other flows. Only the sender owning the flow may call this.
+     * @param rate The wanted rate in bytes per second.
+     * @param now The current time.
+     */
+    void
+    want(std::uint64_t rate, clock::time_point now);
+
+  private:
+    friend class egress_t;
+
+    egress_t &_egress;
+
+    // The highest rate this flow may use, no matter how much bandwidth is left
+    std::uint64_t _cap;
+
+    // The highest rate this flow would use, if the egress had enough bandwidth. Guarded by the egress lock.
+    std::uint64_t _demand;
+
+    // The highest rate wanted during the current measurement window
+    std::uint64_t _window_peak = 0;
+    clock::time_point _window_start {};
+
+    std::atomic<std::uint64_t> _rate;
+  };
+
+  /**
+   * @brief Divides a limited egress bandwidth fairly among the flows sharing it.
+   * @details Bandwidth is allocated with max-min fairness: no flow gets more than its demand,
+   * and bandwidth a flow doesn't need is split evenly among the others. A flow's demand is its
+   * cap until the flow reports the rate it wants.
+   */
+  class egress_t {
+  public:
+    /**
+     * @param limit The egress bandwidth in bytes per second, or `UNLIMITED`.
+     */
+    explicit egress_t(std::uint64_t limit);
+
+    /**
+     * @brief Add a flow sharing this egress.
+     * @param cap The highest rate the flow may use in bytes per second, or `UNLIMITED`.
+     * @return The flow.
+     */
+    std::unique_ptr<flow_t>
+    join(std::uint64_t cap);
+
+  private:
+    friend class flow_t;
+
+    void
+    leave(flow_t *flow);
+
+    void
+    set_demand(flow_t *flow, std::uint64_t demand);
+
+    /**
+     * @brief Recompute the rates of all flows. Must be called with `_lock` held.
+     */
+    void
+    rebalance();
+
+    std::uint64_t _limit;
+
+    std::mutex _lock;
+    std::vector<flow_t *> _flows;
+  };
+}  // namespace pacer
@@ -5,9 +5,12 @@
 #pragma once
 
 #include <bitset>
+#include <chrono>
 #include <filesystem>
 #include <functional>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 
 #include <boost/core/noncopyable.hpp>
@@ -52,6 +55,7 @@ namespace boost {
 }  // namespace boost
 namespace video {
   struct config_t;
+  struct conversion_cache_t;
 }  // namespace video
 namespace nvenc {
   class nvenc_base;
@@ -345,6 +349,9 @@ namespace platf {
 
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
 
+    // Frames converted from this image, shared by the encoders of sessions with different stream configurations
+    std::shared_ptr<video::conversion_cache_t> conversions;
+
     virtual ~img_t() = default;
   };
 
@@ -617,6 +624,36 @@ namespace platf {
         buffer(nullptr), size(0) {}
   };
 
+  /**
+   * @brief Zerocopy state of a socket, which keeps sent buffers alive until the kernel no longer references them.
+   * @details Shared by all threads sending on the socket.
+   */
+  class zerocopy_t {
+  public:
+    struct stats_t {
+      std::uint64_t zerocopy;  ///< Sends that referenced their buffers in place
+      std::uint64_t copied;  ///< Sends that copied their buffers, because they were small or zerocopy was unavailable
+      std::uint64_t deferred_copies;  ///< Zerocopy sends that the kernel ended up copying anyway
+    };
+
+    virtual ~zerocopy_t() = default;
+
+    /**
+     * @brief Keep buffers alive until the kernel completed all zerocopy sends made on the socket so far.
+     * @details Also releases the buffers of earlier sends that completed since.
+     * @param buffers The buffers referenced by the sends.
+     */
+    virtual void
+    hold(std::shared_ptr<void> buffers) = 0;
+
+    /**
+     * @brief Get the send counters.
+     * @return The counters.
+     */
+    virtual stats_t
+    stats() = 0;
+  };
+
   struct batched_send_info_t {
     // Optional headers to be prepended to each packet
     const char *headers;
@@ -625,7 +662,7 @@ namespace platf {
     // One or more data buffers to use for the payloads
     //
     // NB: Data buffers must be aligned to payload size!
-    std::vector<buffer_descriptor_t> &payload_buffers;
+    std::span<const buffer_descriptor_t> payload_buffers;
     size_t payload_size;
 
     // The offset (in header+payload message blocks) in the header and payload
@@ -640,6 +677,18 @@ namespace platf {
     uint16_t target_port;
     boost::asio::ip::address &source_address;
 
+    // Optional time at which the kernel should transmit the first message, and the spacing of the
+    // following messages. Only honored on sockets prepared with `enable_socket_txtime()`.
+    std::optional<std::chrono::steady_clock::time_point> launch_time {};
+    std::chrono::nanoseconds launch_interval {};
+
+    // Optional zerocopy state of the socket, from `enable_socket_zerocopy()`. Large batches are then
+    // sent without copying them, so the caller must pass their buffers to `zerocopy_t::hold()`.
+    zerocopy_t *zerocopy {};
+
+    // Counts the times the send had to wait for socket buffer space, where the platform reports it
+    std::size_t stalls {};
+
     /**
      * @brief Returns a payload buffer descriptor for the given payload offset.
      * @param offset The offset in the total payload data (bytes).
@@ -664,6 +713,15 @@ namespace platf {
   bool
   send_batch(batched_send_info_t &send_info);
 
+  /**
+   * @brief Wait until the kernel no longer uses the buffers of the sends made by the calling thread.
+   * @details With the io_uring send backend, `send_batch()` may return while its sends are still in progress,
+   * so their errors are only known once they completed.
+   * @return `false` if some of the sends since the last call couldn't be sent.
+   */
+  bool
+  wait_for_sends();
+
   struct send_info_t {
     const char *header;
     size_t header_size;
@@ -678,6 +736,16 @@ namespace platf {
   bool
   send(send_info_t &send_info);
 
+  /**
+   * @brief Send messages of different sizes with as few system calls as the platform allows.
+   * @details All messages must be sent on the same socket. Send errors are logged, like with `send()`.
+   * @param send_infos The messages to send, in order.
+   * @return `false` if the platform can't send several messages at once, in which case nothing was
+   * sent and the caller should use `send()` for each message.
+   */
+  bool
+  send_multiple(std::span<send_info_t> send_infos);
+
   enum class qos_data_type_e : int {
     audio,  ///< Audio
     video  ///< Video
@@ -694,6 +762,24 @@ namespace platf {
   std::unique_ptr<deinit_t>
   enable_socket_qos(uintptr_t native_socket, boost::asio::ip::address &address, uint16_t port, qos_data_type_e data_type, bool dscp_tagging);
 
+  /**
+   * @brief Enable launch times for packets sent with `send_batch()` on the given socket.
+   * @details The packets are released by the queueing discipline of the outgoing interface,
+   * which must support launch times (such as fq or etf). Otherwise they're sent immediately.
+   * @param native_socket The native socket handle.
+   * @return `true` if launch times are supported on this socket.
+   */
+  bool
+  enable_socket_txtime(uintptr_t native_socket);
+
+  /**
+   * @brief Enable zerocopy sends with `send_batch()` on the given socket.
+   * @param native_socket The native socket handle.
+   * @return The zerocopy state of the socket, or `nullptr` if zerocopy isn't supported.
+   */
+  std::unique_ptr<zerocopy_t>
+  enable_socket_zerocopy(uintptr_t native_socket);
+
   /**
    * @brief Open a url in the default web browser.
    * @param url The url to open.
@@ -846,6 +932,18 @@ namespace platf {
     virtual void
     sleep_for(const std::chrono::nanoseconds &duration) = 0;
 
+    /**
+     * @brief Sleep until the time point
+     * @param deadline Time point to wake up at
+     */
+    virtual void
+    sleep_until(const std::chrono::steady_clock::time_point &deadline) {
+      auto now = std::chrono::steady_clock::now();
+      if (now < deadline) {
+        sleep_for(deadline - now);
+      }
+    }
+
     /**
      * @brief Check if platform-specific timer backend has been initialized successfully
      * @return `true` on success, `false` on error
@@ -9,6 +9,7 @@
 #endif
 
 // standard includes
+#include <deque>
 #include <fstream>
 #include <iostream>
 
@@ -19,8 +20,12 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <ifaddrs.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <netinet/udp.h>
 #include <pwd.h>
+#include <sys/prctl.h>
+#include <time.h>
 #include <unistd.h>
 
 // local includes
@@ -30,6 +35,8 @@
 #include "src/entry_handler.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
+#include "src/platform/synthetic.h"
+#include "uring.h"
 #include "vaapi.h"
 
 #ifdef __GNUC__
@@ -370,29 +377,384 @@ namespace platf {
     return saddr_v6;
   }
 
-  bool
-  send_batch(batched_send_info_t &send_info) {
-    auto sockfd = (int) send_info.native_socket;
-    struct msghdr msg = {};
+  /**
+   * @brief Fill a control message with the launch time of a packet.
+   * @param cm The control message to fill.
+   * @param launch_time When the kernel should transmit the packet.
+   */
+  static void
+  fill_txtime_cmsg(struct cmsghdr *cm, const std::chrono::steady_clock::time_point &launch_time) {
+#ifdef SCM_TXTIME
+    // std::chrono::steady_clock is CLOCK_MONOTONIC, which is the clock the socket is set up with
+    uint64_t txtime = std::chrono::duration_cast<std::chrono::nanoseconds>(launch_time.time_since_epoch()).count();
+
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_TXTIME;
+    cm->cmsg_len = CMSG_LEN(sizeof(txtime));
+    memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+#endif
+  }
 
-    // Convert the target address into a sockaddr
-    struct sockaddr_in taddr_v4 = {};
-    struct sockaddr_in6 taddr_v6 = {};
-    if (send_info.target_address.is_v6()) {
-      taddr_v6 = to_sockaddr(send_info.target_address.to_v6(), send_info.target_port);
+  /**
+   * @brief Storage for the target address of a message.
+   */
+  union msg_name_t {
+    struct sockaddr_in v4;
+    struct sockaddr_in6 v6;
+  };
 
-      msg.msg_name = (struct sockaddr *) &taddr_v6;
-      msg.msg_namelen = sizeof(taddr_v6);
+  /**
+   * @brief Set the target address of a message.
+   * @param msg The message to address.
+   * @param name The storage for the address, which must outlive the message.
+   * @param target_address The address to send the message to.
+   * @param target_port The port to send the message to.
+   */
+  static void
+  fill_msg_name(struct msghdr &msg, msg_name_t &name, const boost::asio::ip::address &target_address, uint16_t target_port) {
+    if (target_address.is_v6()) {
+      name.v6 = to_sockaddr(target_address.to_v6(), target_port);
+      msg.msg_namelen = sizeof(name.v6);
     }
     else {
-      taddr_v4 = to_sockaddr(send_info.target_address.to_v4(), send_info.target_port);
+      name.v4 = to_sockaddr(target_address.to_v4(), target_port);
+      msg.msg_namelen = sizeof(name.v4);
+    }
+    msg.msg_name = &name;
+  }
+
+  /**
+   * @brief Fill a control message with the source address of a packet.
+   * @param cm The control message to fill.
+   * @param source_address The address to send the packet from.
+   * @return The space taken by the control message.
+   */
+  static socklen_t
+  fill_pktinfo_cmsg(struct cmsghdr *cm, const boost::asio::ip::address &source_address) {
+    if (source_address.is_v6()) {
+      struct in6_pktinfo pktInfo;
+
+      struct sockaddr_in6 saddr_v6 = to_sockaddr(source_address.to_v6(), 0);
+      pktInfo.ipi6_addr = saddr_v6.sin6_addr;
+      pktInfo.ipi6_ifindex = 0;
+
+      cm->cmsg_level = IPPROTO_IPV6;
+      cm->cmsg_type = IPV6_PKTINFO;
+      cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
+      memcpy(CMSG_DATA(cm), &pktInfo, sizeof(pktInfo));
+
+      return CMSG_SPACE(sizeof(pktInfo));
+    }
+
+    struct in_pktinfo pktInfo;
+
+    struct sockaddr_in saddr_v4 = to_sockaddr(source_address.to_v4(), 0);
+    pktInfo.ipi_spec_dst = saddr_v4.sin_addr;
+    pktInfo.ipi_ifindex = 0;
+
+    cm->cmsg_level = IPPROTO_IP;
+    cm->cmsg_type = IP_PKTINFO;
+    cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
+    memcpy(CMSG_DATA(cm), &pktInfo, sizeof(pktInfo));
+
+    return CMSG_SPACE(sizeof(pktInfo));
+  }
+
+  /**
+   * @brief Point iovecs at the header and payload of a message.
+   * @param iovs The iovecs to fill, with room for two.
+   * @param send_info The message.
+   * @return The number of iovecs used.
+   */
+  static int
+  fill_iovs(struct iovec *iovs, const send_info_t &send_info) {
+    int iovlen = 0;
+    if (send_info.header) {
+      iovs[iovlen].iov_base = (void *) send_info.header;
+      iovs[iovlen].iov_len = send_info.header_size;
+      iovlen++;
+    }
+    iovs[iovlen].iov_base = (void *) send_info.payload;
+    iovs[iovlen].iov_len = send_info.payload_size;
+    iovlen++;
+
+    return iovlen;
+  }
+
+  /**
+   * @brief Zerocopy state of a socket using MSG_ZEROCOPY.
+   * @details The kernel numbers the zerocopy sends of a socket and reports ranges of completed
+   * sends on the socket error queue, after which the buffers of those sends may be released.
+   */
+  class linux_zerocopy_t: public zerocopy_t {
+  public:
+    // Below this size, pinning the pages and handling the completion costs more than copying
+    static constexpr size_t MIN_BYTES = 8 * 1024;
+
+    // Each buffer of a zerocopy send is attached to the packet as page fragments, of which there
+    // may be at most MAX_SKB_FRAGS. Otherwise the send fails with EMSGSIZE.
+    static constexpr size_t MAX_FRAGS = 17;
+
+    // Once this many zerocopy sends in a row were copied by the kernel anyway, stop using zerocopy
+    static constexpr int MAX_DEFERRED_COPIES = 64;
+
+    explicit linux_zerocopy_t(int sockfd):
+        _sockfd { sockfd }, _page_size { (uintptr_t) sysconf(_SC_PAGESIZE) } {}
+
+    /**
+     * @brief Get how many segments of a message can be sent without copying them.
+     * @param iovs The header and payload buffers of each segment.
+     * @param segs The number of segments.
+     * @param seg_size The size of a segment.
+     * @return The number of segments, or 0 if the message should be copied.
+     */
+    size_t
+    segments(const struct iovec *iovs, size_t segs, size_t seg_size) {
+      if (!_enabled) {
+        return 0;
+      }
+
+      auto pages = [this](const struct iovec &iov) {
+        return ((uintptr_t) iov.iov_base + iov.iov_len - 1) / _page_size - (uintptr_t) iov.iov_base / _page_size + 1;
+      };
+
+      size_t frags = 0;
+      size_t x = 0;
+      for (; x < segs; ++x) {
+        auto seg_frags = pages(iovs[x * 2]) + pages(iovs[x * 2 + 1]);
+        if (frags + seg_frags > MAX_FRAGS) {
+          break;
+        }
+
+        frags += seg_frags;
+      }
+
+      // If few segments fit, a larger copied message is cheaper than several zerocopy messages
+      return x * seg_size >= MIN_BYTES ? x : 0;
+    }
+
+    /**
+     * @brief Send a message.
+     * @param msg The message to send.
+     * @param zerocopy Whether to send the message without copying it.
+     * @return The result of `sendmsg()`.
+     */
+    ssize_t
+    send(struct msghdr *msg, bool zerocopy) {
+      std::lock_guard lg { _lock };
+
+      // The send must be counted before another thread sends, so its number matches the kernel's
+      auto bytes_sent = sendmsg(_sockfd, msg, zerocopy ? MSG_ZEROCOPY : 0);
+      if (bytes_sent < 0 && zerocopy && (errno == ENOBUFS || errno == EMSGSIZE)) {
+        // Too many buffers are pinned or the message has too many fragments, so copy this one instead
+        if (errno == ENOBUFS) {
+          reap();
+        }
+
+        zerocopy = false;
+        bytes_sent = sendmsg(_sockfd, msg, 0);
+      }
+
+      if (bytes_sent >= 0) {
+        if (zerocopy) {
+          ++_next_id;
+          ++_stats.zerocopy;
+        }
+        else {
+          ++_stats.copied;
+        }
+      }
+      else if (errno == EAGAIN) {
+        // Pending completions would keep waking up the caller waiting for send buffer space
+        auto err = errno;
+        reap();
+        errno = err;
+      }
+
+      return bytes_sent;
+    }
 
-      msg.msg_name = (struct sockaddr *) &taddr_v4;
-      msg.msg_namelen = sizeof(taddr_v4);
+    /**
+     * @brief Count messages that were sent without going through `send()`.
+     * @param count The number of messages.
+     */
+    void
+    copied(size_t count) {
+      std::lock_guard lg { _lock };
+
+      _stats.copied += count;
+    }
+
+    void
+    hold(std::shared_ptr<void> buffers) override {
+      std::lock_guard lg { _lock };
+
+      reap();
+
+      // Without outstanding zerocopy sends, the buffers can be released right away
+      if (_completed != _next_id) {
+        _held.emplace_back(_next_id, std::move(buffers));
+      }
+    }
+
+    stats_t
+    stats() override {
+      std::lock_guard lg { _lock };
+
+      return _stats;
+    }
+
+  private:
+    /**
+     * @brief Read completions from the socket error queue and release the buffers they cover.
+     * @details Must be called with `_lock` held.
+     */
+    void
+    reap() {
+      while (true) {
+        union {
+          char buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+          struct cmsghdr alignment;
+        } cmbuf;
+
+        struct msghdr msg = {};
+        msg.msg_control = cmbuf.buf;
+        msg.msg_controllen = sizeof(cmbuf.buf);
+
+        if (recvmsg(_sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+          if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            BOOST_LOG(verbose) << "recvmsg(MSG_ERRQUEUE) failed: "sv << errno;
+          }
+          break;
+        }
+
+        for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+          if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+              !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+            continue;
+          }
+
+          auto serr = (struct sock_extended_err *) CMSG_DATA(cm);
+          if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+            continue;
+          }
+
+          complete(serr->ee_info, serr->ee_data, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+        }
+      }
+
+      // Held buffers are in send order, so stop at the first one that's still referenced
+      while (!_held.empty() && (int32_t) (_completed - _held.front().first) >= 0) {
+        _held.pop_front();
+      }
+    }
+
+    /**
+     * @brief Record a range of completed zerocopy sends.
+     * @param first The number of the first completed send.
+     * @param last The number of the last completed send.
+     * @param copied Whether the kernel copied the buffers of these sends anyway.
+     */
+    void
+    complete(uint32_t first, uint32_t last, bool copied) {
+      auto count = last - first + 1;
+
+      if (copied) {
+        _stats.deferred_copies += count;
+        _deferred_copies_in_a_row += count;
+
+        // This happens on loopback and with devices that can't gather, where zerocopy only adds overhead
+        if (_enabled && _deferred_copies_in_a_row >= MAX_DEFERRED_COPIES) {
+          BOOST_LOG(info) << "The kernel keeps copying zerocopy sends, switching back to regular sends"sv;
+          _enabled = false;
+        }
+      }
+      else {
+        _deferred_copies_in_a_row = 0;
+      }
+
+      // Ranges are normally reported in order, but may overtake each other
+      _done.emplace_back(first, last + 1);
+      for (auto it = std::begin(_done); it != std::end(_done);) {
+        if (it->first == _completed) {
+          _completed = it->second;
+          _done.erase(it);
+          it = std::begin(_done);
+        }
+        else {
+          ++it;
+        }
+      }
     }
 
+    int _sockfd;
+    uintptr_t _page_size;
+
+    std::mutex _lock;
+    std::atomic_bool _enabled = true;
+    int _deferred_copies_in_a_row = 0;
+    stats_t _stats {};
+
+    // Number of the next zerocopy send, and the number of the first send that hasn't completed yet
+    uint32_t _next_id = 0;
+    uint32_t _completed = 0;
+
+    // Completed ranges of sends beyond _completed, as [first, end) pairs
+    std::vector<std::pair<uint32_t, uint32_t>> _done;
+
+    // Buffers held until all sends before the given number completed
+    std::deque<std::pair<uint32_t, std::shared_ptr<void>>> _held;
+  };
+
+  /**
+   * @brief Get the io_uring of the calling thread, if the io_uring send backend is selected.
+   * @return The ring, or `nullptr` to send with system calls.
+   */
+  static uring::ring_t *
+  send_ring() {
+    thread_local auto ring = config::stream.send_backend == "io_uring"sv ? uring::ring_t::make(64) : nullptr;
+    return ring.get();
+  }
+
+  /**
+   * @brief Whether UDP GSO works on the socket a thread sends on through io_uring.
+   * @details Sends through the ring only report errors when they complete, so the first GSO send
+   * on a socket is waited for to find out whether the kernel and NIC can segment it.
+   */
+  struct gso_probe_t {
+    int sockfd = -1;
+    bool confirmed = false;
+    bool available = true;
+  };
+
+  bool
+  wait_for_sends() {
+    auto ring = send_ring();
+    if (!ring) {
+      return true;
+    }
+
+    ring->wait();
+
+    // Failed sends were already retried with sendmsg(), so these didn't go out at all
+    thread_local std::uint64_t failures = 0;
+    auto lost = ring->failures() - failures;
+    failures = ring->failures();
+
+    return lost == 0;
+  }
+
+  bool
+  send_batch(batched_send_info_t &send_info) {
+    auto sockfd = (int) send_info.native_socket;
+    struct msghdr msg = {};
+
+    // Convert the target address into a sockaddr
+    msg_name_t name = {};
+    fill_msg_name(msg, name, send_info.target_address, send_info.target_port);
+
     union {
-      char buf[CMSG_SPACE(sizeof(uint16_t)) +
+      char buf[CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t)) +
                std::max(CMSG_SPACE(sizeof(struct in_pktinfo)), CMSG_SPACE(sizeof(struct in6_pktinfo)))];
       struct cmsghdr alignment;
     } cmbuf = {};  // Must be zeroed for CMSG_NXTHDR()
@@ -402,47 +764,29 @@ namespace platf {
     msg.msg_controllen = sizeof(cmbuf.buf);
 
     // The PKTINFO option will always be first, then we will conditionally
-    // append the UDP_SEGMENT option next if applicable.
+    // append the UDP_SEGMENT and SCM_TXTIME options next if applicable.
     auto pktinfo_cm = CMSG_FIRSTHDR(&msg);
-    if (send_info.source_address.is_v6()) {
-      struct in6_pktinfo pktInfo;
-
-      struct sockaddr_in6 saddr_v6 = to_sockaddr(send_info.source_address.to_v6(), 0);
-      pktInfo.ipi6_addr = saddr_v6.sin6_addr;
-      pktInfo.ipi6_ifindex = 0;
-
-      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
-
-      pktinfo_cm->cmsg_level = IPPROTO_IPV6;
-      pktinfo_cm->cmsg_type = IPV6_PKTINFO;
-      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
-      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
-    }
-    else {
-      struct in_pktinfo pktInfo;
-
-      struct sockaddr_in saddr_v4 = to_sockaddr(send_info.source_address.to_v4(), 0);
-      pktInfo.ipi_spec_dst = saddr_v4.sin_addr;
-      pktInfo.ipi_ifindex = 0;
-
-      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
-
-      pktinfo_cm->cmsg_level = IPPROTO_IP;
-      pktinfo_cm->cmsg_type = IP_PKTINFO;
-      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
-      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
-    }
+    cmbuflen += fill_pktinfo_cmsg(pktinfo_cm, send_info.source_address);
 
     auto const max_iovs_per_msg = send_info.payload_buffers.size() + (send_info.headers ? 1 : 0);
 
 #ifdef UDP_SEGMENT
-    {
+    if (config::stream.udp_gso) {
       // UDP GSO on Linux currently only supports sending 64K or 64 segments at a time
       size_t seg_index = 0;
       const size_t seg_max = 65536 / 1500;
+      auto zerocopy = (linux_zerocopy_t *) send_info.zerocopy;
+
+      // Zerocopy sends are numbered as they're issued, so they're never handed to the ring
+      auto ring = zerocopy ? nullptr : send_ring();
+      thread_local gso_probe_t gso_probe;
+      if (ring && gso_probe.sockfd != sockfd) {
+        gso_probe = gso_probe_t { sockfd };
+      }
+
       struct iovec iovs[(send_info.headers ? std::min(seg_max, send_info.block_count) : 1) * max_iovs_per_msg] = {};
       auto msg_size = send_info.header_size + send_info.payload_size;
-      while (seg_index < send_info.block_count) {
+      while (seg_index < send_info.block_count && (!ring || gso_probe.available)) {
         int iovlen = 0;
         auto segs_in_batch = std::min(send_info.block_count - seg_index, seg_max);
         if (send_info.headers) {
@@ -470,28 +814,83 @@ namespace platf {
           }
         }
 
+        // Only messages with separate header and payload buffers per segment are sent without copying
+        auto zerocopy_segs = zerocopy && send_info.headers ? zerocopy->segments(iovs, segs_in_batch, msg_size) : 0;
+        if (zerocopy_segs) {
+          segs_in_batch = zerocopy_segs;
+          iovlen = zerocopy_segs * 2;
+        }
+
         msg.msg_iov = iovs;
         msg.msg_iovlen = iovlen;
 
+        auto cm = pktinfo_cm;
+        auto controllen = cmbuflen;
+        msg.msg_controllen = sizeof(cmbuf.buf);
+
         // We should not use GSO if the data is <= one full block size
         if (segs_in_batch > 1) {
-          msg.msg_controllen = cmbuflen + CMSG_SPACE(sizeof(uint16_t));
+          controllen += CMSG_SPACE(sizeof(uint16_t));
 
           // Enable GSO to perform segmentation of our buffer for us
-          auto cm = CMSG_NXTHDR(&msg, pktinfo_cm);
+          cm = CMSG_NXTHDR(&msg, cm);
           cm->cmsg_level = SOL_UDP;
           cm->cmsg_type = UDP_SEGMENT;
           cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
           *((uint16_t *) CMSG_DATA(cm)) = msg_size;
         }
-        else {
-          msg.msg_controllen = cmbuflen;
+
+        // All segments of a GSO batch are released at the launch time of its first segment
+        if (send_info.launch_time) {
+          controllen += CMSG_SPACE(sizeof(uint64_t));
+
+          cm = CMSG_NXTHDR(&msg, cm);
+          fill_txtime_cmsg(cm, *send_info.launch_time + send_info.launch_interval * seg_index);
         }
 
+        msg.msg_controllen = controllen;
+
         // This will fail if GSO is not available, so we will fall back to non-GSO if
         // it's the first sendmsg() call. On subsequent calls, we will treat errors as
         // actual failures and return to the caller.
-        auto bytes_sent = sendmsg(sockfd, &msg, 0);
+        ssize_t bytes_sent;
+        if (ring) {
+          // Earlier sends must complete first, so a failure can be blamed on the GSO send
+          auto probe = segs_in_batch > 1 && !gso_probe.confirmed;
+          if (probe) {
+            ring->wait();
+          }
+
+          // The kernel waits for send buffer space by itself, so earlier sends still waiting for it are the
+          // closest to the EAGAIN the system calls run into
+          if (!probe && ring->pending()) {
+            ++send_info.stalls;
+          }
+
+          // The buffers stay in use until wait_for_sends()
+          auto failures = ring->failures();
+          bytes_sent = ring->submit(sockfd, std::span { &msg, 1 }) ? segs_in_batch * msg_size : -1;
+          if (probe && bytes_sent >= 0) {
+            ring->wait();
+
+            if (ring->failures() == failures) {
+              gso_probe.confirmed = true;
+            }
+            else {
+              errno = ring->last_error();
+              bytes_sent = -1;
+
+              // Without GSO support, the rest of the stream is sent with sendmmsg()
+              if (errno == EIO || errno == EINVAL) {
+                BOOST_LOG(info) << "UDP GSO is not available through io_uring: "sv << errno;
+                gso_probe.available = false;
+              }
+            }
+          }
+        }
+        else {
+          bytes_sent = zerocopy ? zerocopy->send(&msg, zerocopy_segs != 0) : sendmsg(sockfd, &msg, 0);
+        }
         if (bytes_sent < 0) {
           // If there's no send buffer space, wait for some to be available
           if (errno == EAGAIN) {
@@ -500,6 +899,7 @@ namespace platf {
             pfd.fd = sockfd;
             pfd.events = POLLOUT;
 
+            ++send_info.stalls;
             if (poll(&pfd, 1, -1) != 1) {
               BOOST_LOG(warning) << "poll() failed: "sv << errno;
               break;
@@ -527,6 +927,9 @@ namespace platf {
       // If GSO is not supported, use sendmmsg() instead.
       struct mmsghdr msgs[send_info.block_count] = {};
       struct iovec iovs[send_info.block_count * (send_info.headers ? 2 : 1)] = {};
+
+      // Each message has its own launch time, so they can't share the control data
+      decltype(cmbuf) msg_cmbufs[send_info.launch_time ? send_info.block_count : 1] = {};
       int iov_idx = 0;
       for (size_t i = 0; i < send_info.block_count; i++) {
         msgs[i].msg_hdr.msg_iov = &iovs[iov_idx];
@@ -544,8 +947,23 @@ namespace platf {
 
         msgs[i].msg_hdr.msg_name = msg.msg_name;
         msgs[i].msg_hdr.msg_namelen = msg.msg_namelen;
-        msgs[i].msg_hdr.msg_control = cmbuf.buf;
-        msgs[i].msg_hdr.msg_controllen = cmbuflen;
+
+        if (send_info.launch_time) {
+          auto &msg_cmbuf = msg_cmbufs[i];
+          memcpy(msg_cmbuf.buf, cmbuf.buf, cmbuflen);
+
+          msgs[i].msg_hdr.msg_control = msg_cmbuf.buf;
+          msgs[i].msg_hdr.msg_controllen = sizeof(msg_cmbuf.buf);
+
+          auto cm = CMSG_NXTHDR(&msgs[i].msg_hdr, CMSG_FIRSTHDR(&msgs[i].msg_hdr));
+          fill_txtime_cmsg(cm, *send_info.launch_time + send_info.launch_interval * i);
+
+          msgs[i].msg_hdr.msg_controllen = cmbuflen + CMSG_SPACE(sizeof(uint64_t));
+        }
+        else {
+          msgs[i].msg_hdr.msg_control = cmbuf.buf;
+          msgs[i].msg_hdr.msg_controllen = cmbuflen;
+        }
       }
 
       // Call sendmmsg() until all messages are sent
@@ -560,6 +978,7 @@ namespace platf {
             pfd.fd = sockfd;
             pfd.events = POLLOUT;
 
+            ++send_info.stalls;
             if (poll(&pfd, 1, -1) != 1) {
               BOOST_LOG(warning) << "poll() failed: "sv << errno;
               break;
@@ -576,6 +995,11 @@ namespace platf {
         blocks_sent += msgs_sent;
       }
 
+      // Single packets are too small to be worth sending without copying
+      if (send_info.zerocopy) {
+        ((linux_zerocopy_t *) send_info.zerocopy)->copied(blocks_sent);
+      }
+
       return true;
     }
   }
@@ -586,20 +1010,8 @@ namespace platf {
     struct msghdr msg = {};
 
     // Convert the target address into a sockaddr
-    struct sockaddr_in taddr_v4 = {};
-    struct sockaddr_in6 taddr_v6 = {};
-    if (send_info.target_address.is_v6()) {
-      taddr_v6 = to_sockaddr(send_info.target_address.to_v6(), send_info.target_port);
-
-      msg.msg_name = (struct sockaddr *) &taddr_v6;
-      msg.msg_namelen = sizeof(taddr_v6);
-    }
-    else {
-      taddr_v4 = to_sockaddr(send_info.target_address.to_v4(), send_info.target_port);
-
-      msg.msg_name = (struct sockaddr *) &taddr_v4;
-      msg.msg_namelen = sizeof(taddr_v4);
-    }
+    msg_name_t name = {};
+    fill_msg_name(msg, name, send_info.target_address, send_info.target_port);
 
     union {
       char buf[std::max(CMSG_SPACE(sizeof(struct in_pktinfo)), CMSG_SPACE(sizeof(struct in6_pktinfo)))];
@@ -611,51 +1023,20 @@ namespace platf {
     msg.msg_controllen = sizeof(cmbuf.buf);
 
     auto pktinfo_cm = CMSG_FIRSTHDR(&msg);
-    if (send_info.source_address.is_v6()) {
-      struct in6_pktinfo pktInfo;
-
-      struct sockaddr_in6 saddr_v6 = to_sockaddr(send_info.source_address.to_v6(), 0);
-      pktInfo.ipi6_addr = saddr_v6.sin6_addr;
-      pktInfo.ipi6_ifindex = 0;
-
-      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
-
-      pktinfo_cm->cmsg_level = IPPROTO_IPV6;
-      pktinfo_cm->cmsg_type = IPV6_PKTINFO;
-      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
-      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
-    }
-    else {
-      struct in_pktinfo pktInfo;
-
-      struct sockaddr_in saddr_v4 = to_sockaddr(send_info.source_address.to_v4(), 0);
-      pktInfo.ipi_spec_dst = saddr_v4.sin_addr;
-      pktInfo.ipi_ifindex = 0;
-
-      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
-
-      pktinfo_cm->cmsg_level = IPPROTO_IP;
-      pktinfo_cm->cmsg_type = IP_PKTINFO;
-      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
-      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
-    }
+    cmbuflen += fill_pktinfo_cmsg(pktinfo_cm, send_info.source_address);
 
     struct iovec iovs[2] = {};
-    int iovlen = 0;
-    if (send_info.header) {
-      iovs[iovlen].iov_base = (void *) send_info.header;
-      iovs[iovlen].iov_len = send_info.header_size;
-      iovlen++;
-    }
-    iovs[iovlen].iov_base = (void *) send_info.payload;
-    iovs[iovlen].iov_len = send_info.payload_size;
-    iovlen++;
-
     msg.msg_iov = iovs;
-    msg.msg_iovlen = iovlen;
+    msg.msg_iovlen = fill_iovs(iovs, send_info);
 
     msg.msg_controllen = cmbuflen;
 
+    // The caller may reuse its buffers right away, so the data is copied instead of waiting for the send
+    // to complete. A send that fails is retried with sendmsg() once its completion is reaped.
+    if (auto ring = send_ring(); ring && ring->submit(sockfd, std::span { &msg, 1 }, true)) {
+      return true;
+    }
+
     auto bytes_sent = sendmsg(sockfd, &msg, 0);
 
     // If there's no send buffer space, wait for some to be available
@@ -682,6 +1063,89 @@ namespace platf {
     return true;
   }
 
+  bool
+  send_multiple(std::span<send_info_t> send_infos) {
+    // Messages are built on the stack, so more of them are sent in several calls
+    constexpr std::size_t MAX_MESSAGES = 8;
+
+    struct message_t {
+      msg_name_t name;
+
+      alignas(struct cmsghdr) char control[std::max(CMSG_SPACE(sizeof(struct in_pktinfo)), CMSG_SPACE(sizeof(struct in6_pktinfo)))];
+
+      struct iovec iovs[2];
+    };
+
+    for (std::size_t first = 0; first < send_infos.size(); first += MAX_MESSAGES) {
+      auto chunk = send_infos.subspan(first, std::min(MAX_MESSAGES, send_infos.size() - first));
+      auto sockfd = (int) chunk[0].native_socket;
+
+      std::array<message_t, MAX_MESSAGES> messages;
+      std::array<struct mmsghdr, MAX_MESSAGES> msgs {};
+      for (std::size_t x = 0; x < chunk.size(); ++x) {
+        auto &send_info = chunk[x];
+        auto &message = messages[x];
+        auto &msg = msgs[x].msg_hdr;
+
+        fill_msg_name(msg, message.name, send_info.target_address, send_info.target_port);
+
+        std::memset(message.control, 0, sizeof(message.control));
+        msg.msg_control = message.control;
+        msg.msg_controllen = sizeof(message.control);
+
+        auto pktinfo_cm = CMSG_FIRSTHDR(&msg);
+        msg.msg_controllen = fill_pktinfo_cmsg(pktinfo_cm, send_info.source_address);
+
+        msg.msg_iov = message.iovs;
+        msg.msg_iovlen = fill_iovs(message.iovs, send_info);
+      }
+
+      if (auto ring = send_ring()) {
+        std::array<struct msghdr, MAX_MESSAGES> ring_msgs;
+        for (std::size_t x = 0; x < chunk.size(); ++x) {
+          ring_msgs[x] = msgs[x].msg_hdr;
+        }
+
+        // Like with send(), the data is copied so the caller may reuse its buffers right away
+        if (ring->submit(sockfd, std::span { ring_msgs }.first(chunk.size()), true)) {
+          continue;
+        }
+
+        // Send this chunk with sendmmsg() instead, so it isn't lost
+        BOOST_LOG(warning) << "Couldn't submit "sv << chunk.size() << " messages to io_uring"sv;
+      }
+
+      std::size_t sent = 0;
+      while (sent < chunk.size()) {
+        auto msgs_sent = sendmmsg(sockfd, msgs.data() + sent, chunk.size() - sent, 0);
+        if (msgs_sent >= 0) {
+          sent += msgs_sent;
+          continue;
+        }
+
+        // If there's no send buffer space, wait for some to be available
+        if (errno == EAGAIN) {
+          struct pollfd pfd;
+
+          pfd.fd = sockfd;
+          pfd.events = POLLOUT;
+
+          if (poll(&pfd, 1, -1) == 1) {
+            continue;
+          }
+
+          BOOST_LOG(warning) << "poll() failed: "sv << errno;
+          break;
+        }
+
+        BOOST_LOG(warning) << "sendmmsg() failed: "sv << errno;
+        break;
+      }
+    }
+
+    return true;
+  }
+
   // We can't track QoS state separately for each destination on this OS,
   // so we keep a ref count to only disable QoS options when all clients
   // are disconnected.
@@ -785,6 +1249,36 @@ namespace platf {
     return std::make_unique<qos_t>(sockfd, reset_options);
   }
 
+  bool
+  enable_socket_txtime(uintptr_t native_socket) {
+#ifdef SO_TXTIME
+    // The fq and etf queueing disciplines schedule packets against CLOCK_MONOTONIC
+    struct sock_txtime txtime = {};
+    txtime.clockid = CLOCK_MONOTONIC;
+
+    if (setsockopt((int) native_socket, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime))) {
+      BOOST_LOG(warning) << "Failed to set SO_TXTIME: "sv << errno;
+      return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  std::unique_ptr<zerocopy_t>
+  enable_socket_zerocopy(uintptr_t native_socket) {
+    // UDP sockets support zerocopy since Linux 5.0
+    int enable = 1;
+    if (setsockopt((int) native_socket, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable))) {
+      BOOST_LOG(warning) << "Failed to set SO_ZEROCOPY: "sv << errno;
+      return nullptr;
+    }
+
+    return std::make_unique<linux_zerocopy_t>((int) native_socket);
+  }
+
   namespace source {
     enum source_e : std::size_t {
 #ifdef SUNSHINE_BUILD_CUDA
@@ -799,6 +1293,7 @@ namespace platf {
 #ifdef SUNSHINE_BUILD_X11
       X11,  ///< X11
 #endif
+      SYNTHETIC,  ///< Synthetic test patterns
       MAX_FLAGS  ///< The maximum number of flags
     };
   }  // namespace source
@@ -868,6 +1363,7 @@ namespace platf {
 #ifdef SUNSHINE_BUILD_X11
     if (sources[source::X11]) return x11_display_names();
 #endif
+    if (sources[source::SYNTHETIC]) return synthetic::display_names();
     return {};
   }
 
@@ -907,6 +1403,10 @@ namespace platf {
       return x11_display(hwdevice_type, display_name, config);
     }
 #endif
+    if (sources[source::SYNTHETIC]) {
+      BOOST_LOG(info) << "Generating synthetic frames"sv;
+      return synthetic::display(hwdevice_type, display_name, config);
+    }
 
     return nullptr;
   }
@@ -962,6 +1462,10 @@ namespace platf {
       }
     }
 #endif
+    // Never picked automatically, since it doesn't show the desktop
+    if (config::video.capture == "synthetic") {
+      sources[source::SYNTHETIC] = true;
+    }
 
     if (sources.none()) {
       BOOST_LOG(error) << "Unable to initialize capture method"sv;
@@ -977,18 +1481,54 @@ namespace platf {
 
   class linux_high_precision_timer: public high_precision_timer {
   public:
+    /**
+     * @param spin_tail How long before the deadline to stop sleeping and busy-wait instead.
+     */
+    explicit linux_high_precision_timer(std::chrono::nanoseconds spin_tail):
+        spin_tail { spin_tail } {
+      // The default timer slack of 50us would dominate the sub-millisecond sleeps used for pacing.
+      // Timer slack is a property of the calling thread, so the timer must be created by the thread using it.
+      if (prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL)) {
+        BOOST_LOG(warning) << "Unable to reduce timer slack: "sv << errno;
+      }
+    }
+
     void
     sleep_for(const std::chrono::nanoseconds &duration) override {
-      std::this_thread::sleep_for(duration);
+      sleep_until(std::chrono::steady_clock::now() + duration);
+    }
+
+    void
+    sleep_until(const std::chrono::steady_clock::time_point &deadline) override {
+      // std::chrono::steady_clock is CLOCK_MONOTONIC, so the deadline can be passed to the kernel as is
+      auto wake_up = std::chrono::duration_cast<std::chrono::nanoseconds>((deadline - spin_tail).time_since_epoch()).count();
+
+      timespec ts;
+      ts.tv_sec = wake_up / std::nano::den;
+      ts.tv_nsec = wake_up % std::nano::den;
+
+      // The deadline is absolute, so the sleep can be resumed as is after a signal
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+
+      while (std::chrono::steady_clock::now() < deadline) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+      }
     }
 
     operator bool() override {
       return true;
     }
+
+  private:
+    std::chrono::nanoseconds spin_tail;
   };
 
   std::unique_ptr<high_precision_timer>
   create_high_precision_timer() {
-    return std::make_unique<linux_high_precision_timer>();
+    return std::make_unique<linux_high_precision_timer>(config::stream.pacing_spin);
   }
 }  // namespace platf
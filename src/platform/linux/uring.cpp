@@ -0,0 +1,332 @@
+/**
+ * @file src/platform/linux/uring.cpp
+ * @brief Definitions for sending on sockets through io_uring.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/syscall.h>
+
+#include "src/logging.h"
+#include "uring.h"
+
+using namespace std::literals;
+
+namespace uring {
+  // liburing isn't a dependency, the few system calls needed are made directly
+  static int
+  io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+  }
+
+  static int
+  io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+  }
+
+  static int
+  io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+  }
+
+  /**
+   * @brief Send a message with a system call, waiting for send buffer space if there is none.
+   * @return `true` if the message was sent, otherwise `errno` is set.
+   */
+  static bool
+  send_now(int sockfd, const struct msghdr *msg) {
+    while (sendmsg(sockfd, msg, 0) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if (errno != EAGAIN) {
+        return false;
+      }
+
+      struct pollfd pfd {};
+      pfd.fd = sockfd;
+      pfd.events = POLLOUT;
+      if (poll(&pfd, 1, -1) != 1) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::unique_ptr<ring_t>
+  ring_t::make(unsigned entries) {
+    struct io_uring_params params = {};
+
+    std::unique_ptr<ring_t> ring { new ring_t };
+    ring->_fd.el = io_uring_setup(entries, &params);
+    if (ring->_fd.el < 0) {
+      BOOST_LOG(warning) << "io_uring_setup() failed: "sv << errno;
+      return nullptr;
+    }
+
+    // A dropped completion would leak its slot
+    if (!(params.features & IORING_FEAT_NODROP)) {
+      BOOST_LOG(warning) << "io_uring is too old, it may drop completions"sv;
+      return nullptr;
+    }
+
+    ring->_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->_sq_ring_size = ring->_cq_ring_size = std::max(ring->_sq_ring_size, ring->_cq_ring_size);
+    }
+
+    ring->_sq_ring = mmap(nullptr, ring->_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->_fd.el, IORING_OFF_SQ_RING);
+    if (ring->_sq_ring == MAP_FAILED) {
+      BOOST_LOG(warning) << "Couldn't map io_uring submission queue: "sv << errno;
+      return nullptr;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->_cq_ring = ring->_sq_ring;
+    }
+    else {
+      ring->_cq_ring = mmap(nullptr, ring->_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->_fd.el, IORING_OFF_CQ_RING);
+      if (ring->_cq_ring == MAP_FAILED) {
+        BOOST_LOG(warning) << "Couldn't map io_uring completion queue: "sv << errno;
+        return nullptr;
+      }
+    }
+
+    ring->_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->_sqes = (struct io_uring_sqe *) mmap(nullptr, ring->_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->_fd.el, IORING_OFF_SQES);
+    if (ring->_sqes == MAP_FAILED) {
+      BOOST_LOG(warning) << "Couldn't map io_uring submission queue entries: "sv << errno;
+      return nullptr;
+    }
+
+    auto sq_ring = (char *) ring->_sq_ring;
+    ring->_sq_tail = (unsigned *) (sq_ring + params.sq_off.tail);
+    ring->_sq_mask = (unsigned *) (sq_ring + params.sq_off.ring_mask);
+    ring->_sq_array = (unsigned *) (sq_ring + params.sq_off.array);
+
+    auto cq_ring = (char *) ring->_cq_ring;
+    ring->_cq_head = (unsigned *) (cq_ring + params.cq_off.head);
+    ring->_cq_tail = (unsigned *) (cq_ring + params.cq_off.tail);
+    ring->_cq_mask = (unsigned *) (cq_ring + params.cq_off.ring_mask);
+    ring->_cqes = (struct io_uring_cqe *) (cq_ring + params.cq_off.cqes);
+
+    ring->_slots.resize(params.sq_entries);
+    for (unsigned x = params.sq_entries; x > 0; --x) {
+      ring->_free_slots.emplace_back(x - 1);
+    }
+
+    return ring;
+  }
+
+  ring_t::~ring_t() {
+    if (_in_flight) {
+      wait();
+    }
+
+    if (_resent || _failures) {
+      BOOST_LOG(debug) << "io_uring sends resent: "sv << _resent << ", lost: "sv << _failures;
+    }
+
+    if (_sqes != MAP_FAILED) {
+      munmap(_sqes, _sqes_size);
+    }
+    if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) {
+      munmap(_cq_ring, _cq_ring_size);
+    }
+    if (_sq_ring != MAP_FAILED) {
+      munmap(_sq_ring, _sq_ring_size);
+    }
+  }
+
+  /**
+   * Registering the socket saves looking up its file for every send.
+   * Kernels without fixed file support get the socket itself.
+   */
+  int
+  ring_t::file_index(int sockfd) {
+    if (!_fixed_files) {
+      return -1;
+    }
+
+    if (_fixed_fd == sockfd) {
+      return 0;
+    }
+
+    int result;
+    if (_fixed_fd < 0) {
+      result = io_uring_register(_fd.el, IORING_REGISTER_FILES, &sockfd, 1);
+    }
+    else {
+      struct io_uring_files_update update = {};
+      update.offset = 0;
+      update.fds = (std::uint64_t) &sockfd;
+
+      result = io_uring_register(_fd.el, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    }
+
+    if (result < 0) {
+      BOOST_LOG(debug) << "Couldn't register socket with io_uring: "sv << errno;
+      _fixed_files = false;
+      return -1;
+    }
+
+    _fixed_fd = sockfd;
+    return 0;
+  }
+
+  bool
+  ring_t::submit(int sockfd, std::span<const struct msghdr> msgs, bool copy_data) {
+    if (msgs.size() > _slots.size()) {
+      return false;
+    }
+
+    for (auto &msg : msgs) {
+      if (msg.msg_namelen > sizeof(slot_t::name) || msg.msg_controllen > sizeof(slot_t::control)) {
+        BOOST_LOG(error) << "Message doesn't fit in an io_uring slot"sv;
+        return false;
+      }
+    }
+
+    wait(_slots.size() - msgs.size());
+
+    auto index = file_index(sockfd);
+
+    // A message still waiting for buffer space must go out before the new ones
+    auto drain = _in_flight > 0;
+
+    auto tail = std::atomic_ref { *_sq_tail }.load(std::memory_order_relaxed);
+    for (std::size_t x = 0; x < msgs.size(); ++x) {
+      auto &msg = msgs[x];
+
+      // Messages and their control data are read when the send is issued, which may be after
+      // submission returned, so they're kept in the slot until the send completes
+      auto slot_index = _free_slots.back();
+      auto &slot = _slots[slot_index];
+      _free_slots.pop_back();
+
+      slot.sockfd = sockfd;
+      slot.msg = msg;
+      std::memcpy(&slot.name, msg.msg_name, msg.msg_namelen);
+      slot.msg.msg_name = &slot.name;
+      std::memcpy(slot.control, msg.msg_control, msg.msg_controllen);
+      slot.msg.msg_control = msg.msg_controllen ? slot.control : nullptr;
+      if (copy_data) {
+        // A datagram is the concatenation of its buffers, so the copy needs a single one
+        std::size_t size = 0;
+        for (std::size_t y = 0; y < msg.msg_iovlen; ++y) {
+          size += msg.msg_iov[y].iov_len;
+        }
+
+        slot.data.resize(size);
+        auto data = slot.data.data();
+        for (std::size_t y = 0; y < msg.msg_iovlen; ++y) {
+          std::memcpy(data, msg.msg_iov[y].iov_base, msg.msg_iov[y].iov_len);
+          data += msg.msg_iov[y].iov_len;
+        }
+
+        slot.iovs.assign(1, { slot.data.data(), size });
+      }
+      else {
+        slot.iovs.assign(msg.msg_iov, msg.msg_iov + msg.msg_iovlen);
+      }
+      slot.msg.msg_iov = slot.iovs.data();
+      slot.msg.msg_iovlen = slot.iovs.size();
+
+      auto &sqe = _sqes[tail & *_sq_mask];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_SENDMSG;
+      sqe.fd = index < 0 ? sockfd : index;
+      sqe.addr = (std::uint64_t) &slot.msg;
+      sqe.len = 1;
+      sqe.user_data = slot_index;
+
+      if (index >= 0) {
+        sqe.flags |= IOSQE_FIXED_FILE;
+      }
+      if (x == 0 && drain) {
+        sqe.flags |= IOSQE_IO_DRAIN;
+      }
+      if (x + 1 < msgs.size()) {
+        // Linked sends are issued one after the other, so the packets stay in order
+        sqe.flags |= IOSQE_IO_LINK;
+      }
+
+      _sq_array[tail & *_sq_mask] = tail & *_sq_mask;
+      ++tail;
+      ++_in_flight;
+    }
+    std::atomic_ref { *_sq_tail }.store(tail, std::memory_order_release);
+
+    unsigned submitted = 0;
+    while (submitted < msgs.size()) {
+      auto result = io_uring_enter(_fd.el, msgs.size() - submitted, 0, 0);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        // The completion queue is full, make room for the rest
+        if (errno == EAGAIN || errno == EBUSY) {
+          reap();
+          io_uring_enter(_fd.el, 0, 1, IORING_ENTER_GETEVENTS);
+          continue;
+        }
+
+        BOOST_LOG(error) << "io_uring_enter() failed: "sv << errno;
+        return false;
+      }
+
+      submitted += result;
+    }
+
+    return true;
+  }
+
+  void
+  ring_t::wait(unsigned in_flight) {
+    reap();
+
+    while (_in_flight > in_flight) {
+      if (io_uring_enter(_fd.el, 0, _in_flight - in_flight, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+        BOOST_LOG(error) << "io_uring_enter() failed: "sv << errno;
+        return;
+      }
+
+      reap();
+    }
+  }
+
+  void
+  ring_t::reap() {
+    auto head = std::atomic_ref { *_cq_head }.load(std::memory_order_relaxed);
+    auto tail = std::atomic_ref { *_cq_tail }.load(std::memory_order_acquire);
+
+    for (; head != tail; ++head) {
+      auto &cqe = _cqes[head & *_cq_mask];
+
+      // The sends linked after a failed send are canceled, they're retried along with it.
+      // The data is valid until the send is reaped, so it can still go out with a system call.
+      if (cqe.res < 0) {
+        auto &slot = _slots[cqe.user_data];
+        if (send_now(slot.sockfd, &slot.msg)) {
+          ++_resent;
+        }
+        else {
+          BOOST_LOG(verbose) << "io_uring sendmsg() failed: "sv << -cqe.res << ", sendmsg() failed: "sv << errno;
+          _last_error = errno;
+          ++_failures;
+        }
+      }
+
+      _free_slots.emplace_back((unsigned) cqe.user_data);
+      --_in_flight;
+    }
+
+    std::atomic_ref { *_cq_head }.store(head, std::memory_order_release);
+  }
+}  // namespace uring
@@ -0,0 +1,142 @@
+/**
+ * @file src/platform/linux/uring.h
+ * @brief Declarations for sending on sockets through io_uring.
+ */
+#pragma once
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "misc.h"
+
+namespace uring {
+  /**
+   * @brief An io_uring instance submitting socket sends.
+   * @details Not thread-safe, each sending thread owns its ring. The socket being sent on is
+   * registered with the ring, so a ring must not outlive the sockets it sends on.
+   */
+  class ring_t {
+  public:
+    /**
+     * @brief Set up a ring.
+     * @param entries The highest number of sends in flight.
+     * @return The ring, or `nullptr` if io_uring isn't available.
+     */
+    static std::unique_ptr<ring_t>
+    make(unsigned entries);
+
+    ~ring_t();
+
+    ring_t(const ring_t &) = delete;
+    ring_t &
+    operator=(const ring_t &) = delete;
+
+    /**
+     * @brief Submit messages to be sent in order with a single system call.
+     * @details The messages are copied. Unless `copy_data` is set, the data they point to must stay
+     * valid until `wait()` says the sends completed. A send that fails is retried with `sendmsg()`
+     * when its completion is reaped.
+     * @param sockfd The socket to send on.
+     * @param msgs The messages to send.
+     * @param copy_data Whether to copy the data too, so the caller may reuse its buffers right away.
+     * @return `true` if the messages were submitted.
+     */
+    bool
+    submit(int sockfd, std::span<const struct msghdr> msgs, bool copy_data = false);
+
+    /**
+     * @brief Wait until few enough sends are in flight.
+     * @param in_flight The number of sends that may still be in flight.
+     */
+    void
+    wait(unsigned in_flight = 0);
+
+    /**
+     * @brief Get the number of sends that haven't completed yet.
+     * @details Sends are issued as they're submitted, so sends that are still in flight wait for
+     * send buffer space.
+     * @return The number of sends in flight.
+     */
+    unsigned
+    pending() {
+      reap();
+      return _in_flight;
+    }
+
+    /**
+     * @brief Get the number of lost sends.
+     * @return The number of sends that completed with an error, and failed again when retried.
+     */
+    std::uint64_t
+    failures() const {
+      return _failures;
+    }
+
+    /**
+     * @brief Get the error of the last failed send.
+     * @return The `errno` value the last lost send was retried with, or 0 if none was lost.
+     */
+    int
+    last_error() const {
+      return _last_error;
+    }
+
+  private:
+    ring_t() = default;
+
+    /**
+     * @brief A submitted message, copied so the caller's message may go out of scope.
+     */
+    struct slot_t {
+      int sockfd;
+      struct msghdr msg;
+      struct sockaddr_in6 name;
+      alignas(struct cmsghdr) char control[128];
+      std::vector<struct iovec> iovs;
+
+      // The data of the message, if it's copied
+      std::vector<char> data;
+    };
+
+    int
+    file_index(int sockfd);
+
+    void
+    reap();
+
+    file_t _fd;
+
+    void *_sq_ring = MAP_FAILED;
+    std::size_t _sq_ring_size = 0;
+    void *_cq_ring = MAP_FAILED;
+    std::size_t _cq_ring_size = 0;
+    struct io_uring_sqe *_sqes = (struct io_uring_sqe *) MAP_FAILED;
+    std::size_t _sqes_size = 0;
+
+    unsigned *_sq_tail;
+    unsigned *_sq_mask;
+    unsigned *_sq_array;
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned *_cq_mask;
+    struct io_uring_cqe *_cqes;
+
+    std::vector<slot_t> _slots;
+    std::vector<unsigned> _free_slots;
+    unsigned _in_flight = 0;
+
+    // The socket registered as fixed file 0, if the kernel supports fixed files
+    int _fixed_fd = -1;
+    bool _fixed_files = true;
+
+    std::uint64_t _failures = 0;
+    std::uint64_t _resent = 0;
+    int _last_error = 0;
+  };
+}  // namespace uring
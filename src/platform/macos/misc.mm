@@ -303,6 +303,12 @@ namespace platf {
     return false;
   }
 
+  bool
+  wait_for_sends() {
+    // Sends always complete before send_batch() returns on macOS
+    return true;
+  }
+
   bool
   send(send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
@@ -405,6 +411,12 @@ namespace platf {
     return true;
   }
 
+  bool
+  send_multiple(std::span<send_info_t> send_infos) {
+    // Fall back to unbatched send calls
+    return false;
+  }
+
   // We can't track QoS state separately for each destination on this OS,
   // so we keep a ref count to only disable QoS options when all clients
   // are disconnected.
@@ -433,6 +445,18 @@ namespace platf {
     std::vector<std::tuple<int, int, int>> options;
   };
 
+  bool
+  enable_socket_txtime(uintptr_t native_socket) {
+    // Launch times are not supported on macOS
+    return false;
+  }
+
+  std::unique_ptr<zerocopy_t>
+  enable_socket_zerocopy(uintptr_t native_socket) {
+    // Zerocopy sends are not supported on macOS
+    return nullptr;
+  }
+
   /**
    * @brief Enables QoS on the given socket for traffic to the specified destination.
    * @param native_socket The native socket handle.
@@ -0,0 +1,465 @@
+/**
+ * @file src/platform/synthetic.cpp
+ * @brief Definitions for the synthetic display, which generates its frames instead of capturing them.
+ */
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "src/config.h"
+#include "src/logging.h"
+#include "src/platform/common.h"
+#include "src/video.h"
+#include "synthetic.h"
+
+using namespace std::literals;
+
+namespace platf::synthetic {
+  namespace bip = boost::interprocess;
+
+  enum class pattern_e : int {
+    gradient,  ///< Gradients moving across the whole screen
+    text,  ///< Text scrolling like in a terminal or on a web page
+    noise,  ///< Noise that changes every pixel of every frame
+    desktop,  ///< A desktop that stays the same, except for a blinking caret
+    replay,  ///< Raw BGR0 frames, replayed from a file in a loop
+  };
+
+  constexpr std::array pattern_names {
+    "gradient"sv,
+    "text"sv,
+    "noise"sv,
+    "desktop"sv,
+    "replay"sv,
+  };
+
+  // Text is made up of 8x16 cells, like a console font
+  constexpr int GLYPH_WIDTH = 8;
+  constexpr int GLYPH_HEIGHT = 16;
+  constexpr int GLYPHS = 64;
+
+  // Pixels the text pattern scrolls by per frame
+  constexpr int SCROLL_SPEED = 2;
+
+  constexpr auto CARET_BLINK = 500ms;
+
+  /**
+   * @brief A BGR0 pixel.
+   */
+  constexpr std::uint32_t
+  bgr0(std::uint8_t r, std::uint8_t g, std::uint8_t b) {
+    return (std::uint32_t) r << 16 | (std::uint32_t) g << 8 | b;
+  }
+
+  /**
+   * @brief A fast generator, seeded the same every time so every run generates the same frames.
+   */
+  struct xorshift_t {
+    std::uint64_t state = 0x2545F4914F6CDD1D;
+
+    std::uint64_t
+    operator()() {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+
+      return state;
+    }
+  };
+
+  struct synthetic_img_t: public img_t {
+    std::unique_ptr<std::uint8_t[]> buffer;
+  };
+
+  /**
+   * @brief An image that isn't tied to a capture, used to draw the static parts of a pattern once.
+   */
+  struct canvas_t {
+    canvas_t(int width, int height):
+        width { width }, height { height }, pixels((std::size_t) width * height) {}
+
+    void
+    fill(int x, int y, int w, int h, std::uint32_t color) {
+      x = std::clamp(x, 0, width);
+      y = std::clamp(y, 0, height);
+      w = std::clamp(w, 0, width - x);
+      h = std::clamp(h, 0, height - y);
+
+      for (auto row = y; row < y + h; ++row) {
+        std::fill_n(&pixels[(std::size_t) row * width + x], w, color);
+      }
+    }
+
+    /**
+     * @brief Fill a box with lines of words made up of made up glyphs.
+     */
+    void
+    text(int x, int y, int w, int h, std::uint32_t color, xorshift_t &rng) {
+      // Glyphs are 6x10 pixels of random strokes within their cell
+      static const auto glyphs = []() {
+        xorshift_t rng;
+
+        std::array<std::array<std::uint8_t, 10>, GLYPHS> glyphs;
+        for (auto &glyph : glyphs) {
+          for (auto &row : glyph) {
+            auto bits = rng();
+            row = (std::uint8_t) ((bits & (bits >> 8)) | (bits >> 16)) & 0x3F;
+          }
+        }
+
+        return glyphs;
+      }();
+
+      // Boxes narrower than a glyph, or of negative size on tiny displays, get no text
+      auto columns = std::max(0, w / GLYPH_WIDTH);
+      for (auto line = y; line + GLYPH_HEIGHT <= y + h; line += GLYPH_HEIGHT) {
+        // Leave some lines empty, and let the others end at different lengths
+        if (rng() % 8 == 0) {
+          continue;
+        }
+        auto line_end = columns / 2 + (int) (rng() % (columns / 2 + 1));
+
+        auto column = 0;
+        while (true) {
+          auto word = 2 + (int) (rng() % 8);
+          if (column + word > line_end) {
+            break;
+          }
+
+          for (auto end = column + word; column < end; ++column) {
+            auto &glyph = glyphs[rng() % GLYPHS];
+            for (auto row = 0; row < (int) glyph.size(); ++row) {
+              auto pixel = &pixels[(std::size_t) (line + 3 + row) * width + x + column * GLYPH_WIDTH + 1];
+              for (auto bit = 0; bit < 6; ++bit) {
+                if (glyph[row] & (1 << bit)) {
+                  pixel[bit] = color;
+                }
+              }
+            }
+          }
+
+          // The space between words
+          ++column;
+        }
+      }
+    }
+
+    int width;
+    int height;
+    std::vector<std::uint32_t> pixels;
+  };
+
+  class synthetic_display_t: public platf::display_t {
+  public:
+    int
+    init(const std::string &display_name, const ::video::config_t &config) {
+      auto name = display_name.empty() ? pattern_names.front() : std::string_view { display_name };
+      auto pattern = std::find(std::begin(pattern_names), std::end(pattern_names), name);
+      if (pattern == std::end(pattern_names)) {
+        BOOST_LOG(error) << "Unknown synthetic display ["sv << display_name << ']';
+        return -1;
+      }
+      _pattern = (pattern_e) (pattern - std::begin(pattern_names));
+
+      if (config.width <= 0 || config.height <= 0 || config.framerate <= 0) {
+        BOOST_LOG(error) << "Invalid synthetic display mode: "sv << config.width << 'x' << config.height << 'x' << config.framerate;
+        return -1;
+      }
+
+      width = config.width;
+      height = config.height;
+      env_width = width;
+      env_height = height;
+      _delay = std::chrono::nanoseconds { 1s } / config.framerate;
+
+      _timer = create_high_precision_timer();
+      if (!_timer || !*_timer) {
+        BOOST_LOG(error) << "Failed to create timer for the synthetic display"sv;
+        return -1;
+      }
+
+      xorshift_t rng;
+      switch (_pattern) {
+        case pattern_e::text: {
+          // Scrolling wraps around a page that's taller than the screen
+          canvas_t page { width, height + 64 * GLYPH_HEIGHT };
+          page.fill(0, 0, page.width, page.height, bgr0(0x1E, 0x1E, 0x1E));
+          page.text(GLYPH_WIDTH, 0, page.width - 2 * GLYPH_WIDTH, page.height, bgr0(0xD4, 0xD4, 0xD4), rng);
+
+          _page = std::move(page);
+          break;
+        }
+        case pattern_e::desktop: {
+          canvas_t page { width, height };
+          for (auto y = 0; y < height; ++y) {
+            auto shade = (std::uint8_t) (0x60 * y / height);
+            page.fill(0, y, width, 1, bgr0(0x10 + shade, 0x40 + shade, 0x70 + shade));
+          }
+
+          // A taskbar and two overlapping windows, the front one with the caret
+          page.fill(0, height - 40, width, 40, bgr0(0x20, 0x20, 0x20));
+          for (auto [x, y, w, h] : { std::array { 10, 10, 50, 55 }, std::array { 40, 30, 50, 50 } }) {
+            x = x * width / 100;
+            y = y * height / 100;
+            w = w * width / 100;
+            h = h * height / 100;
+
+            page.fill(x, y, w, h, bgr0(0xFF, 0xFF, 0xFF));
+            page.fill(x, y, w, 24, bgr0(0x3C, 0x3C, 0x3C));
+            page.text(x + GLYPH_WIDTH, y + 32, w - 2 * GLYPH_WIDTH, h - 40, bgr0(0x20, 0x20, 0x20), rng);
+
+            _caret = { x + GLYPH_WIDTH, y + 32 + GLYPH_HEIGHT * std::max(0, (h - 40) / GLYPH_HEIGHT - 1) };
+          }
+
+          _page = std::move(page);
+          break;
+        }
+        case pattern_e::replay:
+          if (open_replay()) {
+            return -1;
+          }
+          break;
+        default:
+          break;
+      }
+
+      BOOST_LOG(info) << "Synthetic display ["sv << name << "]: "sv << width << 'x' << height << " at "sv << config.framerate << " fps"sv;
+
+      return 0;
+    }
+
+    capture_e
+    capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
+      auto next_frame = std::chrono::steady_clock::now();
+
+      sleep_overshoot_logger.reset();
+
+      _tick = 0;
+      _caret_visible.reset();
+
+      while (true) {
+        auto now = std::chrono::steady_clock::now();
+
+        if (next_frame > now) {
+          _timer->sleep_until(next_frame);
+          sleep_overshoot_logger.first_point(next_frame);
+          sleep_overshoot_logger.second_point_now_and_log();
+        }
+
+        next_frame += _delay;
+        if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
+          next_frame = now + _delay;
+        }
+
+        now = std::chrono::steady_clock::now();
+
+        // Like a real display, nothing is captured while the screen doesn't change
+        std::shared_ptr<img_t> img_out;
+        auto changed = _pattern != pattern_e::desktop || _caret_visible != caret_visible(_tick);
+        if (changed) {
+          if (!pull_free_image_cb(img_out)) {
+            return capture_e::interrupted;
+          }
+
+          render(*img_out, now);
+        }
+
+        if (!push_captured_image_cb(std::move(img_out), changed)) {
+          return capture_e::ok;
+        }
+
+        ++_tick;
+      }
+
+      return capture_e::ok;
+    }
+
+    std::shared_ptr<img_t>
+    alloc_img() override {
+      auto img = std::make_shared<synthetic_img_t>();
+      img->width = width;
+      img->height = height;
+      img->pixel_pitch = 4;
+      img->row_pitch = img->pixel_pitch * width;
+      img->buffer = std::make_unique<std::uint8_t[]>((std::size_t) height * img->row_pitch);
+      img->data = img->buffer.get();
+
+      return img;
+    }
+
+    int
+    dummy_img(img_t *img) override {
+      if (!img) {
+        return -1;
+      }
+
+      render(*img, std::chrono::steady_clock::now());
+      return 0;
+    }
+
+    std::unique_ptr<avcodec_encode_device_t>
+    make_avcodec_encode_device(pix_fmt_e pix_fmt) override {
+      return std::make_unique<avcodec_encode_device_t>();
+    }
+
+  private:
+    int
+    open_replay() {
+      auto &path = config::video.synthetic_replay;
+      if (path.empty()) {
+        BOOST_LOG(error) << "The replay display needs synthetic_replay to be set"sv;
+        return -1;
+      }
+
+      try {
+        _replay_file = bip::file_mapping { path.c_str(), bip::read_only };
+        _replay = bip::mapped_region { _replay_file, bip::read_only };
+      }
+      catch (const bip::interprocess_exception &e) {
+        BOOST_LOG(error) << "Couldn't map ["sv << path << "]: "sv << e.what();
+        return -1;
+      }
+
+      auto frame_size = (std::size_t) width * height * 4;
+      _replay_frames = _replay.get_size() / frame_size;
+      if (!_replay_frames) {
+        BOOST_LOG(error) << '[' << path << "] doesn't hold a single "sv << width << 'x' << height << " BGR0 frame"sv;
+        return -1;
+      }
+
+      BOOST_LOG(info) << "Replaying "sv << _replay_frames << " frames from ["sv << path << ']';
+      return 0;
+    }
+
+    /**
+     * @brief Whether the caret shows on a frame interval since capture started.
+     * @note The caret follows the frame intervals instead of the clock, so it blinks the same on every run.
+     */
+    bool
+    caret_visible(std::uint64_t tick) {
+      return (_delay * (std::int64_t) tick / CARET_BLINK) % 2 == 0;
+    }
+
+    void
+    render(img_t &img, std::chrono::steady_clock::time_point now) {
+      img.frame_timestamp = now;
+
+      auto t = _frame++;
+      auto row = [&img](int y) {
+        return (std::uint32_t *) (img.data + (std::size_t) y * img.row_pitch);
+      };
+
+      switch (_pattern) {
+        case pattern_e::gradient: {
+          // A triangle wave, so the gradients don't have edges
+          auto wave = [](std::uint64_t v) {
+            v &= 0x1FF;
+            return (std::uint8_t) (v > 0xFF ? 0x1FF - v : v);
+          };
+
+          for (auto y = 0; y < height; ++y) {
+            auto pixels = row(y);
+            for (auto x = 0; x < width; ++x) {
+              pixels[x] = bgr0(wave((x + y) / 2 + t), wave(y + 2 * t), wave(x + 4 * t));
+            }
+          }
+          break;
+        }
+        case pattern_e::text: {
+          auto offset = (std::size_t) t * SCROLL_SPEED;
+          for (auto y = 0; y < height; ++y) {
+            auto page_row = (offset + y) % _page->height;
+            std::copy_n(&_page->pixels[page_row * width], width, row(y));
+          }
+          break;
+        }
+        case pattern_e::noise:
+          for (auto y = 0; y < height; ++y) {
+            auto pixels = row(y);
+            for (auto x = 0; x < width; x += 2) {
+              auto bits = _rng();
+
+              pixels[x] = (std::uint32_t) bits & 0xFFFFFF;
+              if (x + 1 < width) {
+                pixels[x + 1] = (std::uint32_t) (bits >> 32) & 0xFFFFFF;
+              }
+            }
+          }
+          break;
+        case pattern_e::desktop:
+          for (auto y = 0; y < height; ++y) {
+            std::copy_n(&_page->pixels[(std::size_t) y * width], width, row(y));
+          }
+
+          _caret_visible = caret_visible(_tick);
+          if (*_caret_visible) {
+            auto [x, y] = _caret;
+            for (auto caret_row = y; caret_row < std::min(y + GLYPH_HEIGHT, height); ++caret_row) {
+              std::fill_n(row(caret_row) + x, std::min(2, width - x), bgr0(0x20, 0x20, 0x20));
+            }
+          }
+          break;
+        case pattern_e::replay: {
+          auto frame_size = (std::size_t) width * height * 4;
+          auto frame = (const std::uint8_t *) _replay.get_address() + (t % _replay_frames) * frame_size;
+          for (auto y = 0; y < height; ++y) {
+            std::copy_n(frame + (std::size_t) y * width * 4, width * 4, (std::uint8_t *) row(y));
+          }
+          break;
+        }
+      }
+    }
+
+    pattern_e _pattern;
+    std::chrono::nanoseconds _delay;
+    std::unique_ptr<high_precision_timer> _timer;
+
+    std::uint64_t _frame = 0;
+    xorshift_t _rng;
+
+    // The parts of the text and desktop patterns that don't change
+    std::optional<canvas_t> _page;
+
+    // Frame intervals since capture started
+    std::uint64_t _tick = 0;
+
+    std::pair<int, int> _caret;
+    std::optional<bool> _caret_visible;
+
+    bip::file_mapping _replay_file;
+    bip::mapped_region _replay;
+    std::size_t _replay_frames = 0;
+  };
+
+  std::vector<std::string>
+  display_names() {
+    std::vector<std::string> names;
+    for (auto name : pattern_names) {
+      if (name == pattern_names[(int) pattern_e::replay] && config::video.synthetic_replay.empty()) {
+        continue;
+      }
+
+      names.emplace_back(name);
+    }
+
+    return names;
+  }
+
+  std::shared_ptr<display_t>
+  display(mem_type_e hwdevice_type, const std::string &display_name, const ::video::config_t &config) {
+    if (hwdevice_type != mem_type_e::system) {
+      return nullptr;
+    }
+
+    auto disp = std::make_shared<synthetic_display_t>();
+    if (disp->init(display_name, config)) {
+      return nullptr;
+    }
+
+    return disp;
+  }
+}  // namespace platf::synthetic
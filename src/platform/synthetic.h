@@ -0,0 +1,29 @@
+/**
+ * @file src/platform/synthetic.h
+ * @brief Declarations for the synthetic display, which generates its frames instead of capturing them.
+ */
+#pragma once
+
+#include "common.h"
+
+namespace platf::synthetic {
+  /**
+   * @brief Get the names of the synthetic displays, one per test pattern.
+   * @details The replay display is only listed when `synthetic_replay` is configured.
+   * @return The display names.
+   */
+  std::vector<std::string>
+  display_names();
+
+  /**
+   * @brief Create a synthetic display.
+   * @details The display takes on the resolution and frame rate of the stream. Its frames are BGR0
+   * images in system memory, so it only supports `mem_type_e::system`.
+   * @param hwdevice_type The memory type of the encoder.
+   * @param display_name The test pattern, or empty for the first one.
+   * @param config Stream configuration.
+   * @return The display, or `nullptr` on failure.
+   */
+  std::shared_ptr<display_t>
+  display(mem_type_e hwdevice_type, const std::string &display_name, const ::video::config_t &config);
+}  // namespace platf::synthetic
@@ -17,6 +17,7 @@ typedef long NTSTATUS;
 #include "src/config.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
+#include "src/platform/synthetic.h"
 #include "src/video.h"
 
 namespace platf {
@@ -1034,6 +1035,11 @@ namespace platf {
    */
   std::shared_ptr<display_t>
   display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
+    if (config::video.capture == "synthetic") {
+      BOOST_LOG(info) << "Generating synthetic frames"sv;
+      return synthetic::display(hwdevice_type, display_name, config);
+    }
+
     if (config::video.capture == "ddx" || config::video.capture.empty()) {
       if (hwdevice_type == mem_type_e::dxgi) {
         auto disp = std::make_shared<dxgi::display_ddup_vram_t>();
@@ -1074,6 +1080,10 @@ namespace platf {
 
   std::vector<std::string>
   display_names(mem_type_e) {
+    if (config::video.capture == "synthetic") {
+      return synthetic::display_names();
+    }
+
     std::vector<std::string> display_names;
 
     HRESULT status;
@@ -1540,6 +1540,12 @@ namespace platf {
     return WSASendMsg((SOCKET) send_info.native_socket, &msg, 0, &bytes_sent, nullptr, nullptr) != SOCKET_ERROR;
   }
 
+  bool
+  wait_for_sends() {
+    // Sends always complete before send_batch() returns on Windows
+    return true;
+  }
+
   bool
   send(send_info_t &send_info) {
     WSAMSG msg;
@@ -1623,6 +1629,12 @@ namespace platf {
     return true;
   }
 
+  bool
+  send_multiple(std::span<send_info_t> send_infos) {
+    // Winsock has no equivalent of sendmmsg(), so fall back to unbatched send calls
+    return false;
+  }
+
   class qos_t: public deinit_t {
   public:
     qos_t(QOS_FLOWID flow_id):
@@ -1639,6 +1651,18 @@ namespace platf {
     QOS_FLOWID flow_id;
   };
 
+  bool
+  enable_socket_txtime(uintptr_t native_socket) {
+    // Launch times are not supported on Windows
+    return false;
+  }
+
+  std::unique_ptr<zerocopy_t>
+  enable_socket_zerocopy(uintptr_t native_socket) {
+    // Zerocopy sends are not supported on Windows
+    return nullptr;
+  }
+
   /**
    * @brief Enables QoS on the given socket for traffic to the specified destination.
    * @param native_socket The native socket handle.
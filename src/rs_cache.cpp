@@ -0,0 +1,74 @@
+/**
+ * @file src/rs_cache.cpp
+ * @brief Definitions for the Reed-Solomon codec cache.
+ */
+#include <algorithm>
+
+#include "rs_cache.h"
+
+namespace rs_cache {
+  cache_t::cache_t(std::size_t capacity):
+      _capacity { std::max<std::size_t>(capacity, 1) } {}
+
+  rs_t
+  cache_t::get(int data_shards, int parity_shards) {
+    key_t key { data_shards, parity_shards };
+
+    {
+      std::lock_guard lg { _lock };
+
+      auto it = _codecs.find(key);
+      if (it != std::end(_codecs)) {
+        ++_stats.hits;
+
+        // Move it to the front of the LRU list
+        _lru.splice(std::begin(_lru), _lru, it->second);
+        return it->second->second;
+      }
+
+      ++_stats.misses;
+    }
+
+    // Build the encoding matrix outside of the lock
+    rs_t rs { reed_solomon_new(data_shards, parity_shards), [](reed_solomon *rs) {
+               if (rs) {
+                 reed_solomon_release(rs);
+               }
+             } };
+    if (!rs) {
+      return nullptr;
+    }
+
+    std::lock_guard lg { _lock };
+
+    // Another thread may have created the same codec in the meantime
+    auto it = _codecs.find(key);
+    if (it != std::end(_codecs)) {
+      return it->second->second;
+    }
+
+    _lru.emplace_front(key, rs);
+    _codecs.emplace(key, std::begin(_lru));
+
+    if (_lru.size() > _capacity) {
+      _codecs.erase(_lru.back().first);
+      _lru.pop_back();
+    }
+
+    return rs;
+  }
+
+  stats_t
+  cache_t::stats() {
+    std::lock_guard lg { _lock };
+
+    return _stats;
+  }
+
+  std::size_t
+  cache_t::size() {
+    std::lock_guard lg { _lock };
+
+    return _lru.size();
+  }
+}  // namespace rs_cache
@@ -0,0 +1,75 @@
+/**
+ * @file src/rs_cache.h
+ * @brief Declarations for the Reed-Solomon codec cache.
+ */
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+extern "C" {
+#include "rswrapper.h"
+}
+
+namespace rs_cache {
+  using rs_t = std::shared_ptr<reed_solomon>;
+
+  struct stats_t {
+    std::uint64_t hits;
+    std::uint64_t misses;
+  };
+
+  /**
+   * @brief A bounded, thread-safe cache of Reed-Solomon codecs keyed by shard geometry.
+   * @details Creating a codec builds its GF(2^8) encoding matrix, which is wasted work when
+   * consecutive frames use the same number of data and parity shards. Codecs are only read
+   * while encoding, so a cached codec can be shared by several encoders at once. Evicted
+   * codecs are released once the last encoder using them is done.
+   */
+  class cache_t {
+  public:
+    /**
+     * @param capacity The maximum number of codecs to keep.
+     */
+    explicit cache_t(std::size_t capacity);
+
+    /**
+     * @brief Get a codec for the given shard geometry, creating it if it's not cached.
+     * @param data_shards The number of data shards.
+     * @param parity_shards The number of parity shards.
+     * @return The codec, or nullptr if it couldn't be created.
+     */
+    rs_t
+    get(int data_shards, int parity_shards);
+
+    /**
+     * @brief Get the number of cache hits and misses so far.
+     */
+    stats_t
+    stats();
+
+    /**
+     * @brief Get the number of codecs currently cached.
+     */
+    std::size_t
+    size();
+
+  private:
+    using key_t = std::pair<int, int>;
+    using lru_t = std::list<std::pair<key_t, rs_t>>;
+
+    std::size_t _capacity;
+
+    std::mutex _lock;
+
+    // Most recently used codecs first
+    lru_t _lru;
+    std::map<key_t, lru_t::iterator> _codecs;
+
+    stats_t _stats {};
+  };
+}  // namespace rs_cache
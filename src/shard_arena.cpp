@@ -0,0 +1,103 @@
+/**
+ * @file src/shard_arena.cpp
+ * @brief Definitions for the arena recycling the FEC buffers of a stream.
+ */
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <stdexcept>
+
+#include "shard_arena.h"
+
+namespace shard_arena {
+  static std::size_t
+  block_size(std::size_t size_class) {
+    return MIN_BLOCK_SIZE << size_class;
+  }
+
+  static void
+  free_block(void *block) {
+    ::operator delete(block, std::align_val_t { ALIGNMENT });
+  }
+
+  arena_t::arena_t(clock::duration idle):
+      _idle { idle }, _last_trim { clock::now() } {}
+
+  arena_t::~arena_t() {
+    // Buffers keep the arena alive, so none of them are in use anymore
+    for (auto &size_class : _size_classes) {
+      for (auto block : size_class.free) {
+        free_block(block);
+      }
+    }
+  }
+
+  void
+  arena_t::trim(clock::time_point now) {
+    std::lock_guard lg { _lock };
+
+    if (now - _last_trim < _idle) {
+      return;
+    }
+    _last_trim = now;
+
+    for (std::size_t x = 0; x < SIZE_CLASSES; ++x) {
+      auto &size_class = _size_classes[x];
+
+      auto keep = size_class.peak > size_class.in_use ? size_class.peak - size_class.in_use : 0;
+      while (size_class.free.size() > keep) {
+        free_block(size_class.free.back());
+        size_class.free.pop_back();
+
+        ++_stats.released;
+        _stats.bytes -= block_size(x);
+      }
+
+      size_class.peak = size_class.in_use;
+    }
+  }
+
+  stats_t
+  arena_t::stats() {
+    std::lock_guard lg { _lock };
+
+    return _stats;
+  }
+
+  std::pair<void *, std::size_t>
+  arena_t::take(std::size_t bytes) {
+    auto x = (std::size_t) std::bit_width((std::max(bytes, MIN_BLOCK_SIZE) - 1) / MIN_BLOCK_SIZE);
+    if (x >= SIZE_CLASSES) {
+      throw std::length_error("Arena buffer too large");
+    }
+
+    std::lock_guard lg { _lock };
+
+    auto &size_class = _size_classes[x];
+
+    void *block;
+    if (!size_class.free.empty()) {
+      block = size_class.free.back();
+      size_class.free.pop_back();
+    }
+    else {
+      block = ::operator new(block_size(x), std::align_val_t { ALIGNMENT });
+
+      ++_stats.allocations;
+      _stats.bytes += block_size(x);
+    }
+
+    ++_stats.acquired;
+    size_class.peak = std::max(size_class.peak, ++size_class.in_use);
+
+    return { block, x };
+  }
+
+  void
+  arena_t::give(void *block, std::size_t size_class) {
+    std::lock_guard lg { _lock };
+
+    --_size_classes[size_class].in_use;
+    _size_classes[size_class].free.emplace_back(block);
+  }
+}  // namespace shard_arena
@@ -0,0 +1,204 @@
+/**
+ * @file src/shard_arena.h
+ * @brief Declarations for the arena recycling the FEC buffers of a stream.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace shard_arena {
+  using clock = std::chrono::steady_clock;
+
+  // Buffers are aligned to a cache line, which is also the widest vector the Reed-Solomon kernels use
+  constexpr std::size_t ALIGNMENT = 64;
+
+  // Size classes are powers of two, starting at a single cache line
+  constexpr std::size_t MIN_BLOCK_SIZE = ALIGNMENT;
+  constexpr std::size_t SIZE_CLASSES = 32;
+
+  struct stats_t {
+    std::uint64_t acquired;  ///< Buffers handed out
+    std::uint64_t allocations;  ///< Buffers that had to be allocated from the heap
+    std::uint64_t released;  ///< Cached buffers freed after being idle
+    std::size_t bytes;  ///< Bytes of all buffers currently allocated, whether in use or cached
+  };
+
+  class arena_t;
+
+  /**
+   * @brief A buffer of trivial elements, which goes back to its arena when destroyed.
+   * @details The contents of a recycled buffer are left as they were, unlike `util::buffer_t`.
+   */
+  template <class T>
+  class buffer_t {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Arena buffers are neither constructed nor destroyed");
+
+  public:
+    buffer_t() = default;
+
+    buffer_t(buffer_t &&o) noexcept:
+        _arena { std::move(o._arena) }, _buf { std::exchange(o._buf, nullptr) }, _els { std::exchange(o._els, 0) }, _size_class { o._size_class } {}
+
+    buffer_t &
+    operator=(buffer_t &&o) noexcept {
+      std::swap(_arena, o._arena);
+      std::swap(_buf, o._buf);
+      std::swap(_els, o._els);
+      std::swap(_size_class, o._size_class);
+
+      return *this;
+    }
+
+    ~buffer_t();
+
+    T &
+    operator[](std::size_t el) {
+      return _buf[el];
+    }
+
+    const T &
+    operator[](std::size_t el) const {
+      return _buf[el];
+    }
+
+    std::size_t
+    size() const {
+      return _els;
+    }
+
+    T *
+    begin() {
+      return _buf;
+    }
+
+    const T *
+    begin() const {
+      return _buf;
+    }
+
+    T *
+    end() {
+      return _buf + _els;
+    }
+
+    const T *
+    end() const {
+      return _buf + _els;
+    }
+
+  private:
+    friend class arena_t;
+
+    buffer_t(std::shared_ptr<arena_t> arena, T *buf, std::size_t els, std::size_t size_class):
+        _arena { std::move(arena) }, _buf { buf }, _els { els }, _size_class { size_class } {}
+
+    std::shared_ptr<arena_t> _arena;
+    T *_buf = nullptr;
+    std::size_t _els = 0;
+    std::size_t _size_class = 0;
+  };
+
+  /**
+   * @brief A thread-safe arena of aligned buffers in power of two size classes.
+   * @details Every frame needs the same handful of buffers for its FEC blocks, sized by the frame.
+   * Released buffers are cached by size class instead of being freed, so once the arena has grown
+   * to the largest frame of the stream, frames are sent without touching the heap. Buffers beyond
+   * the most that were in use at once during an idle period are freed again by `trim()`.
+   *
+   * Buffers keep the arena alive, so they may outlive the stream, e.g. while zerocopy sends are in flight.
+   * The arena must be owned by a `std::shared_ptr`.
+   */
+  class arena_t: public std::enable_shared_from_this<arena_t> {
+  public:
+    /**
+     * @param idle How long cached buffers may go unused before they are freed.
+     */
+    explicit arena_t(clock::duration idle);
+
+    ~arena_t();
+
+    arena_t(const arena_t &) = delete;
+    arena_t &
+    operator=(const arena_t &) = delete;
+
+    /**
+     * @brief Get a buffer, reusing a cached one of the same size class if there is one.
+     * @param elements The number of elements.
+     * @return The buffer, with undefined contents.
+     */
+    template <class T>
+    buffer_t<T>
+    acquire(std::size_t elements) {
+      if (!elements) {
+        return {};
+      }
+
+      auto [block, size_class] = take(elements * sizeof(T));
+      return { shared_from_this(), (T *) block, elements, size_class };
+    }
+
+    /**
+     * @brief Free the cached buffers that weren't needed since the last trim, once per idle period.
+     * @param now The current time.
+     */
+    void
+    trim(clock::time_point now);
+
+    /**
+     * @brief Get the counters of the arena.
+     * @return The counters.
+     */
+    stats_t
+    stats();
+
+  private:
+    template <class T>
+    friend class buffer_t;
+
+    struct size_class_t {
+      std::vector<void *> free;
+      std::size_t in_use;
+
+      // Most buffers in use at once since the last trim
+      std::size_t peak;
+    };
+
+    /**
+     * @brief Get a block of at least `bytes` bytes.
+     * @return The block and its size class.
+     */
+    std::pair<void *, std::size_t>
+    take(std::size_t bytes);
+
+    /**
+     * @brief Cache a block for reuse.
+     * @param block The block.
+     * @param size_class The size class of the block.
+     */
+    void
+    give(void *block, std::size_t size_class);
+
+    clock::duration _idle;
+    clock::time_point _last_trim;
+
+    std::mutex _lock;
+
+    std::array<size_class_t, SIZE_CLASSES> _size_classes {};
+
+    stats_t _stats {};
+  };
+
+  template <class T>
+  buffer_t<T>::~buffer_t() {
+    if (_buf) {
+      _arena->give(_buf, _size_class);
+    }
+  }
+}  // namespace shard_arena
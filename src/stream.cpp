@@ -19,11 +19,18 @@ extern "C" {
 // clang-format on
 }
 
+#include "adaptive_bitrate.h"
+#include "adaptive_fec.h"
 #include "config.h"
+#include "frame_queue.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
 #include "network.h"
+#include "pacer.h"
+#include "rs_cache.h"
+#include "rtsp.h"
+#include "shard_arena.h"
 #include "stream.h"
 #include "sync.h"
 #include "system_tray.h"
@@ -250,11 +257,58 @@ namespace stream {
 
   class control_server_t {
   public:
+    ~control_server_t() {
+      if (_wake_sock != ENET_SOCKET_NULL) {
+        enet_socket_destroy(_wake_sock);
+      }
+    }
+
     int
     bind(net::af_e address_family, std::uint16_t port) {
       _host = net::host_create(address_family, _addr, config::stream.channels, port);
+      if (!_host) {
+        return -1;
+      }
 
-      return !(bool) _host;
+      // Without a way to be woken up, iterate() still returns once the timeout expires
+      if (bind_wakeup()) {
+        BOOST_LOG(warning) << "Couldn't create the control stream wakeup socket, feedback to clients may be delayed"sv;
+      }
+
+      return 0;
+    }
+
+    /**
+     * @brief Make `iterate()` return right away, so messages queued by other threads are sent without delay.
+     * @details Safe to call from any thread. Wakeups are coalesced until `take_wakeup()` is called.
+     */
+    void
+    wake() {
+      auto now = std::chrono::steady_clock::now();
+      if (_wake_sock == ENET_SOCKET_NULL || _wake_pending.exchange(true, std::memory_order_acq_rel)) {
+        return;
+      }
+      _wake_time.store(now, std::memory_order_relaxed);
+
+      char byte = 0;
+      ENetBuffer buffer;
+      buffer.data = &byte;
+      buffer.dataLength = sizeof(byte);
+      enet_socket_send(_wake_sock, &_wake_addr, &buffer, 1);
+    }
+
+    /**
+     * @brief Allow the next `wake()` to wake up `iterate()` again.
+     * @details Call this before looking for messages queued by other threads, so none of them are missed.
+     * @return When the pending wakeup was requested, if there is one.
+     */
+    std::optional<std::chrono::steady_clock::time_point>
+    take_wakeup() {
+      if (!_wake_pending.exchange(false, std::memory_order_acq_rel)) {
+        return std::nullopt;
+      }
+
+      return _wake_time.load(std::memory_order_relaxed);
     }
 
     // Get session associated with address.
@@ -314,14 +368,65 @@ namespace stream {
 
     ENetAddress _addr;
     net::host_t _host;
+
+  private:
+    /**
+     * @brief Create a loopback socket, which `iterate()` waits on along with the ENet socket.
+     * @return 0 on success.
+     */
+    int
+    bind_wakeup() {
+      _wake_sock = enet_socket_create(AF_INET, ENET_SOCKET_TYPE_DATAGRAM);
+      if (_wake_sock == ENET_SOCKET_NULL) {
+        return -1;
+      }
+
+      auto fg = util::fail_guard([this]() {
+        enet_socket_destroy(_wake_sock);
+        _wake_sock = ENET_SOCKET_NULL;
+      });
+
+      ENetAddress address;
+      if (enet_address_set_host(&address, "127.0.0.1")) {
+        return -1;
+      }
+      enet_address_set_port(&address, 0);
+
+      if (enet_socket_bind(_wake_sock, &address) ||
+          enet_socket_get_address(_wake_sock, &_wake_addr) ||
+          enet_socket_set_option(_wake_sock, ENET_SOCKOPT_NONBLOCK, 1)) {
+        return -1;
+      }
+
+      fg.disable();
+      return 0;
+    }
+
+    /**
+     * @brief Discard the datagrams sent by `wake()`.
+     */
+    void
+    drain_wakeups() {
+      char byte;
+      ENetBuffer buffer;
+      buffer.data = &byte;
+      buffer.dataLength = sizeof(byte);
+
+      ENetAddress address;
+      while (enet_socket_receive(_wake_sock, &address, &buffer, 1) > 0) {}
+    }
+
+    ENetSocket _wake_sock = ENET_SOCKET_NULL;
+    ENetAddress _wake_addr;
+
+    std::atomic_bool _wake_pending { false };
+    std::atomic<std::chrono::steady_clock::time_point> _wake_time;
   };
 
   struct broadcast_ctx_t {
     message_queue_queue_t message_queue_queue;
 
     std::thread recv_thread;
-    std::thread video_thread;
-    std::thread audio_thread;
     std::thread control_thread;
 
     asio::io_service io;
@@ -329,6 +434,22 @@ namespace stream {
     udp::socket video_sock { io };
     udp::socket audio_sock { io };
 
+    // Shared by the video senders of all sessions to generate FEC for large frames
+    thread_pool_util::ThreadPool fec_pool;
+    int fec_workers;
+
+    // Frames of similar size keep using the same few FEC block geometries
+    rs_cache::cache_t fec_codecs { 32 };
+
+    // Whether video packets are paced by the kernel using launch times
+    bool video_txtime;
+
+    // Divides the video egress bandwidth among the video senders of all sessions
+    std::unique_ptr<pacer::egress_t> video_egress;
+
+    // Keeps the frames of zerocopy video sends alive until the kernel is done with them
+    std::unique_ptr<platf::zerocopy_t> video_zerocopy;
+
     control_server_t control_server;
   };
 
@@ -340,7 +461,9 @@ namespace stream {
     std::shared_ptr<input::input_t> input;
 
     std::thread audioThread;
+    std::thread audioSendThread;
     std::thread videoThread;
+    std::thread videoSendThread;
 
     std::chrono::steady_clock::time_point pingTimeout;
 
@@ -357,10 +480,21 @@ namespace stream {
       std::optional<crypto::cipher::gcm_t> cipher;
       std::uint64_t gcm_iv_counter;
 
+      // Encoded frames waiting to be packetized and sent by this session's sender thread
+      std::unique_ptr<video::frame_queue_t> packets;
+
       safe::mail_raw_t::event_t<bool> idr_events;
       safe::mail_raw_t::event_t<std::pair<int64_t, int64_t>> invalidate_ref_frames_events;
+      safe::mail_raw_t::event_t<int> bitrate_events;
+      safe::mail_raw_t::event_t<bool> fixed_bitrate_events;
 
       std::unique_ptr<platf::deinit_t> qos;
+
+      // Chooses the FEC percentage from the loss the client reports, if adaptive FEC is enabled
+      std::unique_ptr<adaptive_fec::controller_t> fec_controller;
+
+      // Chooses the encoder bitrate from signs of congestion, if adaptive bitrate is enabled
+      std::unique_ptr<adaptive_bitrate::controller_t> bitrate_controller;
     } video;
 
     struct {
@@ -378,6 +512,9 @@ namespace stream {
 
       audio_fec_packet_t fec_packet;
       std::unique_ptr<platf::deinit_t> qos;
+
+      // Encoded audio waiting to be sent by this session's sender thread
+      safe::mail_raw_t::queue_t<audio::packet_t> packets;
     } audio;
 
     struct {
@@ -564,7 +701,25 @@ namespace stream {
   void
   control_server_t::iterate(std::chrono::milliseconds timeout) {
     ENetEvent event;
-    auto res = enet_host_service(_host.get(), &event, timeout.count());
+    auto res = enet_host_service(_host.get(), &event, _wake_sock == ENET_SOCKET_NULL ? timeout.count() : 0);
+
+    // ENet only waits for its own socket, so wait for the client and for other threads here
+    if (res == 0 && _wake_sock != ENET_SOCKET_NULL) {
+      ENetSocketSet read_set;
+      ENET_SOCKETSET_EMPTY(read_set);
+      ENET_SOCKETSET_ADD(read_set, _host->socket);
+      ENET_SOCKETSET_ADD(read_set, _wake_sock);
+
+      if (enet_socketset_select(std::max(_host->socket, _wake_sock), &read_set, nullptr, timeout.count()) > 0) {
+        if (ENET_SOCKETSET_CHECK(read_set, _wake_sock)) {
+          drain_wakeups();
+        }
+
+        if (ENET_SOCKETSET_CHECK(read_set, _host->socket)) {
+          res = enet_host_service(_host.get(), &event, 0);
+        }
+      }
+    }
 
     if (res > 0) {
       auto session = get_session(event.peer, event.data);
@@ -605,18 +760,51 @@ namespace stream {
   namespace fec {
     using rs_t = util::safe_ptr<reed_solomon, [](reed_solomon *rs) { reed_solomon_release(rs); }>;
 
+    // Blocks with less payload than this aren't split into byte ranges, since
+    // handing the work off to another thread would cost more than it saves.
+    constexpr size_t MIN_BYTES_PER_TASK = 128 * 1024;
+
     struct fec_t {
       size_t data_shards;
       size_t nr_shards;
       size_t percentage;
 
+      size_t headersize;
       size_t blocksize;
       size_t prefixsize;
-      util::buffer_t<char> shards;
-      util::buffer_t<char> headers;
-      util::buffer_t<uint8_t *> shards_p;
 
-      std::vector<platf::buffer_descriptor_t> payload_buffers;
+      // The buffers below are recycled through the session's arena, so their contents start out undefined
+
+      // Headers of all shards, parity shard headers are computed along with the parity payloads
+      shard_arena::buffer_t<char> headers;
+      shard_arena::buffer_t<uint8_t *> headers_p;
+
+      // Parity shard payloads, data shard payloads are referenced in place
+      shard_arena::buffer_t<char> shards;
+      shard_arena::buffer_t<uint8_t *> shards_p;
+
+      // Encryption prefixes and the encrypted header+payload of each shard, if encryption is enabled
+      shard_arena::buffer_t<char> prefixes;
+      shard_arena::buffer_t<char> encrypted;
+
+      // Payload buffers to send, with room for every shard, of which the first payload_buffer_count are used
+      shard_arena::buffer_t<platf::buffer_descriptor_t> payload_buffers;
+      size_t payload_buffer_count = 0;
+      platf::buffer_descriptor_t encrypted_buffer;
+
+      rs_cache::rs_t rs;
+
+      // Parity generation still running on the FEC worker pool
+      std::vector<std::future<task_time_t>> parity_tasks;
+
+      // Time at which the parity of this block was complete and the total time spent generating it
+      std::chrono::steady_clock::time_point encode_end;
+      std::chrono::nanoseconds encode_busy {};
+
+      char *
+      header(size_t el) {
+        return &headers[el * headersize];
+      }
 
       char *
       data(size_t el) {
@@ -625,23 +813,67 @@ namespace stream {
 
       char *
       prefix(size_t el) {
-        return prefixsize ? &headers[el * prefixsize] : nullptr;
+        return prefixsize ? &prefixes[el * prefixsize] : nullptr;
+      }
+
+      char *
+      encrypted_data(size_t el) {
+        return &encrypted[el * (headersize + blocksize)];
       }
 
       size_t
       size() const {
         return nr_shards;
       }
+
+      /**
+       * @brief Get the buffers holding the payloads of the shards as they are sent.
+       * @return The buffer descriptors.
+       */
+      std::span<const platf::buffer_descriptor_t>
+      payloads() const {
+        if (prefixsize) {
+          return { &encrypted_buffer, 1 };
+        }
+
+        return { payload_buffers.begin(), payload_buffer_count };
+      }
+
+      /**
+       * @brief Wait until the parity shards of this block are complete.
+       */
+      void
+      wait() {
+        for (auto &task : parity_tasks) {
+          auto [start, end] = task.get();
+
+          encode_busy += end - start;
+          encode_end = std::max(encode_end, end);
+        }
+
+        parity_tasks.clear();
+      }
     };
 
+    /**
+     * @brief Allocate the shards of an FEC block for a range of slices.
+     * @details The data shards reference the slices in place. Parity is generated by `encode()`.
+     * @param payload The sliced frame.
+     * @param first_slice The index of the first slice in this FEC block.
+     * @param slice_count The number of slices in this FEC block.
+     * @param fecpercentage The requested FEC percentage.
+     * @param minparityshards The minimum number of parity shards.
+     * @param prefixsize The size of the encryption prefix of each shard, or 0 without encryption.
+     * @param codecs The cache to get the Reed-Solomon codec from.
+     * @param arena The arena to take the buffers of the block from.
+     * @return The FEC block.
+     */
     static fec_t
-    encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
-      auto payload_size = payload.size();
+    prepare(sliced_payload_t &payload, size_t first_slice, size_t slice_count, size_t fecpercentage, size_t minparityshards, size_t prefixsize, rs_cache::cache_t &codecs, shard_arena::arena_t &arena) {
+      auto headersize = payload.insert_size;
+      auto blocksize = payload.slice_size;
 
-      auto pad = payload_size % blocksize != 0;
-
-      auto aligned_data_shards = payload_size / blocksize;
-      auto data_shards = aligned_data_shards + (pad ? 1 : 0);
+      auto data_shards = slice_count;
       auto parity_shards = (data_shards * fecpercentage + 99) / 100;
 
       // increase the FEC percentage for this frame if the parity shard minimum is not met
@@ -654,129 +886,197 @@ namespace stream {
 
       auto nr_shards = data_shards + parity_shards;
 
-      // If we need to store a zero-padded data shard, allocate that first to
-      // to keep the shards in order and reduce buffer fragmentation
-      auto parity_shard_offset = pad ? 1 : 0;
-      util::buffer_t<char> shards { (parity_shard_offset + parity_shards) * blocksize };
-      util::buffer_t<uint8_t *> shards_p { nr_shards };
-      std::vector<platf::buffer_descriptor_t> payload_buffers;
-      payload_buffers.reserve(2);
-
-      // Point into the payload buffer for all except the final padded data shard
-      auto next = std::begin(payload);
-      for (auto x = 0; x < aligned_data_shards; ++x) {
-        shards_p[x] = (uint8_t *) next;
-        next += blocksize;
-      }
-      payload_buffers.emplace_back(std::begin(payload), aligned_data_shards * blocksize);
-
-      // If the last data shard needs to be zero-padded, we must use the shards buffer
-      if (pad) {
-        shards_p[aligned_data_shards] = (uint8_t *) &shards[0];
-
-        // GCC doesn't figure out that std::copy_n() can be replaced with memcpy() here
-        // and ends up compiling a horribly slow element-by-element copy loop, so we
-        // help it by using memcpy()/memset() directly.
-        auto copy_len = std::min<size_t>(blocksize, std::end(payload) - next);
-        std::memcpy(shards_p[aligned_data_shards], next, copy_len);
-        if (copy_len < blocksize) {
-          // Zero any additional space after the end of the payload
-          std::memset(shards_p[aligned_data_shards] + copy_len, 0, blocksize - copy_len);
+      fec_t fec;
+      fec.data_shards = data_shards;
+      fec.nr_shards = nr_shards;
+      fec.percentage = fecpercentage;
+      fec.headersize = headersize;
+      fec.blocksize = blocksize;
+      fec.prefixsize = prefixsize;
+      fec.headers = arena.acquire<char>(nr_shards * headersize);
+      fec.headers_p = arena.acquire<uint8_t *>(nr_shards);
+      fec.shards = arena.acquire<char>(parity_shards * blocksize);
+      fec.shards_p = arena.acquire<uint8_t *>(nr_shards);
+      fec.payload_buffers = arena.acquire<platf::buffer_descriptor_t>(nr_shards);
+
+      // The data shard headers are small, so they're copied next to the parity shard headers
+      std::memcpy(fec.headers.begin(), payload.header(first_slice), data_shards * headersize);
+
+      // Point at the data shard payloads in place, merging slices that are adjacent in memory
+      for (auto x = 0; x < data_shards; ++x) {
+        auto slice = payload.slices[first_slice + x];
+
+        fec.headers_p[x] = (uint8_t *) &fec.headers[x * headersize];
+        fec.shards_p[x] = (uint8_t *) slice;
+
+        auto &count = fec.payload_buffer_count;
+        if (count && fec.payload_buffers[count - 1].buffer + fec.payload_buffers[count - 1].size == slice) {
+          fec.payload_buffers[count - 1].size += blocksize;
+        }
+        else {
+          fec.payload_buffers[count++] = platf::buffer_descriptor_t { slice, blocksize };
         }
       }
 
-      // Add a payload buffer describing the shard buffer
-      payload_buffers.emplace_back(std::begin(shards), shards.size());
-
-      if (fecpercentage != 0) {
-        // Point into our allocated buffer for the parity shards
+      if (parity_shards) {
+        // Point into our allocated buffers for the parity shards
         for (auto x = 0; x < parity_shards; ++x) {
-          shards_p[data_shards + x] = (uint8_t *) &shards[(parity_shard_offset + x) * blocksize];
+          fec.headers_p[data_shards + x] = (uint8_t *) &fec.headers[(data_shards + x) * headersize];
+          fec.shards_p[data_shards + x] = (uint8_t *) &fec.shards[x * blocksize];
         }
 
+        // Recycled buffers aren't zeroed like freshly allocated ones were, so clear the parity before it's encoded
+        std::memset(fec.header(data_shards), 0, parity_shards * headersize);
+        std::memset(fec.shards.begin(), 0, fec.shards.size());
+
+        // The parity shards are contiguous, so a single buffer covers all of them
+        fec.payload_buffers[fec.payload_buffer_count++] = platf::buffer_descriptor_t { std::begin(fec.shards), fec.shards.size() };
+
         // packets = parity_shards + data_shards
-        rs_t rs { reed_solomon_new(data_shards, parity_shards) };
+        fec.rs = codecs.get(data_shards, parity_shards);
+        if (!fec.rs) {
+          throw std::runtime_error("Couldn't create Reed-Solomon codec");
+        }
+      }
 
-        reed_solomon_encode(rs.get(), shards_p.begin(), nr_shards, blocksize);
+      // Encryption can't be done in place because the data shards belong to the encoder
+      if (prefixsize) {
+        fec.prefixes = arena.acquire<char>(nr_shards * prefixsize);
+        fec.encrypted = arena.acquire<char>(nr_shards * (headersize + blocksize));
+        fec.encrypted_buffer = platf::buffer_descriptor_t { std::begin(fec.encrypted), fec.encrypted.size() };
       }
 
-      return {
-        data_shards,
-        nr_shards,
-        fecpercentage,
-        blocksize,
-        prefixsize,
-        std::move(shards),
-        util::buffer_t<char> { nr_shards * prefixsize },
-        std::move(shards_p),
-        std::move(payload_buffers),
-      };
+      return fec;
     }
-  }  // namespace fec
 
-  /**
-   * @brief Combines two buffers and inserts new buffers at each slice boundary of the result.
-   * @param insert_size The number of bytes to insert.
-   * @param slice_size The number of bytes between insertions.
-   * @param data1 The first data buffer.
-   * @param data2 The second data buffer.
-   */
-  std::vector<uint8_t>
-  concat_and_insert(uint64_t insert_size, uint64_t slice_size, const std::string_view &data1, const std::string_view &data2) {
-    auto data_size = data1.size() + data2.size();
-    auto pad = data_size % slice_size != 0;
-    auto elements = data_size / slice_size + (pad ? 1 : 0);
+    /**
+     * @brief Generate parity for the bytes in [begin, end) of every shard.
+     * @details Reed-Solomon operates on each byte offset of the shards independently, so a
+     * block can be encoded in separate byte ranges, and the header and payload parts of each
+     * shard can be encoded separately while the payloads stay in place.
+     * @param rs The Reed-Solomon instance for the block.
+     * @param shards_p Pointers to the shards.
+     * @param nr_shards The total number of shards.
+     * @param begin The first byte of the range.
+     * @param end The end of the range.
+     * @return When the encoding started and ended.
+     */
+    static task_time_t
+    encode_range(reed_solomon *rs, uint8_t *const *shards_p, size_t nr_shards, size_t begin, size_t end) {
+      auto start = std::chrono::steady_clock::now();
+
+      // A Reed-Solomon block has at most 256 shards, so the pointers fit on the stack
+      std::array<uint8_t *, 256> range_p;
+      for (auto x = 0; x < nr_shards; ++x) {
+        range_p[x] = shards_p[x] + begin;
+      }
 
-    std::vector<uint8_t> result;
-    result.resize(elements * insert_size + data_size);
+      reed_solomon_encode(rs, range_p.data(), nr_shards, end - begin);
 
-    auto next = std::begin(data1);
-    auto end = std::end(data1);
-    for (auto x = 0; x < elements; ++x) {
-      void *p = &result[x * (insert_size + slice_size)];
+      return { start, std::chrono::steady_clock::now() };
+    }
 
-      // For the last iteration, only copy to the end of the data
-      if (x == elements - 1) {
-        slice_size = data_size - (x * slice_size);
+    /**
+     * @brief Generate the parity shards of an FEC block.
+     * @details Large blocks are split into byte ranges that are encoded on the FEC worker pool.
+     * Use `fec_t::wait()` before reading the parity shards.
+     * @param fec The FEC block.
+     * @param pool The FEC worker pool.
+     * @param workers The number of threads in the pool.
+     * @param offload Whether to hand the block off to the pool even if it isn't split.
+     */
+    static void
+    encode(fec_t &fec, thread_pool_util::ThreadPool &pool, size_t workers, bool offload) {
+      fec.encode_end = std::chrono::steady_clock::now();
+      if (!fec.rs) {
+        return;
+      }
+
+      // The headers are tiny, so they're always encoded on this thread
+      if (fec.headersize) {
+        auto [start, end] = encode_range(fec.rs.get(), fec.headers_p.begin(), fec.nr_shards, 0, fec.headersize);
+        fec.encode_busy += end - start;
+        fec.encode_end = end;
       }
 
-      // Test if this slice will extend into the next buffer
-      if (next + slice_size > end) {
-        // Copy the first portion from the first buffer
-        auto copy_len = end - next;
-        std::copy(next, end, (char *) p + insert_size);
+      auto ranges = std::clamp<size_t>(fec.data_shards * fec.blocksize / MIN_BYTES_PER_TASK, 1, workers);
+      if (ranges == 1 && !offload) {
+        auto [start, end] = encode_range(fec.rs.get(), fec.shards_p.begin(), fec.nr_shards, 0, fec.blocksize);
+        fec.encode_busy += end - start;
+        fec.encode_end = end;
 
-        // Copy the remaining portion from the second buffer
-        next = std::begin(data2);
-        end = std::end(data2);
-        std::copy(next, next + (slice_size - copy_len), (char *) p + copy_len + insert_size);
-        next += slice_size - copy_len;
+        return;
       }
-      else {
-        std::copy(next, next + slice_size, (char *) p + insert_size);
-        next += slice_size;
+
+      fec.parity_tasks = encode_ranges(fec.rs.get(), fec.shards_p.begin(), fec.nr_shards, fec.blocksize, ranges, pool);
+    }
+
+    std::vector<std::future<task_time_t>>
+    encode_ranges(reed_solomon *rs, uint8_t *const *shards_p, size_t nr_shards, size_t blocksize, size_t ranges, thread_pool_util::ThreadPool &pool) {
+      std::vector<std::future<task_time_t>> tasks;
+      tasks.reserve(ranges);
+
+      // Keep the ranges aligned for the vectorized encoders
+      auto range_size = ((blocksize + ranges - 1) / ranges + 63) & ~(size_t) 63;
+      for (size_t begin = 0; begin < blocksize; begin += range_size) {
+        auto end = std::min(begin + range_size, blocksize);
+
+        tasks.emplace_back(pool.push(encode_range, rs, shards_p, nr_shards, begin, end));
       }
+
+      return tasks;
     }
+  }  // namespace fec
 
-    return result;
-  }
+  sliced_payload_t
+  slice_and_insert(std::size_t insert_size, std::size_t slice_size, const std::string_view &data1, const std::string_view &data2) {
+    auto data_size = data1.size() + data2.size();
+    auto pad = data_size % slice_size != 0;
+    auto elements = data_size / slice_size + (pad ? 1 : 0);
+
+    sliced_payload_t result {
+      insert_size,
+      slice_size,
+      data_size,
+      util::buffer_t<char> { elements * insert_size },
+      // At most one slice spans both buffers and at most one slice needs padding
+      util::buffer_t<char> { 2 * slice_size },
+    };
+    result.slices.reserve(elements);
+
+    auto next_owned = std::begin(result.owned);
+    for (std::size_t x = 0; x < elements; ++x) {
+      auto offset = x * slice_size;
+      auto size = std::min(slice_size, data_size - offset);
+
+      // Complete slices within a single buffer are referenced in place
+      if (size == slice_size && offset + size <= data1.size()) {
+        result.slices.emplace_back(data1.data() + offset);
+        continue;
+      }
+      if (size == slice_size && offset >= data1.size()) {
+        result.slices.emplace_back(data2.data() + (offset - data1.size()));
+        continue;
+      }
 
-  std::vector<uint8_t>
-  replace(const std::string_view &original, const std::string_view &old, const std::string_view &_new) {
-    std::vector<uint8_t> replaced;
-    replaced.reserve(original.size() + _new.size() - old.size());
+      // Gather the remaining slices into owned memory. That memory is
+      // value-initialized, so the padding of the final slice is already zeroed.
+      auto slice = next_owned;
+      next_owned += slice_size;
 
-    auto begin = std::begin(original);
-    auto end = std::end(original);
-    auto next = std::search(begin, end, std::begin(old), std::end(old));
+      size_t copy_len = 0;
+      if (offset < data1.size()) {
+        copy_len = std::min(size, data1.size() - offset);
+        std::memcpy(slice, data1.data() + offset, copy_len);
+      }
+      if (copy_len < size) {
+        std::memcpy(slice + copy_len, data2.data() + (offset + copy_len - data1.size()), size - copy_len);
+      }
 
-    std::copy(begin, next, std::back_inserter(replaced));
-    if (next != end) {
-      std::copy(std::begin(_new), std::end(_new), std::back_inserter(replaced));
-      std::copy(next + old.size(), end, std::back_inserter(replaced));
+      result.slices.emplace_back(slice);
     }
 
-    return replaced;
+    return result;
   }
 
   /**
@@ -935,6 +1235,13 @@ namespace stream {
 
       auto lastGoodFrame = stats[3];
 
+      if (session->video.fec_controller) {
+        session->video.fec_controller->report_loss(std::max(count, 0), t);
+      }
+      if (session->video.bitrate_controller) {
+        session->video.bitrate_controller->report_loss(std::max(count, 0));
+      }
+
       BOOST_LOG(verbose)
         << "type [IDX_LOSS_STATS]"sv << std::endl
         << "---begin stats---" << std::endl
@@ -947,6 +1254,11 @@ namespace stream {
     server->map(packetTypes[IDX_REQUEST_IDR_FRAME], [&](session_t *session, const std::string_view &payload) {
       BOOST_LOG(debug) << "type [IDX_REQUEST_IDR_FRAME]"sv;
 
+      // The client lost a frame it couldn't recover, so more parity is needed
+      if (session->video.fec_controller) {
+        session->video.fec_controller->report_frame_loss(std::chrono::steady_clock::now());
+      }
+
       session->video.idr_events->raise(true);
     });
 
@@ -960,6 +1272,10 @@ namespace stream {
         << "firstFrame [" << firstFrame << ']' << std::endl
         << "lastFrame [" << lastFrame << ']';
 
+      if (session->video.fec_controller) {
+        session->video.fec_controller->report_frame_loss(std::chrono::steady_clock::now());
+      }
+
       session->video.invalidate_ref_frames_events->raise(std::make_pair(firstFrame, lastFrame));
     });
 
@@ -969,11 +1285,11 @@ namespace stream {
       auto tagged_cipher_length = util::endian::big(*(int32_t *) payload.data());
       std::string_view tagged_cipher { payload.data() + sizeof(tagged_cipher_length), (size_t) tagged_cipher_length };
 
-      std::vector<uint8_t> plaintext;
+      auto plaintext = input::acquire_message(session->input);
 
       auto &cipher = session->control.cipher;
       auto &iv = session->control.legacy_input_enc_iv;
-      if (cipher.decrypt(tagged_cipher, plaintext, &iv)) {
+      if (cipher.decrypt(tagged_cipher, *plaintext, &iv)) {
         // something went wrong :(
 
         BOOST_LOG(error) << "Failed to verify tag"sv;
@@ -1028,8 +1344,9 @@ namespace stream {
         iv[0] = (std::uint8_t) seq;
       }
 
-      std::vector<uint8_t> plaintext;
-      if (cipher.decrypt(tagged_cipher, plaintext, &iv)) {
+      // Decrypt into a recycled buffer, which is handed to the input queue as is
+      auto plaintext = input::acquire_message(session->input);
+      if (cipher.decrypt(tagged_cipher, *plaintext, &iv)) {
         // something went wrong :(
 
         BOOST_LOG(error) << "Failed to verify tag"sv;
@@ -1038,8 +1355,8 @@ namespace stream {
         return;
       }
 
-      auto type = *(std::uint16_t *) plaintext.data();
-      std::string_view next_payload { (char *) plaintext.data() + 4, plaintext.size() - 4 };
+      auto type = *(std::uint16_t *) plaintext->data();
+      std::string_view next_payload { (char *) plaintext->data() + 4, plaintext->size() - 4 };
 
       if (type == packetTypes[IDX_ENCRYPTED]) {
         BOOST_LOG(error) << "Bad packet type [IDX_ENCRYPTED] found"sv;
@@ -1049,7 +1366,7 @@ namespace stream {
 
       // IDX_INPUT_DATA callback will attempt to decrypt unencrypted data, therefore we need pass it directly
       if (type == packetTypes[IDX_INPUT_DATA]) {
-        plaintext.erase(std::begin(plaintext), std::begin(plaintext) + 4);
+        plaintext->erase(std::begin(*plaintext), std::begin(*plaintext) + 4);
         input::passthrough(session->input, std::move(plaintext));
       }
       else {
@@ -1065,9 +1382,16 @@ namespace stream {
     // termination when we shut down.
     auto shutdown_event = mail::man->event<bool>(mail::shutdown);
     auto broadcast_shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
+
+    logging::time_delta_periodic_logger feedback_latency_logger(debug, "Control: feedback latency from queueing to sending");
+
     while (!shutdown_event->peek() && !broadcast_shutdown_event->peek()) {
       bool has_session_awaiting_peer = false;
 
+      // Messages queued from here on wake up the next iteration again
+      auto wakeup = server->take_wakeup();
+      bool sent_feedback = false;
+
       {
         auto lg = server->_sessions.lock();
 
@@ -1115,6 +1439,7 @@ namespace stream {
               auto feedback_msg = feedback_queue->pop();
 
               send_feedback_msg(session, *feedback_msg);
+              sent_feedback = true;
             }
 
             auto &hdr_queue = session->control.hdr_queue;
@@ -1122,6 +1447,7 @@ namespace stream {
               auto hdr_info = hdr_queue->pop();
 
               send_hdr_mode(session, std::move(hdr_info));
+              sent_feedback = true;
             }
           }
 
@@ -1129,6 +1455,16 @@ namespace stream {
         })
       }
 
+      // Send the feedback now, instead of when ENet is serviced next
+      if (sent_feedback) {
+        server->flush();
+
+        if (wakeup) {
+          feedback_latency_logger.first_point(*wakeup);
+          feedback_latency_logger.second_point_now_and_log();
+        }
+      }
+
       // Don't break until any pending sessions either expire or connect
       if (proc::proc.running() == 0 && !has_session_awaiting_peer) {
         BOOST_LOG(info) << "Process terminated"sv;
@@ -1269,57 +1605,91 @@ namespace stream {
     }
   }
 
+  /**
+   * @brief Packetize, protect and send the encoded video frames of a single session.
+   * @param session The session to send video for.
+   */
   void
-  videoBroadcastThread(udp::socket &sock) {
-    auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<video::packet_t>(mail::video_packets);
+  videoSendThread(session_t *session) {
+    auto &sock = session->broadcast_ref->video_sock;
+    auto &packets = session->video.packets;
     auto timebase = boost::posix_time::microsec_clock::universal_time();
 
-    // Video traffic is sent on this thread
+    // Video traffic for this session is sent on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
     logging::min_max_avg_periodic_logger<double> frame_processing_latency_logger(debug, "Frame processing latency", "ms");
 
     logging::time_delta_periodic_logger frame_send_batch_latency_logger(debug, "Network: each send_batch() latency");
     logging::time_delta_periodic_logger frame_fec_latency_logger(debug, "Network: each FEC block latency");
+    logging::time_delta_periodic_logger frame_encrypt_latency_logger(debug, "Network: each FEC block encryption latency");
+    logging::min_max_avg_periodic_logger<double> frame_fec_speedup_logger(debug, "Network: FEC parallel speedup", "x");
     logging::time_delta_periodic_logger frame_network_latency_logger(debug, "Network: frame's overall network latency");
+    logging::min_max_avg_periodic_logger<double> frame_pacing_overshoot_logger(debug, "Network: pacing timer overshoot", "us");
+    logging::min_max_avg_periodic_logger<std::uint64_t> frame_fec_buffers_logger(debug, "Network: FEC buffers per frame", "");
+    logging::min_max_avg_periodic_logger<std::uint64_t> frame_fec_allocations_logger(debug, "Network: FEC heap allocations per frame", "");
+
+    // The FEC buffers of each frame are recycled for the next one, and freed after 10 seconds without a use
+    auto fec_arena = std::make_shared<shard_arena::arena_t>(10s);
 
-    crypto::aes_t iv(12);
+    // IVs and buffers of the shards of an FEC block, reused for every encrypted block
+    std::vector<crypto::aes_t> ivs;
+    std::vector<crypto::cipher::gcm_shard_t> encrypt_shards;
 
     auto timer = platf::create_high_precision_timer();
     if (!timer || !*timer) {
-      BOOST_LOG(error) << "Failed to create timer, aborting video broadcast thread";
+      BOOST_LOG(error) << "Failed to create timer, aborting video send thread";
+      session::stop(*session);
       return;
     }
 
-    auto ratecontrol_next_frame_start = std::chrono::steady_clock::now();
+    // This session's share of the egress bandwidth, which changes as other sessions come and go
+    // and as the rate this session wants changes
+    auto egress_flow = session->broadcast_ref->video_egress->join(
+      config::stream.session_egress_limit ? config::stream.session_egress_limit * std::mega::num / 8 : pacer::UNLIMITED);
 
-    while (auto packet = packets->pop()) {
-      if (shutdown_event->peek()) {
+    // The stream's bitrate in bytes per second
+    std::uint64_t stream_rate = (std::uint64_t) session->config.monitor.bitrate * 1000 / 8;
+
+    // A full send_batch() may go out at once, later batches are spread out at the pacing rate
+    pacer::token_bucket_t pacing { egress_flow->rate(), 64 * 1024 };
+
+    auto zerocopy = session->broadcast_ref->video_zerocopy.get();
+
+    auto &bitrate_controller = session->video.bitrate_controller;
+
+    logging::min_max_avg_periodic_logger<double> frame_queue_wait_logger(debug, "Video queue wait", "ms");
+    logging::min_max_avg_periodic_logger<std::size_t> frame_queue_depth_logger(debug, "Video queue depth", "frames");
+
+    video::frame_queue_t::clock::duration queue_wait;
+    while (auto packet = packets->pop(&queue_wait)) {
+      if (session->shutdown_event->peek()) {
         break;
       }
 
+      frame_queue_wait_logger.collect_and_log(std::chrono::duration<double, std::milli>(queue_wait).count());
+      frame_queue_depth_logger.collect_and_log(packets->size());
+
+      // Buffers handed out by the arena are what used to be separate heap allocations
+      auto fec_arena_stats = fec_arena->stats();
+      auto log_fec_arena = util::fail_guard([&]() {
+        auto stats = fec_arena->stats();
+        frame_fec_buffers_logger.collect_and_log(stats.acquired - fec_arena_stats.acquired);
+        frame_fec_allocations_logger.collect_and_log(stats.allocations - fec_arena_stats.allocations);
+
+        fec_arena->trim(shard_arena::clock::now());
+      });
+
+      // Frames piling up behind this one mean the link can't keep up with the encoder
+      if (bitrate_controller) {
+        bitrate_controller->report_backlog(packets->size());
+      }
+
       frame_network_latency_logger.first_point_now();
 
-      auto session = (session_t *) packet->channel_data;
       auto lowseq = session->video.lowseq;
 
       std::string_view payload { (char *) packet->data(), packet->data_size() };
-      std::vector<uint8_t> payload_with_replacements;
-
-      // Apply replacements on the packet payload before performing any other operations.
-      // We need to know the final frame size to calculate the last packet size, and we
-      // must avoid matching replacements against the frame header or any other non-video
-      // part of the payload.
-      if (packet->is_idr() && packet->replacements) {
-        for (auto &replacement : *packet->replacements) {
-          auto frame_old = replacement.old;
-          auto frame_new = replacement._new;
-
-          payload_with_replacements = replace(payload, frame_old, frame_new);
-          payload = { (char *) payload_with_replacements.data(), payload_with_replacements.size() };
-        }
-      }
 
       video_short_frame_header_t frame_header = {};
       frame_header.headerType = 0x01;  // Short header type
@@ -1345,15 +1715,20 @@ namespace stream {
         frame_header.frame_processing_latency = 0;
       }
 
-      auto fecPercentage = config::stream.fec_percentage;
+      auto &fec_controller = session->video.fec_controller;
+      auto fecPercentage = fec_controller ?
+                             fec_controller->percentage(packet->is_idr(), std::chrono::steady_clock::now()) :
+                             config::stream.fec_percentage;
 
-      // Insert space for packet headers
+      // Reserve space for packet headers. The frame data is referenced in place by
+      // the packets, only slices that need to be gathered or padded are copied.
       auto blocksize = session->config.packetsize + MAX_RTP_HEADER_SIZE;
       auto payload_blocksize = blocksize - sizeof(video_packet_raw_t);
-      auto payload_new = concat_and_insert(sizeof(video_packet_raw_t), payload_blocksize,
+      auto slices = slice_and_insert(sizeof(video_packet_raw_t), payload_blocksize,
         std::string_view { (char *) &frame_header, sizeof(frame_header) }, payload);
 
-      payload = std::string_view { (char *) payload_new.data(), payload_new.size() };
+      // Size of the frame as it is sent, before padding the final packet
+      auto frame_size = slices.size() * sizeof(video_packet_raw_t) + slices.data_size;
 
       // There are 2 bits for FEC block count for a maximum of 4 FEC blocks
       constexpr auto MAX_FEC_BLOCKS = 4;
@@ -1365,11 +1740,20 @@ namespace stream {
       // D = 255 / (1 + F)
       // multiplied by 100 since F is the percentage as an integer:
       // D = (255 * 100) / (100 + F)
-      auto max_data_shards_per_fec_block = (DATA_SHARDS_MAX * 100) / (100 + fecPercentage);
+      auto fec_blocks_for = [&](int fecPercentage) {
+        auto max_data_shards_per_fec_block = (DATA_SHARDS_MAX * 100) / (100 + fecPercentage);
 
-      // Compute the number of FEC blocks needed for this frame using the block size and max shards
-      auto max_data_per_fec_block = max_data_shards_per_fec_block * blocksize;
-      auto fec_blocks_needed = (payload.size() + (max_data_per_fec_block - 1)) / max_data_per_fec_block;
+        // Compute the number of FEC blocks needed for this frame using the block size and max shards
+        auto max_data_per_fec_block = max_data_shards_per_fec_block * blocksize;
+        return (frame_size + (max_data_per_fec_block - 1)) / max_data_per_fec_block;
+      };
+      auto fec_blocks_needed = fec_blocks_for(fecPercentage);
+
+      // Extra parity chosen by adaptive FEC must not cost a large frame all of its protection
+      if (fec_blocks_needed > MAX_FEC_BLOCKS && fecPercentage > config::stream.fec_percentage) {
+        fecPercentage = config::stream.fec_percentage;
+        fec_blocks_needed = fec_blocks_for(fecPercentage);
+      }
 
       // If the number of FEC blocks needed exceeds the protocol limit, turn off FEC for this frame.
       // For normal FEC percentages, this should only happen for enormous frames (over 800 packets at 20%).
@@ -1379,7 +1763,8 @@ namespace stream {
         fec_blocks_needed = MAX_FEC_BLOCKS;
       }
 
-      std::array<std::string_view, MAX_FEC_BLOCKS> fec_blocks;
+      // First packet and packet count of each FEC block
+      std::array<std::pair<size_t, size_t>, MAX_FEC_BLOCKS> fec_blocks;
       decltype(fec_blocks)::iterator
         fec_blocks_begin = std::begin(fec_blocks),
         fec_blocks_end = std::begin(fec_blocks) + fec_blocks_needed;
@@ -1387,31 +1772,30 @@ namespace stream {
       BOOST_LOG(verbose) << "Generating "sv << fec_blocks_needed << " FEC blocks"sv;
 
       // Align individual FEC blocks to blocksize
-      auto unaligned_size = payload.size() / fec_blocks_needed;
-      auto aligned_size = ((unaligned_size + (blocksize - 1)) / blocksize) * blocksize;
+      auto unaligned_size = frame_size / fec_blocks_needed;
+      auto packets_per_fec_block = (unaligned_size + (blocksize - 1)) / blocksize;
 
       // If we exceed the 10-bit FEC packet index (which means our frame exceeded 4096 packets),
       // the frame will be unrecoverable. Log an error for this case.
-      if (aligned_size / blocksize >= 1024) {
-        BOOST_LOG(error) << "Encoder produced a frame too large to send! Is the encoder broken? (needed "sv << (aligned_size / blocksize) << " packets)"sv;
+      if (packets_per_fec_block >= 1024) {
+        BOOST_LOG(error) << "Encoder produced a frame too large to send! Is the encoder broken? (needed "sv << packets_per_fec_block << " packets)"sv;
       }
 
-      // Split the data into aligned FEC blocks
+      // Split the packets into aligned FEC blocks
       for (int x = 0; x < fec_blocks_needed; ++x) {
+        auto first_packet = std::min(x * packets_per_fec_block, slices.size());
+
         if (x == fec_blocks_needed - 1) {
           // The last block must extend to the end of the payload
-          fec_blocks[x] = payload.substr(x * aligned_size);
+          fec_blocks[x] = { first_packet, slices.size() - first_packet };
         }
         else {
           // Earlier blocks just extend to the next block offset
-          fec_blocks[x] = payload.substr(x * aligned_size, aligned_size);
+          fec_blocks[x] = { first_packet, std::min(packets_per_fec_block, slices.size() - first_packet) };
         }
       }
 
       try {
-        // Use around 80% of 1Gbps          1Gbps            percent    ms     packet      byte
-        size_t ratecontrol_packets_in_1ms = std::giga::num * 80 / 100 / 1000 / blocksize / 8;
-
         // Send less than 64K in a single batch.
         // On Windows, batches above 64K seem to bypass SO_SNDBUF regardless of its size,
         // appear in "Other I/O" and begin waiting for interrupts.
@@ -1422,21 +1806,40 @@ namespace stream {
         // Generic Segmentation Offload on Linux can't do more than 64.
         send_batch_size = std::min<size_t>(64, send_batch_size);
 
-        // Don't ignore the last ratecontrol group of the previous frame
-        auto ratecontrol_frame_start = std::max(ratecontrol_next_frame_start, std::chrono::steady_clock::now());
+        // Lay out all FEC blocks of the frame before sending any of them,
+        // so parity can be generated for all blocks in parallel.
+        std::vector<fec::fec_t> fec_shards;
+        fec_shards.reserve(fec_blocks_needed);
 
-        size_t ratecontrol_frame_packets_sent = 0;
-        size_t ratecontrol_group_packets_sent = 0;
+        // Parity generation refers to the frame, so it must be done before the frame is released
+        auto fec_guard = util::fail_guard([&]() {
+          for (auto &shards : fec_shards) {
+            shards.wait();
+          }
+
+          // Sends submitted through io_uring may still be reading from the frame
+          if (!platf::wait_for_sends()) {
+            BOOST_LOG(warning) << "Some packets of frame ["sv << packet->frame_index() << "] couldn't be sent"sv;
+          }
+
+          // Zerocopy sends may still refer to the frame, so it's released once the kernel is done with it
+          if (zerocopy) {
+            zerocopy->hold(std::make_shared<std::tuple<video::packet_t, sliced_payload_t, std::vector<fec::fec_t>>>(
+              std::move(packet), std::move(slices), std::move(fec_shards)));
+          }
+        });
 
         auto blockIndex = 0;
-        std::for_each(fec_blocks_begin, fec_blocks_end, [&](std::string_view &current_payload) {
-          auto packets = (current_payload.size() + (blocksize - 1)) / blocksize;
+        auto block_lowseq = lowseq;
+        std::for_each(fec_blocks_begin, fec_blocks_end, [&](const std::pair<size_t, size_t> &fec_block) {
+          auto first_packet = fec_block.first;
+          auto packets = fec_block.second;
 
           for (int x = 0; x < packets; ++x) {
-            auto *inspect = (video_packet_raw_t *) &current_payload[x * blocksize];
+            auto *inspect = (video_packet_raw_t *) slices.header(first_packet + x);
 
             inspect->packet.frameIndex = packet->frame_index();
-            inspect->packet.streamPacketIndex = ((uint32_t) lowseq + x) << 8;
+            inspect->packet.streamPacketIndex = ((uint32_t) block_lowseq + x) << 8;
 
             // Match multiFecFlags with Moonlight
             inspect->packet.multiFecFlags = 0x10;
@@ -1451,18 +1854,63 @@ namespace stream {
             }
           }
 
-          frame_fec_latency_logger.first_point_now();
           // If video encryption is enabled, we allocate space for the encryption header before each shard
-          auto shards = fec::encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets,
-            session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
-          frame_fec_latency_logger.second_point_now_and_log();
+          fec_shards.emplace_back(fec::prepare(slices, first_packet, packets, fecPercentage, session->config.minRequiredFecPackets,
+            session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0, session->broadcast_ref->fec_codecs, *fec_arena));
+
+          ++blockIndex;
+          block_lowseq += fec_shards.back().size();
+        });
+
+        // Spread the frame over half of its frame interval, so it's done well before the next frame.
+        // Never go slower than twice the stream's bitrate, so large frames can't build up a backlog,
+        // and never faster than this session's share of the egress bandwidth.
+        std::uint64_t frame_packets = block_lowseq - lowseq;
+        if (fec_controller) {
+          fec_controller->sent(frame_packets);
+        }
+        if (bitrate_controller) {
+          bitrate_controller->sent(frame_packets);
+        }
+        std::uint64_t frame_rate = frame_packets * blocksize * session->config.monitor.framerate * 2;
+        auto wanted_rate = std::max(frame_rate, stream_rate * 2);
+        egress_flow->want(wanted_rate, std::chrono::steady_clock::now());
+        pacing.set_rate(std::min(wanted_rate, egress_flow->rate()));
+
+        // Time it takes to send a single packet at the pacing rate
+        auto packet_interval = std::chrono::nanoseconds { std::nano::den * blocksize / pacing.rate() };
+
+        // Frames with multiple FEC blocks are large, so all of their blocks are handed off to the worker pool
+        auto fec_start = std::chrono::steady_clock::now();
+        for (auto &shards : fec_shards) {
+          fec::encode(shards, session->broadcast_ref->fec_pool, session->broadcast_ref->fec_workers, fec_shards.size() > 1);
+        }
+
+        auto fec_end = fec_start;
+        std::chrono::nanoseconds fec_busy {};
+
+        blockIndex = 0;
+        for (auto &shards : fec_shards) {
+          shards.wait();
+
+          frame_fec_latency_logger.first_point(fec_start);
+          frame_fec_latency_logger.second_point_and_log(shards.encode_end);
+
+          fec_end = std::max(fec_end, shards.encode_end);
+          fec_busy += shards.encode_busy;
+
+          // Encrypted shards are sent as the prefix followed by the encrypted header and payload.
+          // Otherwise, the header is sent followed by the payload which is still in the encoder's buffer.
+          auto encrypted = shards.prefixsize != 0;
+          auto send_header_size = encrypted ? shards.prefixsize : shards.headersize;
+          auto send_payload_size = encrypted ? shards.headersize + shards.blocksize : shards.blocksize;
 
           auto peer_address = session->video.peer.address();
           auto batch_info = platf::batched_send_info_t {
-            shards.headers.begin(),
-            shards.prefixsize,
-            shards.payload_buffers,
-            shards.blocksize,
+            encrypted ? shards.prefixes.begin() : shards.headers.begin(),
+            send_header_size,
+            shards.payloads(),
+            send_payload_size,
             0,
             0,
             (uintptr_t) sock.native_handle(),
@@ -1470,12 +1918,11 @@ namespace stream {
             session->video.peer.port(),
             session->localAddress,
           };
-
-          size_t next_shard_to_send = 0;
+          batch_info.zerocopy = zerocopy;
 
           // set FEC info now that we know for sure what our percentage will be for this frame
           for (auto x = 0; x < shards.size(); ++x) {
-            auto *inspect = (video_packet_raw_t *) shards.data(x);
+            auto *inspect = (video_packet_raw_t *) shards.header(x);
 
             // RTP video timestamps use a 90 KHz clock
             auto now = boost::posix_time::microsec_clock::universal_time();
@@ -1492,9 +1939,14 @@ namespace stream {
 
             inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
             inspect->packet.frameIndex = packet->frame_index();
+          }
 
-            // Encrypt this shard if video encryption is enabled
-            if (session->video.cipher) {
+          // Encrypt all shards of this block at once if video encryption is enabled
+          if (session->video.cipher) {
+            ivs.resize(shards.size(), crypto::aes_t(12));
+            encrypt_shards.clear();
+
+            for (auto x = 0; x < shards.size(); ++x) {
               // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
               // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
               // high bytes is the "fixed" field. Because each client provides their own unique
@@ -1503,38 +1955,52 @@ namespace stream {
               //
               // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
               // to be sent to each client before the IV repeats.
+              auto &iv = ivs[x];
               std::copy_n((uint8_t *) &session->video.gcm_iv_counter, sizeof(session->video.gcm_iv_counter), std::begin(iv));
               iv[11] = 'V';  // Video stream
               session->video.gcm_iv_counter++;
 
-              // Encrypt the target buffer in place
+              // The header and payload are encrypted into the send buffer
               auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
               prefix->frameNumber = packet->frame_index();
               std::copy(std::begin(iv), std::end(iv), prefix->iv);
-              session->video.cipher->encrypt(std::string_view { (char *) inspect, (size_t) blocksize },
-                prefix->tag, (uint8_t *) inspect, &iv);
+              encrypt_shards.emplace_back(crypto::cipher::gcm_shard_t {
+                std::string_view { shards.header(x), shards.headersize },
+                std::string_view { shards.data(x), shards.blocksize },
+                prefix->tag,
+                (uint8_t *) shards.encrypted_data(x),
+              });
+            }
+
+            auto ivs_used = std::span { ivs }.first(shards.size());
+            frame_encrypt_latency_logger.first_point_now();
+            if (session->video.cipher->encrypt_batch(encrypt_shards, ivs_used, session->broadcast_ref->fec_pool, session->broadcast_ref->fec_workers)) {
+              throw std::runtime_error("Couldn't encrypt video shards");
             }
+            frame_encrypt_latency_logger.second_point_now_and_log();
+          }
 
+          size_t next_shard_to_send = 0;
+          for (auto x = 0; x < shards.size(); ++x) {
             if (x - next_shard_to_send + 1 >= send_batch_size ||
                 x + 1 == shards.size()) {
-              // Do pacing within the frame.
-              // Also trigger pacing before the first send_batch() of the frame
-              // to account for the last send_batch() of the previous frame.
-              if (ratecontrol_group_packets_sent >= ratecontrol_packets_in_1ms ||
-                  ratecontrol_frame_packets_sent == 0) {
-                auto due = ratecontrol_frame_start +
-                           std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
-                             ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
-
-                auto now = std::chrono::steady_clock::now();
-                if (now < due) {
-                  timer->sleep_for(due - now);
-                }
+              size_t current_batch_size = x - next_shard_to_send + 1;
 
-                ratecontrol_group_packets_sent = 0;
+              // Do pacing within the frame. The bucket also accounts for the last batches of the previous frame.
+              auto now = std::chrono::steady_clock::now();
+              auto due = pacing.reserve(current_batch_size * blocksize, now);
+              if (session->broadcast_ref->video_txtime) {
+                // Let the kernel release this batch on schedule, so this thread never sleeps within a frame
+                batch_info.launch_time = due;
+                batch_info.launch_interval = packet_interval;
+              }
+              else if (now < due) {
+                timer->sleep_until(due);
+
+                auto overshoot = std::chrono::steady_clock::now() - due;
+                frame_pacing_overshoot_logger.collect_and_log(std::chrono::duration<double, std::micro>(overshoot).count());
               }
 
-              size_t current_batch_size = x - next_shard_to_send + 1;
               batch_info.block_offset = next_shard_to_send;
               batch_info.block_count = current_batch_size;
 
@@ -1545,10 +2011,10 @@ namespace stream {
                 BOOST_LOG(verbose) << "Falling back to unbatched send"sv;
                 for (auto y = 0; y < current_batch_size; y++) {
                   auto send_info = platf::send_info_t {
-                    shards.prefix(next_shard_to_send + y),
-                    shards.prefixsize,
-                    shards.data(next_shard_to_send + y),
-                    shards.blocksize,
+                    encrypted ? shards.prefix(next_shard_to_send + y) : shards.header(next_shard_to_send + y),
+                    send_header_size,
+                    encrypted ? shards.encrypted_data(next_shard_to_send + y) : shards.data(next_shard_to_send + y),
+                    send_payload_size,
                     (uintptr_t) sock.native_handle(),
                     peer_address,
                     session->video.peer.port(),
@@ -1560,19 +2026,16 @@ namespace stream {
               }
               frame_send_batch_latency_logger.second_point_now_and_log();
 
-              ratecontrol_group_packets_sent += current_batch_size;
-              ratecontrol_frame_packets_sent += current_batch_size;
               next_shard_to_send = x + 1;
             }
           }
 
-          // remember this in case the next frame comes immediately
-          ratecontrol_next_frame_start = ratecontrol_frame_start +
-                                         std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
-                                           ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
-
           frame_network_latency_logger.second_point_now_and_log();
 
+          if (bitrate_controller) {
+            bitrate_controller->report_stalls(batch_info.stalls);
+          }
+
           if (packet->is_idr()) {
             BOOST_LOG(verbose) << "Key Frame ["sv << packet->frame_index() << "] :: send ["sv << shards.size() << "] shards..."sv;
           }
@@ -1582,9 +2045,27 @@ namespace stream {
 
           ++blockIndex;
           lowseq += shards.size();
-        });
+        }
+
+        // Compare the time spent generating parity with the time it took until all parity was ready
+        if (fec_busy.count() && fec_end > fec_start) {
+          frame_fec_speedup_logger.collect_and_log(std::chrono::duration<double>(fec_busy) / (fec_end - fec_start));
+        }
 
         session->video.lowseq = lowseq;
+
+        if (bitrate_controller) {
+          // The encoder can't follow the controller, so there's no point in cutting the bitrate
+          if (session->video.fixed_bitrate_events->peek()) {
+            session->video.fixed_bitrate_events->pop();
+            bitrate_controller->disable();
+          }
+
+          if (auto bitrate = bitrate_controller->update(std::chrono::steady_clock::now())) {
+            BOOST_LOG(verbose) << "Adaptive bitrate: "sv << *bitrate << " Kbps"sv;
+            session->video.bitrate_events->raise(*bitrate);
+          }
+        }
       }
       catch (const std::exception &e) {
         BOOST_LOG(error) << "Broadcast video failed "sv << e.what();
@@ -1592,13 +2073,31 @@ namespace stream {
       }
     }
 
-    shutdown_event->raise(true);
+    auto stats = packets->stats();
+    if (stats.popped) {
+      BOOST_LOG(debug) << "Video queue: "sv << stats.popped << " frames sent, waited "sv
+                       << std::chrono::duration<double, std::milli>(stats.total_wait).count() / stats.popped << " ms on average and "sv
+                       << std::chrono::duration<double, std::milli>(stats.max_wait).count() << " ms at most, up to "sv
+                       << stats.max_depth << " frames queued"sv;
+    }
+    if (stats.dropped_frames) {
+      BOOST_LOG(info) << "Video queue dropped "sv << stats.dropped_frames << " of "sv << stats.frames << " frames ("sv
+                      << stats.dropped_bytes << " bytes) and requested recovery "sv << stats.recoveries << " times"sv;
+    }
+
+    auto fec_arena_stats = fec_arena->stats();
+    BOOST_LOG(debug) << "FEC buffers: "sv << fec_arena_stats.allocations << " heap allocations for "sv << fec_arena_stats.acquired
+                     << " buffers, "sv << fec_arena_stats.bytes << " bytes allocated at the end"sv;
   }
 
+  /**
+   * @brief Protect and send the encoded audio of a single session.
+   * @param session The session to send audio for.
+   */
   void
-  audioBroadcastThread(udp::socket &sock) {
-    auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
+  audioSendThread(session_t *session) {
+    auto &sock = session->broadcast_ref->audio_sock;
+    auto &packets = session->audio.packets;
 
     audio_packet_t audio_packet;
     fec::rs_t rs { reed_solomon_new(RTPA_DATA_SHARDS, RTPA_FEC_SHARDS) };
@@ -1616,16 +2115,26 @@ namespace stream {
     audio_packet.rtp.packetType = 97;
     audio_packet.rtp.ssrc = 0;
 
-    // Audio traffic is sent on this thread
+    // Audio traffic for this session is sent on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
+    logging::min_max_avg_periodic_logger<std::size_t> audio_queue_depth_logger(debug, "Audio queue depth", "packets");
+
+    // Packets sent and the send calls it took
+    std::uint64_t packets_sent = 0;
+    std::uint64_t send_calls = 0;
+
+    // Headers of the FEC shards of a block, which are sent together with its last data shard
+    std::array<audio_fec_packet_t, RTPA_FEC_SHARDS> fec_packets;
+
     while (auto packet = packets->pop()) {
-      if (shutdown_event->peek()) {
+      if (session->shutdown_event->peek()) {
         break;
       }
 
-      TUPLE_2D_REF(channel_data, packet_data, *packet);
-      auto session = (session_t *) channel_data;
+      audio_queue_depth_logger.collect_and_log(packets->size());
+
+      auto &packet_data = *packet->second;
 
       auto sequenceNumber = session->audio.sequenceNumber;
       auto timestamp = session->audio.timestamp;
@@ -1659,8 +2168,6 @@ namespace stream {
           session->audio.peer.port(),
           session->localAddress,
         };
-        platf::send(send_info);
-        BOOST_LOG(verbose) << "Audio ["sv << sequenceNumber << "] ::  send..."sv;
 
         auto &fec_packet = session->audio.fec_packet;
         // initialize the FEC header at the beginning of the FEC block
@@ -1669,28 +2176,52 @@ namespace stream {
           fec_packet.fecHeader.baseTimestamp = util::endian::big(timestamp);
         }
 
-        // generate parity shards at the end of the FEC block
-        if ((sequenceNumber + 1) % RTPA_DATA_SHARDS == 0) {
-          reed_solomon_encode(rs.get(), shards_p.begin(), RTPA_TOTAL_SHARDS, bytes);
-
-          for (auto x = 0; x < RTPA_FEC_SHARDS; ++x) {
-            fec_packet.rtp.sequenceNumber = util::endian::big<std::uint16_t>(sequenceNumber + x + 1);
-            fec_packet.fecHeader.fecShardIndex = x;
-
-            auto send_info = platf::send_info_t {
-              (const char *) &fec_packet,
-              sizeof(fec_packet),
-              (const char *) shards_p[RTPA_DATA_SHARDS + x],
-              (size_t) bytes,
-              (uintptr_t) sock.native_handle(),
-              peer_address,
-              session->audio.peer.port(),
-              session->localAddress,
-            };
-            platf::send(send_info);
-            BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << ' ' << x << "] ::  send..."sv;
+        if ((sequenceNumber + 1) % RTPA_DATA_SHARDS != 0) {
+          platf::send(send_info);
+          BOOST_LOG(verbose) << "Audio ["sv << sequenceNumber << "] ::  send..."sv;
+
+          ++packets_sent;
+          ++send_calls;
+          continue;
+        }
+
+        // generate parity shards at the end of the FEC block, so they go out along with its last data shard
+        reed_solomon_encode(rs.get(), shards_p.begin(), RTPA_TOTAL_SHARDS, bytes);
+
+        auto fec_send_info = [&](int x) {
+          fec_packets[x] = fec_packet;
+          fec_packets[x].rtp.sequenceNumber = util::endian::big<std::uint16_t>(sequenceNumber + x + 1);
+          fec_packets[x].fecHeader.fecShardIndex = x;
+
+          return platf::send_info_t {
+            (const char *) &fec_packets[x],
+            sizeof(audio_fec_packet_t),
+            (const char *) shards_p[RTPA_DATA_SHARDS + x],
+            (size_t) bytes,
+            (uintptr_t) sock.native_handle(),
+            peer_address,
+            session->audio.peer.port(),
+            session->localAddress,
+          };
+        };
+        auto block_send_infos = [&]<std::size_t... x>(std::index_sequence<x...>) {
+          return std::array { send_info, fec_send_info(x)... };
+        }(std::make_index_sequence<RTPA_FEC_SHARDS>());
+
+        if (platf::send_multiple(block_send_infos)) {
+          ++send_calls;
+        }
+        else {
+          // Sending several messages at once is not available, so send each packet individually
+          for (auto &block_send_info : block_send_infos) {
+            platf::send(block_send_info);
           }
+          send_calls += block_send_infos.size();
         }
+        packets_sent += block_send_infos.size();
+
+        BOOST_LOG(verbose) << "Audio ["sv << sequenceNumber << "] ::  send..."sv;
+        BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << "] ::  send..."sv;
       }
       catch (const std::exception &e) {
         BOOST_LOG(error) << "Broadcast audio failed "sv << e.what();
@@ -1698,7 +2229,7 @@ namespace stream {
       }
     }
 
-    shutdown_event->raise(true);
+    BOOST_LOG(debug) << "Audio: sent "sv << packets_sent << " packets with "sv << send_calls << " send calls"sv;
   }
 
   int
@@ -1738,6 +2269,21 @@ namespace stream {
       return -1;
     }
 
+    ctx.video_egress = std::make_unique<pacer::egress_t>(
+      config::stream.egress_limit ? config::stream.egress_limit * std::mega::num / 8 : pacer::UNLIMITED);
+
+    ctx.video_txtime = config::stream.kernel_pacing && platf::enable_socket_txtime(ctx.video_sock.native_handle());
+    if (config::stream.kernel_pacing && !ctx.video_txtime) {
+      BOOST_LOG(warning) << "Kernel pacing is not available, video will be paced by Sunshine instead"sv;
+    }
+
+    if (config::stream.zerocopy_send) {
+      ctx.video_zerocopy = platf::enable_socket_zerocopy(ctx.video_sock.native_handle());
+      if (!ctx.video_zerocopy) {
+        BOOST_LOG(warning) << "Zerocopy sends are not available, video will be copied into the kernel"sv;
+      }
+    }
+
     ctx.audio_sock.open(protocol, ec);
     if (ec) {
       BOOST_LOG(fatal) << "Couldn't open socket for Audio server: "sv << ec.message();
@@ -1754,8 +2300,9 @@ namespace stream {
 
     ctx.message_queue_queue = std::make_shared<message_queue_queue_t::element_type>(30);
 
-    ctx.video_thread = std::thread { videoBroadcastThread, std::ref(ctx.video_sock) };
-    ctx.audio_thread = std::thread { audioBroadcastThread, std::ref(ctx.audio_sock) };
+    ctx.fec_workers = std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, 8);
+    ctx.fec_pool.start(ctx.fec_workers);
+
     ctx.control_thread = std::thread { controlBroadcastThread, &ctx.control_server };
 
     ctx.recv_thread = std::thread { recvThread, std::ref(ctx) };
@@ -1769,30 +2316,31 @@ namespace stream {
 
     broadcast_shutdown_event->raise(true);
 
-    auto video_packets = mail::man->queue<video::packet_t>(mail::video_packets);
-    auto audio_packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
-
-    // Minimize delay stopping video/audio threads
-    video_packets->stop();
-    audio_packets->stop();
-
     ctx.message_queue_queue->stop();
     ctx.io.stop();
 
     ctx.video_sock.close();
     ctx.audio_sock.close();
 
-    video_packets.reset();
-    audio_packets.reset();
-
     BOOST_LOG(debug) << "Waiting for main listening thread to end..."sv;
     ctx.recv_thread.join();
-    BOOST_LOG(debug) << "Waiting for main video thread to end..."sv;
-    ctx.video_thread.join();
-    BOOST_LOG(debug) << "Waiting for main audio thread to end..."sv;
-    ctx.audio_thread.join();
     BOOST_LOG(debug) << "Waiting for main control thread to end..."sv;
     ctx.control_thread.join();
+    BOOST_LOG(debug) << "Waiting for FEC worker threads to end..."sv;
+    ctx.fec_pool.stop();
+    ctx.fec_pool.join();
+
+    auto fec_codec_stats = ctx.fec_codecs.stats();
+    BOOST_LOG(debug) << "Reed-Solomon codec cache: "sv << fec_codec_stats.hits << " hits, "sv << fec_codec_stats.misses << " misses"sv;
+
+    if (ctx.video_zerocopy) {
+      auto zerocopy_stats = ctx.video_zerocopy->stats();
+      BOOST_LOG(debug) << "Video sends: "sv << zerocopy_stats.zerocopy << " zerocopy ("sv << zerocopy_stats.deferred_copies
+                       << " copied by the kernel), "sv << zerocopy_stats.copied << " copied"sv;
+
+      // The socket is closed, so the kernel no longer sends from the held frames
+      ctx.video_zerocopy.reset();
+    }
     BOOST_LOG(debug) << "All broadcasting threads ended"sv;
 
     broadcast_shutdown_event->reset();
@@ -1874,7 +2422,7 @@ namespace stream {
       session->video.peer.port(), platf::qos_data_type_e::video, session->config.videoQosType != 0);
 
     BOOST_LOG(debug) << "Start capturing Video"sv;
-    video::capture(session->mail, session->config.monitor, session);
+    video::capture(session->mail, session->config.monitor, *session->video.packets, session);
   }
 
   void
@@ -1938,10 +2486,22 @@ namespace stream {
 
       BOOST_LOG(debug) << "Waiting for video to end..."sv;
       session.videoThread.join();
+      // The encoder is gone, so no more frames can be queued for this session
+      session.video.packets->stop();
+      BOOST_LOG(debug) << "Waiting for video sender to end..."sv;
+      session.videoSendThread.join();
       BOOST_LOG(debug) << "Waiting for audio to end..."sv;
       session.audioThread.join();
+      session.audio.packets->stop();
+      BOOST_LOG(debug) << "Waiting for audio sender to end..."sv;
+      session.audioSendThread.join();
       BOOST_LOG(debug) << "Waiting for control to end..."sv;
       session.controlEnd.view();
+
+      // The control thread may be gone along with the broadcast, so feedback must no longer wake it up
+      session.control.feedback_queue->on_raise(nullptr);
+      session.control.hdr_queue->on_raise(nullptr);
+
       // Reset input on session stop to avoid stuck repeated keys
       BOOST_LOG(debug) << "Resetting Input..."sv;
       input::reset(session.input);
@@ -1968,6 +2528,13 @@ namespace stream {
         return -1;
       }
 
+      // Feedback for the client wakes up the control thread, so it's sent right away
+      auto wake_control = [server = &session.broadcast_ref->control_server]() {
+        server->wake();
+      };
+      session.control.feedback_queue->on_raise(wake_control);
+      session.control.hdr_queue->on_raise(wake_control);
+
       session.control.expected_peer_address = addr_string;
       BOOST_LOG(debug) << "Expecting incoming session connections from "sv << addr_string;
 
@@ -1987,7 +2554,9 @@ namespace stream {
       session.pingTimeout = std::chrono::steady_clock::now() + config::stream.ping_timeout;
 
       session.audioThread = std::thread { audioThread, &session };
+      session.audioSendThread = std::thread { audioSendThread, &session };
       session.videoThread = std::thread { videoThread, &session };
+      session.videoSendThread = std::thread { videoSendThread, &session };
 
       session.state.store(state_e::RUNNING, std::memory_order_relaxed);
 
@@ -2023,8 +2592,24 @@ namespace stream {
 
       session->video.idr_events = mail->event<bool>(mail::idr);
       session->video.invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+      session->video.bitrate_events = mail->event<int>(mail::bitrate);
+      session->video.fixed_bitrate_events = mail->event<bool>(mail::fixed_bitrate);
+      // Hold up to a second of video, but never less than a few key frames. Frames waiting longer than
+      // this are stale, and when frames the encoder still references are dropped, it's asked to recover.
+      session->video.packets = std::make_unique<video::frame_queue_t>(
+        32, std::max<std::size_t>((std::size_t) config.monitor.bitrate * 1000 / 8, 4 * 1024 * 1024), 500ms,
+        [invalidate_ref_frames_events = session->video.invalidate_ref_frames_events](std::int64_t first_frame, std::int64_t last_frame) {
+          BOOST_LOG(debug) << "Dropped video frames "sv << first_frame << '-' << last_frame << ", requesting recovery"sv;
+          invalidate_ref_frames_events->raise(std::make_pair(first_frame, last_frame));
+        });
       session->video.lowseq = 0;
       session->video.ping_payload = launch_session.av_ping_payload;
+      if (config::stream.adaptive_fec) {
+        session->video.fec_controller = std::make_unique<adaptive_fec::controller_t>(config::stream.fec_percentage, std::chrono::steady_clock::now());
+      }
+      if (config::stream.adaptive_bitrate) {
+        session->video.bitrate_controller = std::make_unique<adaptive_bitrate::controller_t>(config.monitor.bitrate, std::chrono::steady_clock::now());
+      }
       if (config.encryptionFlagsEnabled & SS_ENC_VIDEO) {
         BOOST_LOG(info) << "Video encryption enabled"sv;
         session->video.cipher = crypto::cipher::gcm_t {
@@ -2059,6 +2644,7 @@ namespace stream {
         launch_session.gcm_key, true
       };
 
+      session->audio.packets = mail->queue<audio::packet_t>(mail::audio_packets);
       session->audio.ping_payload = launch_session.av_ping_payload;
       session->audio.avRiKeyId = util::endian::big(*(std::uint32_t *) launch_session.iv.data());
       session->audio.sequenceNumber = 0;
@@ -3,14 +3,24 @@
  * @brief Declarations for the streaming protocols.
  */
 #pragma once
+#include <future>
 #include <utility>
 
 #include <boost/asio.hpp>
 
+extern "C" {
+#include "rswrapper.h"
+}
+
 #include "audio.h"
 #include "crypto.h"
+#include "thread_pool.h"
 #include "video.h"
 
+namespace rtsp_stream {
+  struct launch_session_t;
+}  // namespace rtsp_stream
+
 namespace stream {
   constexpr auto VIDEO_STREAM_PORT = 9;
   constexpr auto CONTROL_PORT = 10;
@@ -33,6 +43,67 @@ namespace stream {
     std::optional<int> gcmap;
   };
 
+  /**
+   * @brief A payload split into fixed-size slices with a zeroed header reserved in front of each slice.
+   * @details Slices that lie entirely within one of the source buffers point into that buffer.
+   * Only a slice spanning both buffers and the zero-padded final slice are copied into owned memory.
+   */
+  struct sliced_payload_t {
+    std::size_t insert_size;
+    std::size_t slice_size;
+
+    // Number of payload bytes, excluding headers and the padding of the final slice
+    std::size_t data_size;
+
+    util::buffer_t<char> headers;
+    util::buffer_t<char> owned;
+
+    // Each slice is slice_size bytes long
+    std::vector<const char *> slices;
+
+    char *
+    header(std::size_t el) {
+      return &headers[el * insert_size];
+    }
+
+    std::size_t
+    size() const {
+      return slices.size();
+    }
+  };
+
+  /**
+   * @brief Split two concatenated buffers into slices and reserve a header before each slice, without copying the buffers.
+   * @param insert_size The number of header bytes to reserve before each slice.
+   * @param slice_size The number of payload bytes in each slice.
+   * @param data1 The first data buffer.
+   * @param data2 The second data buffer.
+   * @return The sliced payload. The source buffers must outlive it.
+   */
+  sliced_payload_t
+  slice_and_insert(std::size_t insert_size, std::size_t slice_size, const std::string_view &data1, const std::string_view &data2);
+
+  namespace fec {
+    // Start and end of a parity generation task
+    using task_time_t = std::pair<std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point>;
+
+    /**
+     * @brief Generate the parity shards of a Reed-Solomon block in byte ranges on a worker pool.
+     * @details Reed-Solomon operates on each byte offset of the shards independently, so the ranges
+     * together give the same parity as encoding the whole block at once. Ranges are aligned to 64
+     * bytes for the vectorized encoders, so small blocks may get fewer ranges than asked for.
+     * @param rs The Reed-Solomon instance for the block.
+     * @param shards_p Pointers to the data shards, followed by the parity shards.
+     * @param nr_shards The total number of shards.
+     * @param blocksize The size of each shard.
+     * @param ranges The number of byte ranges to split the shards into.
+     * @param pool The worker pool.
+     * @return The task of each range. All of them must complete before the parity shards are read.
+     */
+    std::vector<std::future<task_time_t>>
+    encode_ranges(reed_solomon *rs, uint8_t *const *shards_p, size_t nr_shards, size_t blocksize, size_t ranges, thread_pool_util::ThreadPool &pool);
+  }  // namespace fec
+
   namespace session {
     enum class state_e : int {
       STOPPED,  ///< The session is stopped
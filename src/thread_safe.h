@@ -9,6 +9,7 @@
 #include <condition_variable>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -36,6 +37,23 @@ namespace safe {
       }
 
       _cv.notify_all();
+
+      if (_on_raise) {
+        _on_raise();
+      }
+    }
+
+    /**
+     * @brief Call a function whenever the event is raised.
+     * @details Lets a thread that waits on more than this event be woken up. The function is
+     * called with the event locked, so it must not block.
+     * @param on_raise The function, or `nullptr` to stop calling it.
+     */
+    void
+    on_raise(std::function<void()> on_raise) {
+      std::lock_guard lg { _lock };
+
+      _on_raise = std::move(on_raise);
     }
 
     // pop and view should not be used interchangeably
@@ -152,6 +170,8 @@ namespace safe {
     bool _continue { true };
     status_t _status { util::false_v<status_t> };
 
+    std::function<void()> _on_raise;
+
     std::condition_variable _cv;
     std::mutex _lock;
   };
@@ -274,18 +294,52 @@ namespace safe {
         return;
       }
 
-      if (_queue.size() == _max_elements) {
+      if (_queue.size() - _head == _max_elements) {
         _queue.clear();
+        _head = 0;
+      }
+      else if (_head && _queue.size() == _queue.capacity()) {
+        // Reclaim the popped elements instead of growing
+        compact();
       }
 
       _queue.emplace_back(std::forward<Args>(args)...);
 
       _cv.notify_all();
+
+      if (_on_raise) {
+        _on_raise();
+      }
+    }
+
+    /**
+     * @brief Call a function whenever an element is raised.
+     * @details Lets a thread that waits on more than this queue be woken up. The function is
+     * called with the queue locked, so it must not block.
+     * @param on_raise The function, or `nullptr` to stop calling it.
+     */
+    void
+    on_raise(std::function<void()> on_raise) {
+      std::lock_guard lg { _lock };
+
+      _on_raise = std::move(on_raise);
     }
 
     bool
     peek() {
-      return _continue && !_queue.empty();
+      return _continue && _head < _queue.size();
+    }
+
+    std::size_t
+    size() {
+      std::lock_guard lg { _lock };
+
+      return _queue.size() - _head;
+    }
+
+    std::uint32_t
+    max_elements() const {
+      return _max_elements;
     }
 
     template <class Rep, class Period>
@@ -297,16 +351,13 @@ namespace safe {
         return util::false_v<status_t>;
       }
 
-      while (_queue.empty()) {
+      while (_head == _queue.size()) {
         if (!_continue || _cv.wait_for(ul, delay) == std::cv_status::timeout) {
           return util::false_v<status_t>;
         }
       }
 
-      auto val = std::move(_queue.front());
-      _queue.erase(std::begin(_queue));
-
-      return val;
+      return take();
     }
 
     status_t
@@ -317,7 +368,7 @@ namespace safe {
         return util::false_v<status_t>;
       }
 
-      while (_queue.empty()) {
+      while (_head == _queue.size()) {
         _cv.wait(ul);
 
         if (!_continue) {
@@ -325,14 +376,13 @@ namespace safe {
         }
       }
 
-      auto val = std::move(_queue.front());
-      _queue.erase(std::begin(_queue));
-
-      return val;
+      return take();
     }
 
     std::vector<T> &
     unsafe() {
+      compact();
+
       return _queue;
     }
 
@@ -351,13 +401,126 @@ namespace safe {
     }
 
   private:
+    /**
+     * @brief Take the oldest element, which must exist.
+     */
+    T
+    take() {
+      auto val = std::move(_queue[_head++]);
+
+      // Once the queue is drained, it starts over at the front without moving any elements
+      if (_head == _queue.size()) {
+        _queue.clear();
+        _head = 0;
+      }
+
+      return val;
+    }
+
+    /**
+     * @brief Drop the elements that were already popped.
+     */
+    void
+    compact() {
+      _queue.erase(std::begin(_queue), std::begin(_queue) + _head);
+      _head = 0;
+    }
+
     bool _continue { true };
     std::uint32_t _max_elements;
 
+    std::function<void()> _on_raise;
+
     std::mutex _lock;
     std::condition_variable _cv;
 
+    // Elements before _head were popped already
     std::vector<T> _queue;
+    std::size_t _head = 0;
+  };
+
+  /**
+   * @brief A pool of preallocated objects, which are recycled instead of being freed.
+   * @details Objects are handed out as `ptr_t`, which puts them back into the pool when destroyed.
+   * A pool that runs out of objects grows, so it stops allocating once it holds the most objects
+   * that were in use at once. Objects keep the pool alive, so the pool must be owned by a `std::shared_ptr`.
+   */
+  template <class T>
+  class pool_t: public std::enable_shared_from_this<pool_t<T>> {
+  public:
+    struct deleter_t {
+      std::shared_ptr<pool_t> pool;
+
+      void
+      operator()(T *obj) {
+        // A reset pointer no longer keeps the pool alive
+        auto owner = std::move(pool);
+        owner->release(obj);
+      }
+    };
+
+    using ptr_t = std::unique_ptr<T, deleter_t>;
+
+    /**
+     * @param size The number of objects to preallocate.
+     * @param init The object every object of the pool starts out as a copy of.
+     */
+    pool_t(std::size_t size, T init):
+        _init { std::move(init) } {
+      _objects.reserve(size);
+      _free.reserve(size);
+
+      for (std::size_t x = 0; x < size; ++x) {
+        _free.emplace_back(_objects.emplace_back(std::make_unique<T>(_init)).get());
+      }
+    }
+
+    /**
+     * @brief Get an object that isn't in use.
+     * @return The object, as it was left by its previous user.
+     */
+    ptr_t
+    acquire() {
+      std::lock_guard lg { _lock };
+
+      if (_free.empty()) {
+        _free.reserve(_objects.size() + 1);
+        _free.emplace_back(_objects.emplace_back(std::make_unique<T>(_init)).get());
+      }
+
+      auto obj = _free.back();
+      _free.pop_back();
+
+      return ptr_t { obj, deleter_t { this->shared_from_this() } };
+    }
+
+    /**
+     * @brief Get the number of objects the pool allocated.
+     * @return The number of objects, whether in use or not.
+     */
+    std::size_t
+    size() {
+      std::lock_guard lg { _lock };
+
+      return _objects.size();
+    }
+
+  private:
+    void
+    release(T *obj) {
+      std::lock_guard lg { _lock };
+
+      _free.emplace_back(obj);
+    }
+
+    T _init;
+
+    std::mutex _lock;
+
+    std::vector<std::unique_ptr<T>> _objects;
+
+    // Objects that aren't in use, with room for all objects
+    std::vector<T *> _free;
   };
 
   template <class T>
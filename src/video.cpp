@@ -18,12 +18,14 @@ extern "C" {
 
 #include "cbs.h"
 #include "config.h"
+#include "frame_queue.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
 #include "nvenc/nvenc_base.h"
 #include "platform/common.h"
 #include "sync.h"
+#include "thread_pool.h"
 #include "video.h"
 
 #ifdef _WIN32
@@ -50,6 +52,13 @@ namespace video {
     av_buffer_unref(&ref);
   }
 
+  static void
+  free_buffer_pool(AVBufferPool *pool) {
+    av_buffer_pool_uninit(&pool);
+  }
+
+  using buffer_pool_t = util::safe_ptr<AVBufferPool, free_buffer_pool>;
+
   namespace nv {
 
     enum class profile_h264_e : int {
@@ -89,12 +98,89 @@ namespace video {
   util::Either<avcodec_buffer_t, int>
   vt_init_avcodec_hardware_input_buffer(platf::avcodec_encode_device_t *);
 
+  /**
+   * @brief Frames converted from a single captured image, for reuse by the encoders of other sessions.
+   * @details Sessions that only differ in codec or bitrate need the same color conversion and scaling.
+   * The first of them to convert the image adds a reference to its frame, the others share its buffers.
+   */
+  struct conversion_cache_t {
+    struct key_t {
+      int width;
+      int height;
+      int format;
+      colorspace_e colorspace;
+      bool full_range;
+
+      bool
+      operator==(const key_t &) const = default;
+    };
+
+    /**
+     * @brief Find the image converted to a format.
+     * @return The converted frame, or `nullptr` if no session converted to this format yet.
+     */
+    AVFrame *
+    find(const key_t &key) {
+      std::lock_guard lg { mutex };
+      for (auto &[frame_key, frame] : frames) {
+        if (frame_key == key) {
+          return frame.get();
+        }
+      }
+
+      return nullptr;
+    }
+
+    /**
+     * @brief Add a reference to a converted frame.
+     */
+    void
+    insert(const key_t &key, AVFrame *frame) {
+      std::lock_guard lg { mutex };
+      for (auto &[frame_key, _] : frames) {
+        if (frame_key == key) {
+          return;
+        }
+      }
+
+      avcodec_frame_t ref { av_frame_alloc() };
+      if (av_frame_ref(ref.get(), frame) < 0) {
+        return;
+      }
+      frames.emplace_back(key, std::move(ref));
+    }
+
+    std::mutex mutex;
+    std::vector<std::pair<key_t, avcodec_frame_t>> frames;
+  };
+
   class avcodec_software_encode_device_t: public platf::avcodec_encode_device_t {
   public:
     int
     convert(platf::img_t &img) override {
+      conversion_cache_t::key_t key {
+        sw_frame->width,
+        sw_frame->height,
+        sw_frame->format,
+        colorspace.colorspace,
+        colorspace.full_range,
+      };
+
+      // Another session may have converted this image to the same format already
+      if (img.conversions) {
+        if (auto converted = img.conversions->find(key)) {
+          return use_converted(converted);
+        }
+      }
+
+      // The buffers may still be shared with other sessions from the previous image,
+      // the whole frame is overwritten anyway, so there's no need to copy them
+      if (!av_frame_is_writable(sw_frame.get()) && replace_buffers()) {
+        return -1;
+      }
+
       // If we need to add aspect ratio padding, we need to scale into an intermediate output buffer
-      bool requires_padding = (sw_frame->width != sws_output_frame->width || sw_frame->height != sws_output_frame->height);
+      bool requires_padding = this->requires_padding();
 
       // Setup the input frame using the caller's img_t
       sws_input_frame->data[0] = img.data;
@@ -126,6 +212,10 @@ namespace video {
         }
       }
 
+      if (img.conversions) {
+        img.conversions->insert(key, sw_frame.get());
+      }
+
       // If frame is not a software frame, it means we still need to transfer from main memory
       // to vram memory
       if (frame->hw_frames_ctx) {
@@ -140,6 +230,101 @@ namespace video {
       return 0;
     }
 
+    /**
+     * @brief Encode a frame another session converted, instead of converting the image again.
+     * @param converted The converted frame.
+     * @return 0 on success, -1 on error.
+     */
+    int
+    use_converted(AVFrame *converted) {
+      if (frame->hw_frames_ctx) {
+        auto status = av_hwframe_transfer_data(frame, converted, 0);
+        if (status < 0) {
+          char string[AV_ERROR_MAX_STRING_SIZE];
+          BOOST_LOG(error) << "Failed to transfer image data to hardware frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
+          return -1;
+        }
+
+        return 0;
+      }
+
+      // Share the converted buffers, but keep the properties our encoder set on the frame
+      avcodec_frame_t props { av_frame_alloc() };
+      av_frame_copy_props(props.get(), frame);
+
+      av_frame_unref(frame);
+      auto status = av_frame_ref(frame, converted);
+      av_frame_copy_props(frame, props.get());
+      if (status < 0) {
+        char string[AV_ERROR_MAX_STRING_SIZE];
+        BOOST_LOG(error) << "Couldn't reference converted frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
+        return -1;
+      }
+
+      return 0;
+    }
+
+    /**
+     * @brief Give the frame unshared buffers from the pool.
+     * @return 0 on success, -1 on error.
+     */
+    int
+    replace_buffers() {
+      auto format = (AVPixelFormat) sw_frame->format;
+      if (!buffer_pool) {
+        auto size = av_image_get_buffer_size(format, sw_frame->width, sw_frame->height, BUFFER_ALIGN);
+        if (size > 0) {
+          buffer_pool.reset(av_buffer_pool_init2(size, this, alloc_buffer, nullptr));
+        }
+        if (!buffer_pool) {
+          BOOST_LOG(error) << "Couldn't create frame buffer pool"sv;
+          return -1;
+        }
+      }
+
+      avcodec_buffer_t buffer { av_buffer_pool_get(buffer_pool.get()) };
+      if (!buffer) {
+        BOOST_LOG(error) << "Couldn't allocate frame buffer"sv;
+        return -1;
+      }
+
+      for (auto &buf : sw_frame->buf) {
+        av_buffer_unref(&buf);
+      }
+      av_image_fill_arrays(sw_frame->data, sw_frame->linesize, buffer->data, format, sw_frame->width, sw_frame->height, BUFFER_ALIGN);
+      sw_frame->buf[0] = buffer.release();
+
+      return 0;
+    }
+
+    /**
+     * @brief Allocate a buffer for the pool.
+     * @details Conversion only writes the picture inside the aspect ratio padding,
+     * so the padding only needs to be filled when the buffer is first allocated.
+     */
+    static AVBufferRef *
+    alloc_buffer(void *opaque, size_t size) {
+      auto device = (avcodec_software_encode_device_t *) opaque;
+      auto sw_frame = device->sw_frame.get();
+
+      auto buffer = av_buffer_alloc(size);
+      if (buffer && device->requires_padding()) {
+        uint8_t *data[4];
+        int linesize[4];
+        av_image_fill_arrays(data, linesize, buffer->data, (AVPixelFormat) sw_frame->format, sw_frame->width, sw_frame->height, BUFFER_ALIGN);
+
+        ptrdiff_t linesize_fill[4] = { linesize[0], linesize[1], linesize[2], linesize[3] };
+        av_image_fill_black(data, linesize_fill, (AVPixelFormat) sw_frame->format, sw_frame->color_range, sw_frame->width, sw_frame->height);
+      }
+
+      return buffer;
+    }
+
+    bool
+    requires_padding() const {
+      return sw_frame->width != sws_output_frame->width || sw_frame->height != sws_output_frame->height;
+    }
+
     int
     set_frame(AVFrame *frame, AVBufferRef *hw_frames_ctx) override {
       this->frame = frame;
@@ -258,6 +443,12 @@ namespace video {
     avcodec_frame_t sws_output_frame;
     sws_t sws;
 
+    // Linesize alignment of the buffers from the pool
+    static constexpr int BUFFER_ALIGN = 64;
+
+    // Buffers replacing those still shared with other sessions
+    buffer_pool_t buffer_pool;
+
     // Offset of input image to output frame in pixels
     int offsetW;
     int offsetH;
@@ -274,13 +465,14 @@ namespace video {
     NO_RC_BUF_LIMIT = 1 << 7,  ///< Don't set rc_buffer_size
     REF_FRAMES_INVALIDATION = 1 << 8,  ///< Support reference frames invalidation
     ALWAYS_REPROBE = 1 << 9,  ///< This is an encoder of last resort and we want to aggressively probe for a better one
+    DYNAMIC_BITRATE = 1 << 10,  ///< The bitrate can be changed without recreating the encoder
   };
 
   class avcodec_encode_session_t: public encode_session_t {
   public:
     avcodec_encode_session_t() = default;
-    avcodec_encode_session_t(avcodec_ctx_t &&avcodec_ctx, std::unique_ptr<platf::avcodec_encode_device_t> encode_device, int inject):
-        avcodec_ctx { std::move(avcodec_ctx) }, device { std::move(encode_device) }, inject { inject } {}
+    avcodec_encode_session_t(avcodec_ctx_t &&avcodec_ctx, std::unique_ptr<platf::avcodec_encode_device_t> encode_device, int inject, bool dynamic_bitrate):
+        avcodec_ctx { std::move(avcodec_ctx) }, device { std::move(encode_device) }, inject { inject }, dynamic_bitrate { dynamic_bitrate } {}
 
     avcodec_encode_session_t(avcodec_encode_session_t &&other) noexcept = default;
     ~avcodec_encode_session_t() {
@@ -294,11 +486,11 @@ namespace video {
     operator=(avcodec_encode_session_t &&other) {
       device = std::move(other.device);
       avcodec_ctx = std::move(other.avcodec_ctx);
-      replacements = std::move(other.replacements);
       sps = std::move(other.sps);
       vps = std::move(other.vps);
 
       inject = other.inject;
+      dynamic_bitrate = other.dynamic_bitrate;
 
       return *this;
     }
@@ -333,16 +525,42 @@ namespace video {
       request_idr_frame();
     }
 
+    bool
+    set_bitrate(int bitrate) override {
+      if (!dynamic_bitrate || !avcodec_ctx || avcodec_ctx->rc_max_rate <= 0) {
+        return false;
+      }
+
+      // The encoder picks up the new rate control settings with the next frame. They're scaled
+      // from the current ones, so the encoder keeps the rate control mode it was set up with.
+      auto &ctx = avcodec_ctx;
+      auto new_rate = (int64_t) bitrate * 1000;
+      auto old_rate = ctx->rc_max_rate;
+
+      ctx->bit_rate = new_rate - (old_rate - ctx->bit_rate);
+      ctx->rc_max_rate = new_rate;
+      if (ctx->rc_min_rate) {
+        ctx->rc_min_rate = new_rate;
+      }
+      if (ctx->rc_buffer_size) {
+        ctx->rc_buffer_size = (int) (ctx->rc_buffer_size * new_rate / old_rate);
+      }
+
+      return true;
+    }
+
     avcodec_ctx_t avcodec_ctx;
     std::unique_ptr<platf::avcodec_encode_device_t> device;
 
-    std::vector<packet_raw_t::replace_t> replacements;
-
+    // Parameter sets rewritten by cbs, replaced in every IDR frame
     cbs::nal_t sps;
     cbs::nal_t vps;
 
     // inject sps/vps data into idr pictures
     int inject;
+
+    // The encoder applies changes to its bitrate while running
+    bool dynamic_bitrate = false;
   };
 
   class nvenc_encode_session_t: public encode_session_t {
@@ -376,6 +594,13 @@ namespace video {
       }
     }
 
+    bool
+    set_bitrate(int bitrate) override {
+      if (!device || !device->nvenc) return false;
+
+      return device->nvenc->set_bitrate(bitrate);
+    }
+
     nvenc::nvenc_encoded_frame
     encode_frame(uint64_t frame_index) {
       if (!device || !device->nvenc) return {};
@@ -393,8 +618,11 @@ namespace video {
   struct sync_session_ctx_t {
     safe::signal_t *join_event;
     safe::mail_raw_t::event_t<bool> shutdown_event;
-    safe::mail_raw_t::queue_t<packet_t> packets;
+    frame_queue_t *packets;
     safe::mail_raw_t::event_t<bool> idr_events;
+    safe::mail_raw_t::event_t<std::pair<int64_t, int64_t>> invalidate_ref_frames_events;
+    safe::mail_raw_t::event_t<int> bitrate_events;
+    safe::mail_raw_t::event_t<bool> fixed_bitrate_events;
     safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
 
@@ -406,6 +634,14 @@ namespace video {
   struct sync_session_t {
     sync_session_ctx_t *ctx;
     std::unique_ptr<encode_session_t> session;
+
+    // Set once the encoder turned out not to change its bitrate while streaming
+    bool fixed_bitrate = false;
+
+    // Sessions encode concurrently, so each of them keeps its own measurements
+    logging::time_delta_periodic_logger capture_latency_logger { debug, "Video: capture to encode latency" };
+    logging::time_delta_periodic_logger convert_latency_logger { debug, "Video: convert latency" };
+    logging::time_delta_periodic_logger encode_latency_logger { debug, "Video: encode latency" };
   };
 
   using encode_session_ctx_queue_t = safe::queue_t<sync_session_ctx_t>;
@@ -429,6 +665,41 @@ namespace video {
     encode_session_ctx_queue_t encode_session_ctx_queue { 30 };
   };
 
+  /**
+   * @brief A session's view of an encoded frame that is shared with other sessions.
+   */
+  struct packet_raw_shared: packet_raw_t {
+    packet_raw_shared(std::shared_ptr<packet_raw_t> packet, int64_t frame_offset, void *channel_data):
+        packet { std::move(packet) }, frame_offset { frame_offset } {
+      this->channel_data = channel_data;
+      after_ref_frame_invalidation = this->packet->after_ref_frame_invalidation;
+      frame_timestamp = this->packet->frame_timestamp;
+    }
+
+    bool
+    is_idr() override {
+      return packet->is_idr();
+    }
+
+    int64_t
+    frame_index() override {
+      return packet->frame_index() - frame_offset;
+    }
+
+    uint8_t *
+    data() override {
+      return packet->data();
+    }
+
+    size_t
+    data_size() override {
+      return packet->data_size();
+    }
+
+    std::shared_ptr<packet_raw_t> packet;
+    int64_t frame_offset;
+  };
+
   int
   start_capture_sync(capture_thread_sync_ctx_t &ctx);
   void
@@ -442,6 +713,9 @@ namespace video {
   auto capture_thread_async = safe::make_shared<capture_thread_async_ctx_t>(start_capture_async, end_capture_async);
   auto capture_thread_sync = safe::make_shared<capture_thread_sync_ctx_t>(start_capture_sync, end_capture_sync);
 
+  // The running shared encoders, which sessions with the same stream configuration join
+  sync_util::sync_t<std::vector<std::shared_ptr<shared_encode_ctx_t>>> shared_encodes;
+
 #ifdef _WIN32
   encoder_t nvenc {
     "nvenc"sv,
@@ -484,7 +758,7 @@ namespace video {
       std::nullopt,  // QP rate control fallback
       "h264_nvenc"s,
     },
-    PARALLEL_ENCODING | REF_FRAMES_INVALIDATION  // flags
+    PARALLEL_ENCODING | REF_FRAMES_INVALIDATION | DYNAMIC_BITRATE  // flags
   };
 #elif !defined(__APPLE__)
   encoder_t nvenc {
@@ -570,7 +844,7 @@ namespace video {
       std::nullopt,  // QP rate control fallback
       "h264_nvenc"s,
     },
-    PARALLEL_ENCODING
+    PARALLEL_ENCODING | DYNAMIC_BITRATE
   };
 #endif
 
@@ -653,7 +927,7 @@ namespace video {
       std::nullopt,  // QP rate control fallback
       "h264_qsv"s,
     },
-    PARALLEL_ENCODING | CBR_WITH_VBR | RELAXED_COMPLIANCE | NO_RC_BUF_LIMIT
+    PARALLEL_ENCODING | CBR_WITH_VBR | RELAXED_COMPLIANCE | NO_RC_BUF_LIMIT | DYNAMIC_BITRATE
   };
 
   encoder_t amdvce {
@@ -792,7 +1066,7 @@ namespace video {
       std::nullopt,  // QP rate control fallback
       "libx264"s,
     },
-    H264_ONLY | PARALLEL_ENCODING | ALWAYS_REPROBE
+    H264_ONLY | PARALLEL_ENCODING | ALWAYS_REPROBE | DYNAMIC_BITRATE
   };
 
 #ifdef __linux__
@@ -1138,6 +1412,7 @@ namespace video {
           // trim allocated but unused portion of the pool based on timeouts
           trim_imgs();
           img_out->frame_timestamp.reset();
+          img_out->conversions.reset();
           return true;
         }
         else {
@@ -1155,6 +1430,11 @@ namespace video {
       bool artificial_reinit = false;
 
       auto push_captured_image_callback = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) -> bool {
+        // Encoders with the same output format convert the image only once
+        if (frame_captured && capture_ctxs.size() > 1 && !img->conversions) {
+          img->conversions = std::make_shared<conversion_cache_t>();
+        }
+
         KITTY_WHILE_LOOP(auto capture_ctx = std::begin(capture_ctxs), capture_ctx != std::end(capture_ctxs), {
           if (!capture_ctx->images->running()) {
             capture_ctx = capture_ctxs.erase(capture_ctx);
@@ -1267,7 +1547,7 @@ namespace video {
   }
 
   int
-  encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, frame_queue_t &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     auto &frame = session.device->frame;
     frame->pts = frame_nr;
 
@@ -1316,33 +1596,31 @@ namespace video {
 
           sps = std::move(hevc.sps);
           vps = std::move(hevc.vps);
-
-          session.replacements.emplace_back(
-            std::string_view((char *) std::begin(vps.old), vps.old.size()),
-            std::string_view((char *) std::begin(vps._new), vps._new.size()));
         }
 
         session.inject = 0;
+      }
 
-        session.replacements.emplace_back(
-          std::string_view((char *) std::begin(sps.old), sps.old.size()),
-          std::string_view((char *) std::begin(sps._new), sps._new.size()));
+      // Rewrite the parameter sets here, so the packet payload is final by the time it's sent
+      if (av_packet->flags & AV_PKT_FLAG_KEY && (sps.old.size() || vps.old.size())) {
+        if (cbs::replace_parameter_sets(av_packet, ctx->codec_id, { &vps, &sps })) {
+          return -1;
+        }
       }
 
       if (av_packet && av_packet->pts == frame_nr) {
         packet->frame_timestamp = frame_timestamp;
       }
 
-      packet->replacements = &session.replacements;
       packet->channel_data = channel_data;
-      packets->raise(std::move(packet));
+      packets.raise(std::move(packet));
     }
 
     return 0;
   }
 
   int
-  encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, frame_queue_t &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     auto encoded_frame = session.encode_frame(frame_nr);
     if (encoded_frame.data.empty()) {
       BOOST_LOG(error) << "NvENC returned empty packet";
@@ -1357,13 +1635,13 @@ namespace video {
     packet->channel_data = channel_data;
     packet->after_ref_frame_invalidation = encoded_frame.after_ref_frame_invalidation;
     packet->frame_timestamp = frame_timestamp;
-    packets->raise(std::move(packet));
+    packets.raise(std::move(packet));
 
     return 0;
   }
 
   int
-  encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  encode(int64_t frame_nr, encode_session_t &session, frame_queue_t &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     if (auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(&session)) {
       return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp);
     }
@@ -1709,7 +1987,10 @@ namespace video {
       std::move(encode_device_final),
 
       // 0 ==> don't inject, 1 ==> inject for h264, 2 ==> inject for hevc
-      config.videoFormat <= 1 ? (1 - (int) video_format[encoder_t::VUI_PARAMETERS]) * (1 + config.videoFormat) : 0);
+      config.videoFormat <= 1 ? (1 - (int) video_format[encoder_t::VUI_PARAMETERS]) * (1 + config.videoFormat) : 0,
+
+      // Only a constant bitrate can be changed, and libx264 is the only software encoder that reconfigures itself
+      (encoder.flags & DYNAMIC_BITRATE) && video_format[encoder_t::CBR] && (hardware || config.videoFormat == 0));
 
     return session;
   }
@@ -1759,30 +2040,144 @@ namespace video {
     return nullptr;
   }
 
+  /**
+   * @brief Change the bitrate of a running encode session.
+   * @param session The encode session.
+   * @param bitrate The new bitrate in Kbps.
+   * @return `false` if the encoder can't change its bitrate while streaming.
+   */
+  bool
+  change_bitrate(encode_session_t &session, int bitrate) {
+    if (!session.set_bitrate(bitrate)) {
+      BOOST_LOG(warning) << "Encoder can't change its bitrate while streaming, disabling adaptive bitrate"sv;
+      return false;
+    }
+
+    BOOST_LOG(debug) << "Encoder bitrate changed to "sv << bitrate << " Kbps"sv;
+    return true;
+  }
+
+  encode_requests_t
+  merge_requests(shared_encode_ctx_t &ctx) {
+    encode_requests_t requests { false, std::nullopt, ctx.bitrate };
+
+    auto lg = ctx.subscribers.lock();
+    if (!ctx.subscribers->empty()) {
+      requests.bitrate = std::numeric_limits<int>::max();
+    }
+
+    for (auto &subscriber : *ctx.subscribers) {
+      if (subscriber->idr_events->peek()) {
+        requests.idr = true;
+        subscriber->idr_events->pop();
+      }
+
+      while (subscriber->invalidate_ref_frames_events->peek()) {
+        auto frames = subscriber->invalidate_ref_frames_events->pop(0ms);
+
+        // Before its first key frame, the session has no frames to invalidate
+        if (!frames || !subscriber->frame_offset) {
+          continue;
+        }
+
+        auto first_frame = frames->first + *subscriber->frame_offset;
+        auto last_frame = frames->second + *subscriber->frame_offset;
+        if (requests.invalidate_ref_frames) {
+          first_frame = std::min(first_frame, requests.invalidate_ref_frames->first);
+          last_frame = std::max(last_frame, requests.invalidate_ref_frames->second);
+        }
+        requests.invalidate_ref_frames = std::make_pair(first_frame, last_frame);
+      }
+
+      if (subscriber->bitrate_events->peek()) {
+        subscriber->bitrate = *subscriber->bitrate_events->pop();
+      }
+      requests.bitrate = std::min(requests.bitrate, subscriber->bitrate);
+    }
+
+    return requests;
+  }
+
+  void
+  fan_out(shared_encode_ctx_t &ctx, packet_t &&packet) {
+    std::shared_ptr<packet_raw_t> shared_packet = std::move(packet);
+
+    auto lg = ctx.subscribers.lock();
+    for (auto &subscriber : *ctx.subscribers) {
+      if (!subscriber->frame_offset) {
+        // A session that just joined waits for the key frame it asked for
+        if (!shared_packet->is_idr()) {
+          continue;
+        }
+
+        subscriber->frame_offset = shared_packet->frame_index() - 1;
+      }
+
+      subscriber->packets->raise(std::make_unique<packet_raw_shared>(shared_packet, *subscriber->frame_offset, subscriber->channel_data));
+    }
+  }
+
+  /**
+   * @brief Let all sessions of a shared encoder know the state of the display being encoded.
+   * @param ctx The shared encoder.
+   * @param touch_port The area of the display that is streamed.
+   * @param hdr_info The HDR state of the display.
+   */
+  void
+  publish_display_state(shared_encode_ctx_t &ctx, const input::touch_port_t &touch_port, const hdr_info_raw_t &hdr_info) {
+    auto lg = ctx.subscribers.lock();
+    ctx.touch_port = touch_port;
+    ctx.hdr_info = hdr_info;
+
+    for (auto &subscriber : *ctx.subscribers) {
+      subscriber->touch_port_events->raise(touch_port);
+      subscriber->hdr_events->raise(std::make_unique<hdr_info_raw_t>(hdr_info));
+    }
+  }
+
+  /**
+   * @brief Let all sessions of a shared encoder know that it can't change its bitrate, so they stop asking.
+   * @param ctx The shared encoder.
+   */
+  void
+  publish_fixed_bitrate(shared_encode_ctx_t &ctx) {
+    auto lg = ctx.subscribers.lock();
+    ctx.fixed_bitrate = true;
+
+    for (auto &subscriber : *ctx.subscribers) {
+      subscriber->fixed_bitrate_events->raise(true);
+    }
+  }
+
   void
   encode_run(
     int &frame_nr,  // Store progress of the frame number
-    safe::mail_t mail,
-    img_event_t images,
-    config_t config,
+    shared_encode_ctx_t &ctx,
     std::shared_ptr<platf::display_t> disp,
     std::unique_ptr<platf::encode_device_t> encode_device,
     safe::signal_t &reinit_event,
-    const encoder_t &encoder,
-    void *channel_data) {
+    const encoder_t &encoder) {
+    auto &config = ctx.config;
+    auto &images = ctx.images;
+
     auto session = make_encode_session(disp.get(), encoder, config, disp->width, disp->height, std::move(encode_device));
     if (!session) {
       return;
     }
 
+    // A new encode session starts out at the configured bitrate
+    ctx.bitrate = config.bitrate;
+
     // set minimum frame time, avoiding violation of client-requested target framerate
     auto minimum_frame_time = std::chrono::milliseconds(1000 / std::min(config.framerate, (config::video.min_fps_factor * 10)));
     BOOST_LOG(debug) << "Minimum frame time set to "sv << minimum_frame_time.count() << "ms, based on min fps factor of "sv << config::video.min_fps_factor << "."sv;
 
-    auto shutdown_event = mail->event<bool>(mail::shutdown);
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
-    auto idr_events = mail->event<bool>(mail::idr);
-    auto invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+    // Holds the output of each encode() until it's sent to the sessions
+    frame_queue_t encoded { 32, std::numeric_limits<std::size_t>::max(), frame_queue_t::clock::duration::max(), {} };
+
+    logging::time_delta_periodic_logger capture_latency_logger(debug, "Video: capture to encode latency");
+    logging::time_delta_periodic_logger convert_latency_logger(debug, "Video: convert latency");
+    logging::time_delta_periodic_logger encode_latency_logger(debug, "Video: encode latency");
 
     {
       // Load a dummy image into the AVFrame to ensure we have something to encode
@@ -1796,47 +2191,60 @@ namespace video {
     }
 
     while (true) {
-      if (shutdown_event->peek() || reinit_event.peek() || !images->running()) {
+      if (reinit_event.peek() || !images->running()) {
         break;
       }
 
-      bool requested_idr_frame = false;
+      auto requests = merge_requests(ctx);
 
-      while (invalidate_ref_frames_events->peek()) {
-        if (auto frames = invalidate_ref_frames_events->pop(0ms)) {
-          session->invalidate_ref_frames(frames->first, frames->second);
-        }
+      if (requests.invalidate_ref_frames) {
+        session->invalidate_ref_frames(requests.invalidate_ref_frames->first, requests.invalidate_ref_frames->second);
       }
 
-      if (idr_events->peek()) {
-        requested_idr_frame = true;
-        idr_events->pop();
+      if (requests.bitrate != ctx.bitrate && !ctx.fixed_bitrate) {
+        ctx.bitrate = requests.bitrate;
+        if (!change_bitrate(*session, requests.bitrate)) {
+          publish_fixed_bitrate(ctx);
+        }
       }
 
-      if (requested_idr_frame) {
+      if (requests.idr) {
         session->request_idr_frame();
       }
 
       std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
 
       // Encode at a minimum FPS to avoid image quality issues with static content
-      if (!requested_idr_frame || images->peek()) {
+      if (!requests.idr || images->peek()) {
         if (auto img = images->pop(minimum_frame_time)) {
           frame_timestamp = img->frame_timestamp;
+          if (frame_timestamp) {
+            capture_latency_logger.first_point(*frame_timestamp);
+            capture_latency_logger.second_point_now_and_log();
+          }
+
+          convert_latency_logger.first_point_now();
           if (session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             return;
           }
+          convert_latency_logger.second_point_now_and_log();
         }
         else if (!images->running()) {
           break;
         }
       }
 
-      if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp)) {
+      encode_latency_logger.first_point_now();
+      if (encode(frame_nr++, *session, encoded, nullptr, frame_timestamp)) {
         BOOST_LOG(error) << "Could not encode video packet"sv;
         return;
       }
+      encode_latency_logger.second_point_now_and_log();
+
+      while (encoded.peek()) {
+        fan_out(ctx, encoded.pop());
+      }
 
       session->request_normal_frame();
     }
@@ -1992,6 +2400,10 @@ namespace video {
       synced_sessions.emplace_back(std::move(*synced_session));
     }
 
+    // Every session but the first encodes on a thread of its own, concurrently with the first one
+    std::unique_ptr<thread_pool_util::ThreadPool> encode_pool;
+    std::size_t encode_pool_threads = 0;
+
     auto ec = platf::capture_e::ok;
     while (encode_session_ctx_queue.running()) {
       auto push_captured_image_callback = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) -> bool {
@@ -2030,34 +2442,90 @@ namespace video {
             continue;
           }
 
+          if (ctx->bitrate_events->peek()) {
+            auto bitrate = *ctx->bitrate_events->pop();
+            if (!pos->fixed_bitrate && !change_bitrate(*pos->session, bitrate)) {
+              pos->fixed_bitrate = true;
+              ctx->fixed_bitrate_events->raise(true);
+            }
+          }
+
+          while (ctx->invalidate_ref_frames_events->peek()) {
+            if (auto frames = ctx->invalidate_ref_frames_events->pop(0ms)) {
+              pos->session->invalidate_ref_frames(frames->first, frames->second);
+            }
+          }
+
           if (ctx->idr_events->peek()) {
             pos->session->request_idr_frame();
             ctx->idr_events->pop();
           }
 
-          if (frame_captured && pos->session->convert(*img)) {
-            BOOST_LOG(error) << "Could not convert image"sv;
-            ctx->shutdown_event->raise(true);
+          ++pos;
+        })
 
-            continue;
-          }
+        // Sessions with the same output format convert the image only once
+        if (frame_captured && synced_sessions.size() > 1 && !img->conversions) {
+          img->conversions = std::make_shared<conversion_cache_t>();
+        }
+
+        std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+        if (img) {
+          frame_timestamp = img->frame_timestamp;
+        }
 
-          std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
-          if (img) {
-            frame_timestamp = img->frame_timestamp;
+        auto encode_synced_session = [&](sync_session_t &synced_session) {
+          auto ctx = synced_session.ctx;
+
+          if (frame_captured) {
+            if (frame_timestamp) {
+              synced_session.capture_latency_logger.first_point(*frame_timestamp);
+              synced_session.capture_latency_logger.second_point_now_and_log();
+            }
+
+            synced_session.convert_latency_logger.first_point_now();
+            if (synced_session.session->convert(*img)) {
+              BOOST_LOG(error) << "Could not convert image"sv;
+              ctx->shutdown_event->raise(true);
+
+              return;
+            }
+            synced_session.convert_latency_logger.second_point_now_and_log();
           }
 
-          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp)) {
+          synced_session.encode_latency_logger.first_point_now();
+          if (encode(ctx->frame_nr++, *synced_session.session, *ctx->packets, ctx->channel_data, frame_timestamp)) {
             BOOST_LOG(error) << "Could not encode video packet"sv;
             ctx->shutdown_event->raise(true);
 
-            continue;
+            return;
           }
+          synced_session.encode_latency_logger.second_point_now_and_log();
 
-          pos->session->request_normal_frame();
+          synced_session.session->request_normal_frame();
+        };
 
-          ++pos;
-        })
+        if (synced_sessions.size() - 1 > encode_pool_threads) {
+          // Replacing the pool joins the threads of the old one
+          encode_pool_threads = synced_sessions.size() - 1;
+          encode_pool = std::make_unique<thread_pool_util::ThreadPool>((int) encode_pool_threads);
+        }
+
+        std::vector<std::future<void>> encodes;
+        for (auto pos = std::next(std::begin(synced_sessions)); pos != std::end(synced_sessions); ++pos) {
+          encodes.emplace_back(encode_pool->push([&encode_synced_session, &synced_session = *pos]() {
+            platf::adjust_thread_priority(platf::thread_priority_e::high);
+            encode_synced_session(synced_session);
+          }));
+        }
+
+        // The first session doesn't wait for the others
+        encode_synced_session(synced_sessions.front());
+
+        // The image is reused for the next capture, so the other sessions must be done with it
+        for (auto &encode : encodes) {
+          encode.wait();
+        }
 
         if (switch_display_event->peek()) {
           ec = platf::capture_e::reinit;
@@ -2070,6 +2538,7 @@ namespace video {
       auto pull_free_image_callback = [&img](std::shared_ptr<platf::img_t> &img_out) -> bool {
         img_out = img;
         img_out->frame_timestamp.reset();
+        img_out->conversions.reset();
         return true;
       };
 
@@ -2116,17 +2585,25 @@ namespace video {
     while (encode_run_sync(synced_session_ctxs, ctx, display_names, display_p) == encode_e::reinit) {}
   }
 
+  /**
+   * @brief Capture and encode for all sessions of a shared encoder, until the last of them leaves.
+   * @param ctx The shared encoder.
+   */
   void
-  capture_async(
-    safe::mail_t mail,
-    config_t &config,
-    void *channel_data) {
-    auto shutdown_event = mail->event<bool>(mail::shutdown);
-
-    auto images = std::make_shared<img_event_t::element_type>();
+  shared_encode_thread(std::shared_ptr<shared_encode_ctx_t> ctx) {
     auto lg = util::fail_guard([&]() {
-      images->stop();
-      shutdown_event->raise(true);
+      // Sessions that start now need a new encoder
+      {
+        auto lg = shared_encodes.lock();
+        std::erase(*shared_encodes, ctx);
+      }
+
+      ctx->images->stop();
+
+      auto lg = ctx->subscribers.lock();
+      for (auto &subscriber : *ctx->subscribers) {
+        subscriber->shutdown_event->raise(true);
+      }
     });
 
     auto ref = capture_thread_async.ref();
@@ -2134,7 +2611,7 @@ namespace video {
       return;
     }
 
-    ref->capture_ctx_queue->raise(capture_ctx_t { images, config });
+    ref->capture_ctx_queue->raise(capture_ctx_t { ctx->images, ctx->config });
 
     if (!ref->capture_ctx_queue->running()) {
       return;
@@ -2142,13 +2619,10 @@ namespace video {
 
     int frame_nr = 1;
 
-    auto touch_port_event = mail->event<input::touch_port_t>(mail::touch_port);
-    auto hdr_event = mail->event<hdr_info_t>(mail::hdr);
-
     // Encoding takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
-    while (!shutdown_event->peek() && images->running()) {
+    while (ctx->images->running()) {
       // Wait for the main capture event when the display is being reinitialized
       if (ref->reinit_event.peek()) {
         std::this_thread::sleep_for(20ms);
@@ -2167,46 +2641,146 @@ namespace video {
 
       auto &encoder = *chosen_encoder;
 
-      auto encode_device = make_encode_device(*display, encoder, config);
+      auto encode_device = make_encode_device(*display, encoder, ctx->config);
       if (!encode_device) {
         return;
       }
 
-      // absolute mouse coordinates require that the dimensions of the screen are known
-      touch_port_event->raise(make_port(display.get(), config));
-
-      // Update client with our current HDR display state
-      hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
+      // Update clients with our current HDR display state
+      hdr_info_raw_t hdr_info { false };
       if (colorspace_is_hdr(encode_device->colorspace)) {
-        if (display->get_hdr_metadata(hdr_info->metadata)) {
-          hdr_info->enabled = true;
+        if (display->get_hdr_metadata(hdr_info.metadata)) {
+          hdr_info.enabled = true;
         }
         else {
           BOOST_LOG(error) << "Couldn't get display hdr metadata when colorspace selection indicates it should have one";
         }
       }
-      hdr_event->raise(std::move(hdr_info));
+
+      // absolute mouse coordinates require that the dimensions of the screen are known
+      publish_display_state(*ctx, make_port(display.get(), ctx->config), hdr_info);
 
       encode_run(
         frame_nr,
-        mail, images,
-        config, display,
+        *ctx, display,
         std::move(encode_device),
-        ref->reinit_event, *ref->encoder_p,
-        channel_data);
+        ref->reinit_event, *ref->encoder_p);
+    }
+  }
+
+  /**
+   * @brief Join the shared encoder for a stream configuration, starting one if there's none yet.
+   * @param config The stream configuration of the session.
+   * @param subscriber The session.
+   * @return The shared encoder.
+   */
+  std::shared_ptr<shared_encode_ctx_t>
+  subscribe(const config_t &config, std::shared_ptr<encode_subscriber_t> subscriber) {
+    std::shared_ptr<shared_encode_ctx_t> ctx;
+
+    auto lg = shared_encodes.lock();
+    auto it = std::find_if(std::begin(*shared_encodes), std::end(*shared_encodes), [&config](const auto &ctx) {
+      return ctx->config == config;
+    });
+
+    if (it != std::end(*shared_encodes)) {
+      ctx = *it;
+      BOOST_LOG(info) << "Sharing the encoder of a session with the same stream configuration"sv;
+    }
+    else {
+      ctx = std::make_shared<shared_encode_ctx_t>(config);
+      shared_encodes->emplace_back(ctx);
     }
+
+    {
+      auto lg = ctx->subscribers.lock();
+      ctx->subscribers->emplace_back(subscriber);
+
+      // The encoder may have found the display already
+      if (ctx->touch_port) {
+        subscriber->touch_port_events->raise(*ctx->touch_port);
+      }
+      if (ctx->hdr_info) {
+        subscriber->hdr_events->raise(std::make_unique<hdr_info_raw_t>(*ctx->hdr_info));
+      }
+      if (ctx->fixed_bitrate) {
+        subscriber->fixed_bitrate_events->raise(true);
+      }
+    }
+
+    if (!ctx->thread.joinable()) {
+      ctx->thread = std::thread { shared_encode_thread, ctx };
+    }
+
+    return ctx;
+  }
+
+  void
+  unsubscribe(shared_encode_ctx_t &ctx, const std::shared_ptr<encode_subscriber_t> &subscriber) {
+    bool last;
+    {
+      auto lg = shared_encodes.lock();
+      auto lg_subscribers = ctx.subscribers.lock();
+
+      std::erase(*ctx.subscribers, subscriber);
+      last = ctx.subscribers->empty();
+
+      if (last) {
+        std::erase_if(*shared_encodes, [&ctx](const auto &shared_ctx) {
+          return shared_ctx.get() == &ctx;
+        });
+        ctx.images->stop();
+      }
+    }
+
+    if (last) {
+      ctx.thread.join();
+    }
+  }
+
+  void
+  capture_async(
+    safe::mail_t mail,
+    config_t &config,
+    frame_queue_t &packets,
+    void *channel_data) {
+    auto shutdown_event = mail->event<bool>(mail::shutdown);
+
+    auto subscriber = std::make_shared<encode_subscriber_t>(encode_subscriber_t {
+      shutdown_event,
+      &packets,
+      mail->event<bool>(mail::idr),
+      mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames),
+      mail->event<int>(mail::bitrate),
+      mail->event<bool>(mail::fixed_bitrate),
+      mail->event<hdr_info_t>(mail::hdr),
+      mail->event<input::touch_port_t>(mail::touch_port),
+      channel_data,
+      std::nullopt,
+      config.bitrate,
+    });
+
+    auto ctx = subscribe(config, subscriber);
+    auto lg = util::fail_guard([&]() {
+      unsubscribe(*ctx, subscriber);
+      shutdown_event->raise(true);
+    });
+
+    // Capture and encoding take place on the shared encoder's thread
+    shutdown_event->view();
   }
 
   void
   capture(
     safe::mail_t mail,
     config_t config,
+    frame_queue_t &packets,
     void *channel_data) {
     auto idr_events = mail->event<bool>(mail::idr);
 
     idr_events->raise(true);
     if (chosen_encoder->flags & PARALLEL_ENCODING) {
-      capture_async(std::move(mail), config, channel_data);
+      capture_async(std::move(mail), config, packets, channel_data);
     }
     else {
       safe::signal_t join_event;
@@ -2214,8 +2788,11 @@ namespace video {
       ref->encode_session_ctx_queue.raise(sync_session_ctx_t {
         &join_event,
         mail->event<bool>(mail::shutdown),
-        mail::man->queue<packet_t>(mail::video_packets),
+        &packets,
         std::move(idr_events),
+        mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames),
+        mail->event<int>(mail::bitrate),
+        mail->event<bool>(mail::fixed_bitrate),
         mail->event<hdr_info_t>(mail::hdr),
         mail->event<input::touch_port_t>(mail::touch_port),
         config,
@@ -2254,14 +2831,14 @@ namespace video {
 
     session->request_idr_frame();
 
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
-    while (!packets->peek()) {
+    frame_queue_t packets { 32, std::numeric_limits<std::size_t>::max(), frame_queue_t::clock::duration::max(), {} };
+    while (!packets.peek()) {
       if (encode(1, *session, packets, nullptr, {})) {
         return -1;
       }
     }
 
-    auto packet = packets->pop();
+    auto packet = packets.pop();
     if (!packet->is_idr()) {
       BOOST_LOG(error) << "First packet type is not an IDR frame"sv;
 
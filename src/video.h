@@ -4,8 +4,13 @@
  */
 #pragma once
 
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include "input.h"
 #include "platform/common.h"
+#include "sync.h"
 #include "thread_safe.h"
 #include "video_colorspace.h"
 
@@ -164,6 +169,14 @@ namespace video {
 
     virtual void
     invalidate_ref_frames(int64_t first_frame, int64_t last_frame) = 0;
+
+    /**
+     * @brief Change the bitrate of the running encoder.
+     * @param bitrate The new bitrate in Kbps.
+     * @return `true` if the encoder applies the new bitrate, `false` if it can't change bitrate without being recreated.
+     */
+    virtual bool
+    set_bitrate(int bitrate) = 0;
   };
 
   // encoders
@@ -201,17 +214,6 @@ namespace video {
     virtual size_t
     data_size() = 0;
 
-    struct replace_t {
-      std::string_view old;
-      std::string_view _new;
-
-      KITTY_DEFAULT_CONSTR_MOVE(replace_t)
-
-      replace_t(std::string_view old, std::string_view _new) noexcept:
-          old { std::move(old) }, _new { std::move(_new) } {}
-    };
-
-    std::vector<replace_t> *replacements = nullptr;
     void *channel_data = nullptr;
     bool after_ref_frame_invalidation = false;
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
@@ -312,16 +314,114 @@ namespace video {
     /* Encoding color depth (bit depth): 0 - 8-bit, 1 - 10-bit
        HDR encoding activates when color depth is higher than 8-bit and the display which is being captured is operating in HDR mode */
     int dynamicRange;
+
+    bool
+    operator==(const config_t &) const = default;
   };
 
   extern int active_hevc_mode;
   extern int active_av1_mode;
   extern bool last_encoder_probe_supported_ref_frames_invalidation;
 
+  class frame_queue_t;
+
+  /**
+   * @brief A session receiving the frames of a shared encoder.
+   */
+  struct encode_subscriber_t {
+    safe::mail_raw_t::event_t<bool> shutdown_event;
+    frame_queue_t *packets;
+    safe::mail_raw_t::event_t<bool> idr_events;
+    safe::mail_raw_t::event_t<std::pair<int64_t, int64_t>> invalidate_ref_frames_events;
+    safe::mail_raw_t::event_t<int> bitrate_events;
+    safe::mail_raw_t::event_t<bool> fixed_bitrate_events;
+    safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
+    safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
+
+    void *channel_data;
+
+    // The session's frame indices are the encoder's minus this offset, so its first frame is 1.
+    // It's set by the first key frame the session receives, the frames before it are of no use to the client.
+    std::optional<int64_t> frame_offset;
+
+    // The bitrate the session asked for
+    int bitrate;
+  };
+
+  /**
+   * @brief An encoder whose frames are sent to every session with the same stream configuration.
+   */
+  struct shared_encode_ctx_t {
+    explicit shared_encode_ctx_t(const config_t &config):
+        config { config },
+        images { std::make_shared<img_event_t::element_type>() },
+        bitrate { config.bitrate } {}
+
+    config_t config;
+    img_event_t images;
+    std::thread thread;
+
+    sync_util::sync_t<std::vector<std::shared_ptr<encode_subscriber_t>>> subscribers;
+
+    // The state of the display, for sessions that subscribe later
+    std::optional<input::touch_port_t> touch_port;
+    std::optional<hdr_info_raw_t> hdr_info;
+
+    // The bitrate the encoder is currently using
+    int bitrate;
+
+    // Set once the encoder turned out not to change its bitrate while streaming
+    bool fixed_bitrate = false;
+  };
+
+  /**
+   * @brief The requests of all sessions of a shared encoder, merged.
+   */
+  struct encode_requests_t {
+    bool idr;
+    std::optional<std::pair<int64_t, int64_t>> invalidate_ref_frames;
+    int bitrate;
+  };
+
+  /**
+   * @brief Collect the requests of all sessions of a shared encoder.
+   * @details A key frame for one session is a key frame for all of them. Invalidated frames are translated
+   * to the frame indices of the encoder, and combined into a single range. The encoder uses the lowest
+   * bitrate any of the sessions asked for, so the stream suits the most congested client.
+   * @param ctx The shared encoder.
+   * @return The merged requests.
+   */
+  encode_requests_t
+  merge_requests(shared_encode_ctx_t &ctx);
+
+  /**
+   * @brief Send an encoded frame to every session of a shared encoder.
+   * @param ctx The shared encoder.
+   * @param packet The encoded frame.
+   */
+  void
+  fan_out(shared_encode_ctx_t &ctx, packet_t &&packet);
+
+  /**
+   * @brief Leave a shared encoder, the last session to leave stops it.
+   * @param ctx The shared encoder.
+   * @param subscriber The session.
+   */
+  void
+  unsubscribe(shared_encode_ctx_t &ctx, const std::shared_ptr<encode_subscriber_t> &subscriber);
+
+  /**
+   * @brief Capture and encode video for a session until it shuts down.
+   * @param mail The session's mail.
+   * @param config The client's video settings.
+   * @param packets The session's queue, which receives the encoded frames.
+   * @param channel_data Passed along with every encoded frame.
+   */
   void
   capture(
     safe::mail_t mail,
     config_t config,
+    frame_queue_t &packets,
     void *channel_data);
 
   bool
@@ -0,0 +1,143 @@
+/**
+ * @file tests/unit/test_adaptive_bitrate.cpp
+ * @brief Test src/adaptive_bitrate.*
+ */
+#include <src/adaptive_bitrate.h>
+
+#include <tests/conftest.cpp>
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief Streams frames over a link of limited capacity, which loses what doesn't fit and backs up the sender.
+   */
+  struct congested_link_t {
+    // 60 FPS, with a loss report every 3rd frame like the client's 50 ms reports
+    static constexpr auto FRAME_INTERVAL = std::chrono::microseconds { 16667 };
+    static constexpr int FRAMES_PER_REPORT = 3;
+    static constexpr int PACKET_BITS = 1024 * 8;
+
+    int capacity;  // Kbps
+
+    adaptive_bitrate::clock::time_point now = adaptive_bitrate::clock::now();
+
+    int frames = 0;
+    int bitrate_changes = 0;
+
+    /**
+     * @brief Stream frames at the bitrate the controller picks.
+     * @param controller The bitrate controller of the stream.
+     * @param duration How long to stream.
+     */
+    void
+    stream(adaptive_bitrate::controller_t &controller, std::chrono::seconds duration) {
+      std::size_t lost_since_report = 0;
+      for (auto end = now + duration; now < end; now += FRAME_INTERVAL) {
+        auto bitrate = controller.bitrate();
+
+        // Packets beyond the capacity of the link are dropped
+        std::size_t packets = bitrate * 1000 / 60 / PACKET_BITS;
+        std::size_t delivered = std::min<std::size_t>(packets, capacity * 1000 / 60 / PACKET_BITS);
+        controller.sent(packets);
+        lost_since_report += packets - delivered;
+
+        // A link that can't keep up also backs up frames and send buffers
+        if (bitrate > capacity) {
+          controller.report_backlog(2);
+          controller.report_stalls(1);
+        }
+
+        if (++frames % FRAMES_PER_REPORT == 0) {
+          controller.report_loss(lost_since_report);
+          lost_since_report = 0;
+        }
+
+        if (controller.update(now)) {
+          ++bitrate_changes;
+        }
+      }
+    }
+  };
+}  // namespace
+
+TEST(AdaptiveBitrateTests, StartsAtClientBitrateTest) {
+  auto now = adaptive_bitrate::clock::now();
+  adaptive_bitrate::controller_t controller { 20000, now };
+
+  EXPECT_EQ(controller.bitrate(), 20000);
+  EXPECT_FALSE(controller.update(now + 1s));
+}
+
+TEST(AdaptiveBitrateTests, ClearLinkKeepsBitrateTest) {
+  congested_link_t link { 50000 };
+  adaptive_bitrate::controller_t controller { 20000, link.now };
+
+  link.stream(controller, 30s);
+
+  EXPECT_EQ(controller.bitrate(), 20000);
+  EXPECT_EQ(link.bitrate_changes, 0);
+}
+
+TEST(AdaptiveBitrateTests, CongestionLowersBitrateTest) {
+  congested_link_t link { 10000 };
+  adaptive_bitrate::controller_t controller { 20000, link.now };
+
+  // Cutting the bitrate in half takes a few steps
+  link.stream(controller, 5s);
+  EXPECT_LE(controller.bitrate(), 10000);
+
+  // Probing may briefly overshoot the link, but the stream stays close to its capacity
+  link.stream(controller, 30s);
+  EXPECT_LE(controller.bitrate(), 10000 + 20000 * 0.05);
+  EXPECT_GE(controller.bitrate(), 10000 * 0.7);
+}
+
+TEST(AdaptiveBitrateTests, NeverBelowMinimumTest) {
+  congested_link_t link { 100 };
+  adaptive_bitrate::controller_t controller { 20000, link.now };
+
+  link.stream(controller, 30s);
+
+  EXPECT_EQ(controller.bitrate(), (int) (20000 * adaptive_bitrate::MIN_FRACTION));
+}
+
+TEST(AdaptiveBitrateTests, RecoversWhenCongestionClearsTest) {
+  congested_link_t link { 5000 };
+  adaptive_bitrate::controller_t controller { 20000, link.now };
+
+  link.stream(controller, 10s);
+  ASSERT_LE(controller.bitrate(), 5000);
+
+  // Recovery is slower than backing off, but gets all the way back
+  link.capacity = 50000;
+  link.stream(controller, 3s);
+  EXPECT_LT(controller.bitrate(), 10000);
+
+  link.stream(controller, 30s);
+  EXPECT_EQ(controller.bitrate(), 20000);
+}
+
+TEST(AdaptiveBitrateTests, DisabledKeepsBitrateTest) {
+  congested_link_t link { 5000 };
+  adaptive_bitrate::controller_t controller { 20000, link.now };
+
+  // An encoder that can't change its bitrate disables the controller
+  controller.disable();
+  link.stream(controller, 10s);
+
+  EXPECT_EQ(controller.bitrate(), 20000);
+  EXPECT_EQ(link.bitrate_changes, 0);
+}
+
+TEST(AdaptiveBitrateTests, StallsCountAsCongestionTest) {
+  auto now = adaptive_bitrate::clock::now();
+  adaptive_bitrate::controller_t controller { 20000, now };
+
+  now += 1s;
+  controller.report_stalls(1);
+
+  auto bitrate = controller.update(now);
+  ASSERT_TRUE(bitrate);
+  EXPECT_LT(*bitrate, 20000);
+}
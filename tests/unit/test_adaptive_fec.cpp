@@ -0,0 +1,175 @@
+/**
+ * @file tests/unit/test_adaptive_fec.cpp
+ * @brief Test src/adaptive_fec.*
+ */
+#include <random>
+
+#include <src/adaptive_fec.h>
+
+#include <tests/conftest.cpp>
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @brief Streams frames over a link that loses packets at random, and reports loss like a client would.
+   */
+  struct lossy_link_t {
+    // 60 FPS, with a loss report every 3rd frame like the client's 50 ms reports
+    static constexpr auto FRAME_INTERVAL = std::chrono::microseconds { 16667 };
+    static constexpr int FRAMES_PER_REPORT = 3;
+
+    double loss;
+    std::mt19937 rng { 42 };
+
+    adaptive_fec::clock::time_point now = adaptive_fec::clock::now();
+
+    int frames = 0;
+    int lost_frames = 0;
+
+    /**
+     * @brief Stream frames of the same size.
+     * @param controller The FEC controller of the stream.
+     * @param duration How long to stream.
+     * @param data_packets The number of data packets of each frame.
+     */
+    void
+    stream(adaptive_fec::controller_t &controller, std::chrono::seconds duration, int data_packets) {
+      std::bernoulli_distribution lose { loss };
+
+      std::size_t lost_since_report = 0;
+      for (auto end = now + duration; now < end; now += FRAME_INTERVAL) {
+        auto percentage = controller.percentage(false, now);
+        auto parity_packets = (data_packets * percentage + 99) / 100;
+
+        int lost = 0;
+        for (int x = 0; x < data_packets + parity_packets; ++x) {
+          lost += lose(rng);
+        }
+        controller.sent(data_packets + parity_packets);
+
+        // A frame can be recovered as long as no more packets were lost than there are parity packets
+        ++frames;
+        if (lost > parity_packets) {
+          ++lost_frames;
+          controller.report_frame_loss(now);
+        }
+
+        lost_since_report += lost;
+        if (frames % FRAMES_PER_REPORT == 0) {
+          controller.report_loss(lost_since_report, std::chrono::duration_cast<std::chrono::milliseconds>(FRAME_INTERVAL * FRAMES_PER_REPORT));
+          lost_since_report = 0;
+        }
+      }
+    }
+  };
+}  // namespace
+
+TEST(AdaptiveFecTests, StartsAtBasePercentageTest) {
+  auto now = adaptive_fec::clock::now();
+  adaptive_fec::controller_t controller { 20, now };
+
+  EXPECT_EQ(controller.percentage(false, now), 20);
+  EXPECT_EQ(controller.percentage(true, now), 40);
+}
+
+TEST(AdaptiveFecTests, CleanLinkDropsToFloorTest) {
+  lossy_link_t link { 0.0 };
+  adaptive_fec::controller_t controller { 20, link.now };
+
+  link.stream(controller, 30s, 50);
+
+  // Delta frames only get the client's minimum parity, key frames keep the configured protection
+  EXPECT_EQ(controller.percentage(false, link.now), adaptive_fec::MIN_PERCENTAGE);
+  EXPECT_EQ(controller.percentage(true, link.now), 20);
+  EXPECT_EQ(link.lost_frames, 0);
+}
+
+TEST(AdaptiveFecTests, LossyLinkRaisesParityTest) {
+  lossy_link_t link { 0.05 };
+  adaptive_fec::controller_t controller { 20, link.now };
+
+  // Let the controller settle, then count the frames that can't be recovered
+  link.stream(controller, 10s, 50);
+  link.frames = link.lost_frames = 0;
+  link.stream(controller, 30s, 50);
+
+  // The estimate rises faster than it falls, so it errs on the high side
+  EXPECT_GE(controller.loss_rate(), 0.04);
+  EXPECT_LE(controller.loss_rate(), 0.10);
+  EXPECT_GE(controller.percentage(false, link.now), 15);
+  EXPECT_LT((double) link.lost_frames / link.frames, 0.01);
+}
+
+TEST(AdaptiveFecTests, LossFallsSlowlyTest) {
+  lossy_link_t link { 0.10 };
+  adaptive_fec::controller_t controller { 20, link.now };
+
+  link.stream(controller, 10s, 50);
+  auto lossy_percentage = controller.percentage(false, link.now);
+
+  // A short clean period doesn't drop parity all at once
+  link.loss = 0.0;
+  link.stream(controller, 1s, 50);
+  EXPECT_GT(controller.percentage(false, link.now), lossy_percentage / 2);
+
+  link.stream(controller, 30s, 50);
+  EXPECT_EQ(controller.percentage(false, link.now), adaptive_fec::MIN_PERCENTAGE);
+}
+
+TEST(AdaptiveFecTests, FrameLossBoostFadesTest) {
+  auto now = adaptive_fec::clock::now();
+  adaptive_fec::controller_t controller { 20, now };
+
+  now += 60s;
+  ASSERT_EQ(controller.percentage(false, now), adaptive_fec::MIN_PERCENTAGE);
+
+  controller.report_frame_loss(now);
+  EXPECT_GE(controller.percentage(false, now), 10);
+
+  now += 60s;
+  EXPECT_EQ(controller.percentage(false, now), adaptive_fec::MIN_PERCENTAGE);
+
+  // A frame lost long after the last percentage() call gets its full boost
+  now += 60s;
+  controller.report_frame_loss(now);
+  EXPECT_GE(controller.percentage(false, now), 10);
+}
+
+TEST(AdaptiveFecTests, LossReportsLoseNothingTwiceTest) {
+  auto now = adaptive_fec::clock::now();
+  adaptive_fec::controller_t controller { 20, now };
+
+  // Half of the packets sent were lost
+  controller.sent(100);
+  controller.report_loss(50, 50ms);
+  EXPECT_DOUBLE_EQ(controller.loss_rate(), 0.5 * 0.5);
+}
+
+TEST(AdaptiveFecTests, LongerReportsWeighMoreTest) {
+  auto now = adaptive_fec::clock::now();
+  adaptive_fec::controller_t short_report { 20, now };
+  adaptive_fec::controller_t long_report { 20, now };
+
+  short_report.sent(100);
+  short_report.report_loss(10, 50ms);
+  long_report.sent(100);
+  long_report.report_loss(10, 200ms);
+
+  // Four reports' worth of the same loss get closer to it than one
+  EXPECT_GT(long_report.loss_rate(), short_report.loss_rate());
+  EXPECT_LE(long_report.loss_rate(), 0.1);
+}
+
+TEST(AdaptiveFecTests, IdrGetsMoreProtectionTest) {
+  lossy_link_t link { 0.03 };
+  adaptive_fec::controller_t controller { 20, link.now };
+
+  link.stream(controller, 10s, 50);
+
+  auto percentage = controller.percentage(false, link.now);
+  auto idr_percentage = controller.percentage(true, link.now);
+  EXPECT_GT(idr_percentage, percentage);
+  EXPECT_GE(idr_percentage, 20);
+  EXPECT_LE(idr_percentage, adaptive_fec::MAX_PERCENTAGE);
+}
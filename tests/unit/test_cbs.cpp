@@ -0,0 +1,82 @@
+/**
+ * @file tests/unit/test_cbs.cpp
+ * @brief Test src/cbs.*
+ */
+#include <src/cbs.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <tests/conftest.cpp>
+
+namespace {
+  util::buffer_t<std::uint8_t>
+  make_nal(std::initializer_list<std::uint8_t> bytes) {
+    util::buffer_t<std::uint8_t> nal { bytes.size() };
+    std::copy(std::begin(bytes), std::end(bytes), std::begin(nal));
+
+    return nal;
+  }
+
+  /**
+   * @brief Run the parameter set replacement on a copy of the given packet.
+   * @return The payload of the packet after the replacement.
+   */
+  std::vector<std::uint8_t>
+  replace_in_packet(const std::vector<std::uint8_t> &payload, int codec_id, std::initializer_list<const cbs::nal_t *> nals) {
+    auto packet = av_packet_alloc();
+    auto fg = util::fail_guard([&]() {
+      av_packet_free(&packet);
+    });
+
+    EXPECT_EQ(av_new_packet(packet, payload.size()), 0);
+    std::copy(std::begin(payload), std::end(payload), packet->data);
+
+    EXPECT_EQ(cbs::replace_parameter_sets(packet, codec_id, nals), 0);
+
+    return { packet->data, packet->data + packet->size };
+  }
+}  // namespace
+
+TEST(ReplaceParameterSetsTests, H264SpsTest) {
+  cbs::nal_t sps {
+    make_nal({ 0, 0, 0, 1, 0x67, 9, 9, 9, 9 }),
+    make_nal({ 0, 0, 0, 1, 0x67, 1, 2 }),
+  };
+  cbs::nal_t vps {};
+
+  // AUD, SPS, PPS, IDR slice containing the SPS bytes
+  auto payload = std::vector<std::uint8_t> { 0, 0, 0, 1, 0x09, 0xf0, 0, 0, 0, 1, 0x67, 1, 2, 0, 0, 0, 1, 0x68, 5, 0, 0, 1, 0x65, 0x67, 1, 2 };
+  auto expected = std::vector<std::uint8_t> { 0, 0, 0, 1, 0x09, 0xf0, 0, 0, 0, 1, 0x67, 9, 9, 9, 9, 0, 0, 0, 1, 0x68, 5, 0, 0, 1, 0x65, 0x67, 1, 2 };
+
+  ASSERT_EQ(replace_in_packet(payload, AV_CODEC_ID_H264, { &vps, &sps }), expected);
+}
+
+TEST(ReplaceParameterSetsTests, HevcVpsSpsTest) {
+  cbs::nal_t vps {
+    make_nal({ 0, 0, 0, 1, 0x40, 1, 0xAA }),
+    make_nal({ 0, 0, 0, 1, 0x40, 1, 3 }),
+  };
+  cbs::nal_t sps {
+    make_nal({ 0, 0, 0, 1, 0x42, 1 }),
+    make_nal({ 0, 0, 0, 1, 0x42, 1, 4, 4 }),
+  };
+
+  auto payload = std::vector<std::uint8_t> { 0, 0, 0, 1, 0x40, 1, 3, 0, 0, 0, 1, 0x42, 1, 4, 4, 0, 0, 0, 1, 0x44, 1, 0, 0, 1, 0x26, 1 };
+  auto expected = std::vector<std::uint8_t> { 0, 0, 0, 1, 0x40, 1, 0xAA, 0, 0, 0, 1, 0x42, 1, 0, 0, 0, 1, 0x44, 1, 0, 0, 1, 0x26, 1 };
+
+  ASSERT_EQ(replace_in_packet(payload, AV_CODEC_ID_H265, { &vps, &sps }), expected);
+}
+
+TEST(ReplaceParameterSetsTests, SliceDataUntouchedTest) {
+  cbs::nal_t sps {
+    make_nal({ 0, 0, 0, 1, 0x67, 9 }),
+    make_nal({ 0, 0, 0, 1, 0x67, 1, 2 }),
+  };
+
+  // The SPS only appears after the first slice, so it must not be replaced
+  auto payload = std::vector<std::uint8_t> { 0, 0, 0, 1, 0x65, 7, 0, 0, 0, 1, 0x67, 1, 2 };
+
+  ASSERT_EQ(replace_in_packet(payload, AV_CODEC_ID_H264, { &sps }), payload);
+}
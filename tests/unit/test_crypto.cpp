@@ -0,0 +1,67 @@
+/**
+ * @file tests/unit/test_crypto.cpp
+ * @brief Test src/crypto.*
+ */
+#include <src/crypto.h>
+
+#include <tests/conftest.cpp>
+
+class GcmBatchTest: public BaseTest, public ::testing::WithParamInterface<std::size_t> {
+protected:
+  void
+  SetUp() override {
+    BaseTest::SetUp();
+    pool.start(3);
+  }
+
+  void
+  TearDown() override {
+    pool.stop();
+    pool.join();
+    BaseTest::TearDown();
+  }
+
+  thread_pool_util::ThreadPool pool;
+};
+
+TEST_P(GcmBatchTest, MatchesSequentialEncryptTest) {
+  auto shard_count = GetParam();
+
+  crypto::aes_t key(16, 0x42);
+  crypto::cipher::gcm_t sequential { key, false };
+  crypto::cipher::gcm_t batched { key, false };
+
+  std::vector<std::string> headers, payloads;
+  std::vector<crypto::aes_t> ivs;
+  for (std::size_t x = 0; x < shard_count; ++x) {
+    headers.emplace_back(16, (char) x);
+    payloads.emplace_back(1400, (char) (x * 7));
+    ivs.emplace_back(12, (std::uint8_t) x);
+  }
+
+  constexpr auto shard_size = 16 + 1400;
+  std::vector<std::uint8_t> expected_tags(shard_count * crypto::cipher::tag_size), expected(shard_count * shard_size);
+  std::vector<std::uint8_t> tags(expected_tags.size()), ciphertext(expected.size());
+
+  std::vector<crypto::cipher::gcm_shard_t> shards;
+  for (std::size_t x = 0; x < shard_count; ++x) {
+    ASSERT_EQ(sequential.encrypt(headers[x], payloads[x], &expected_tags[x * crypto::cipher::tag_size], &expected[x * shard_size], &ivs[x]), shard_size);
+    shards.emplace_back(crypto::cipher::gcm_shard_t { headers[x], payloads[x], &tags[x * crypto::cipher::tag_size], &ciphertext[x * shard_size] });
+  }
+
+  ASSERT_EQ(batched.encrypt_batch(shards, ivs, pool, 4), 0);
+  EXPECT_EQ(tags, expected_tags);
+  EXPECT_EQ(ciphertext, expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  GcmBatchTests,
+  GcmBatchTest,
+  ::testing::Values(0, 1, 5, 200));
+
+TEST_F(GcmBatchTest, MismatchedIvCountTest) {
+  crypto::cipher::gcm_t gcm { crypto::aes_t(16), false };
+  std::vector<crypto::aes_t> ivs(1, crypto::aes_t(12));
+
+  EXPECT_EQ(gcm.encrypt_batch({}, ivs, pool, 4), -1);
+}
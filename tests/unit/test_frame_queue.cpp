@@ -0,0 +1,184 @@
+/**
+ * @file tests/unit/test_frame_queue.cpp
+ * @brief Test src/frame_queue.*
+ */
+#include <src/frame_queue.h>
+
+#include <tests/conftest.cpp>
+
+using namespace std::literals;
+
+namespace {
+  video::packet_t
+  make_frame(std::int64_t index, bool idr = false, std::size_t size = 1000) {
+    return std::make_unique<video::packet_raw_generic>(std::vector<uint8_t>(size), index, idr);
+  }
+
+  /**
+   * @brief A frame queue that records the recovery requests it makes.
+   */
+  struct recording_queue_t {
+    recording_queue_t(std::size_t max_frames, std::size_t max_bytes = 1024 * 1024, video::frame_queue_t::clock::duration max_age = 1h):
+        queue { max_frames, max_bytes, max_age, [this](std::int64_t first_frame, std::int64_t last_frame) {
+                 recoveries.emplace_back(first_frame, last_frame);
+               } } {}
+
+    std::vector<std::int64_t>
+    drain() {
+      std::vector<std::int64_t> frames;
+      while (queue.peek()) {
+        frames.emplace_back(queue.pop()->frame_index());
+      }
+      return frames;
+    }
+
+    std::vector<std::pair<std::int64_t, std::int64_t>> recoveries;
+    video::frame_queue_t queue;
+  };
+}  // namespace
+
+TEST(FrameQueueTests, PassesFramesInOrderTest) {
+  recording_queue_t q { 4 };
+
+  for (auto x = 1; x <= 4; ++x) {
+    q.queue.raise(make_frame(x, x == 1));
+  }
+
+  EXPECT_EQ(q.queue.size(), 4);
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 1, 2, 3, 4 }));
+  EXPECT_TRUE(q.recoveries.empty());
+  EXPECT_EQ(q.queue.stats().dropped_frames, 0);
+}
+
+TEST(FrameQueueTests, DropsFramesBeforeKeyFrameTest) {
+  recording_queue_t q { 4 };
+
+  q.queue.raise(make_frame(1, true));
+  q.queue.raise(make_frame(2));
+  q.queue.raise(make_frame(3));
+  q.queue.raise(make_frame(4, true));
+  q.queue.raise(make_frame(5));
+
+  // Nothing from frame 4 on needs the older frames, so no recovery is needed
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 4, 5 }));
+  EXPECT_TRUE(q.recoveries.empty());
+  EXPECT_EQ(q.queue.stats().dropped_frames, 3);
+}
+
+TEST(FrameQueueTests, DroppedReferenceFramesRequestRecoveryTest) {
+  recording_queue_t q { 4 };
+
+  q.queue.raise(make_frame(1, true));
+  for (auto x = 2; x <= 5; ++x) {
+    q.queue.raise(make_frame(x));
+  }
+
+  // The key frame is kept, the frames after it can't be decoded once one of them is gone
+  ASSERT_EQ(q.recoveries.size(), 1);
+  EXPECT_EQ(q.recoveries[0], (std::pair<std::int64_t, std::int64_t> { 2, 5 }));
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 1 }));
+
+  // Frames still referencing the dropped ones are dropped until the encoder recovers
+  q.queue.raise(make_frame(6));
+  EXPECT_FALSE(q.queue.peek());
+
+  auto recovered = make_frame(7);
+  recovered->after_ref_frame_invalidation = true;
+  q.queue.raise(std::move(recovered));
+  q.queue.raise(make_frame(8));
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 7, 8 }));
+
+  auto stats = q.queue.stats();
+  EXPECT_EQ(stats.frames, 8);
+  EXPECT_EQ(stats.dropped_frames, 5);
+  EXPECT_EQ(stats.dropped_bytes, 5000);
+  EXPECT_EQ(stats.recoveries, 1);
+}
+
+TEST(FrameQueueTests, KeyFrameEndsRecoveryTest) {
+  recording_queue_t q { 2 };
+
+  for (auto x = 1; x <= 3; ++x) {
+    q.queue.raise(make_frame(x));
+  }
+  ASSERT_EQ(q.recoveries.size(), 1);
+  EXPECT_FALSE(q.queue.peek());
+
+  q.queue.raise(make_frame(4, true));
+  q.queue.raise(make_frame(5));
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 4, 5 }));
+}
+
+TEST(FrameQueueTests, RepeatsRecoveryRequestTest) {
+  recording_queue_t q { 2 };
+
+  for (auto x = 1; x <= 3; ++x) {
+    q.queue.raise(make_frame(x));
+  }
+  ASSERT_EQ(q.recoveries.size(), 1);
+
+  // An encoder that doesn't recover is asked again
+  for (auto x = 4; x <= 5; ++x) {
+    q.queue.raise(make_frame(x));
+  }
+  ASSERT_EQ(q.recoveries.size(), 2);
+  EXPECT_EQ(q.recoveries[1], (std::pair<std::int64_t, std::int64_t> { 1, 5 }));
+}
+
+TEST(FrameQueueTests, ByteLimitTest) {
+  recording_queue_t q { 32, 10000 };
+
+  // A single frame over the limit is still sent
+  q.queue.raise(make_frame(1, true, 20000));
+  EXPECT_EQ(q.queue.size(), 1);
+
+  q.queue.raise(make_frame(2, true, 6000));
+  q.queue.raise(make_frame(3, false, 6000));
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 2 }));
+  EXPECT_EQ(q.recoveries.size(), 1);
+}
+
+TEST(FrameQueueTests, AgeLimitTest) {
+  recording_queue_t q { 32, 1024 * 1024, 20ms };
+
+  q.queue.raise(make_frame(1, true));
+  std::this_thread::sleep_for(30ms);
+  q.queue.raise(make_frame(2, true));
+
+  // The stale frame is dropped instead of being sent
+  EXPECT_EQ(q.drain(), (std::vector<std::int64_t> { 2 }));
+  EXPECT_TRUE(q.recoveries.empty());
+}
+
+TEST(FrameQueueTests, StopWakesSenderTest) {
+  recording_queue_t q { 4 };
+
+  std::thread sender { [&]() {
+    EXPECT_EQ(q.queue.pop(), nullptr);
+  } };
+
+  std::this_thread::sleep_for(10ms);
+  q.queue.stop();
+  sender.join();
+
+  EXPECT_FALSE(q.queue.running());
+}
+
+TEST(FrameQueueTests, WaitAndDepthStatsTest) {
+  recording_queue_t q { 4 };
+
+  q.queue.raise(make_frame(1, true));
+  q.queue.raise(make_frame(2));
+  std::this_thread::sleep_for(10ms);
+
+  video::frame_queue_t::clock::duration wait;
+  ASSERT_NE(q.queue.pop(&wait), nullptr);
+  EXPECT_GE(wait, 10ms);
+  ASSERT_NE(q.queue.pop(), nullptr);
+
+  auto stats = q.queue.stats();
+  EXPECT_EQ(stats.popped, 2);
+  EXPECT_EQ(stats.max_depth, 2);
+  EXPECT_GE(stats.max_wait, 10ms);
+  EXPECT_GE(stats.total_wait, 20ms);
+}
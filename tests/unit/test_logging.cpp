@@ -5,9 +5,12 @@
 #include <fstream>
 
 #include <src/logging.h>
+#include <src/utility.h>
 
 #include <tests/conftest.cpp>
 
+using namespace std::literals;
+
 class LoggerInitTest: public virtual BaseTest, public ::testing::WithParamInterface<int> {
 protected:
   void
@@ -73,3 +76,26 @@ TEST(PrintHelpTest, CheckOutput) {
   EXPECT_NE(output.find("Usage: " + name), std::string::npos);
   EXPECT_NE(output.find("--help"), std::string::npos);
 }
+
+TEST(PeriodicObserverTest, ReceivesValues) {
+  std::vector<std::pair<std::string, double>> values;
+  logging::set_periodic_observer([&values](std::string_view message, double value) {
+    values.emplace_back(message, value);
+  });
+  auto fg = util::fail_guard([]() {
+    logging::set_periodic_observer(nullptr);
+  });
+
+  // Loggers are enabled by the observer, even when their level isn't logged
+  auto old_level = std::exchange(config::sunshine.min_log_level, 5);
+  logging::min_max_avg_periodic_logger<int> logger(debug, "Test value", "");
+  config::sunshine.min_log_level = old_level;
+
+  EXPECT_TRUE(logger.is_enabled());
+  logger.collect_and_log(1);
+  logger.collect_and_log(2);
+
+  ASSERT_EQ(values.size(), 2);
+  EXPECT_EQ(values[0], std::make_pair("Test value"s, 1.0));
+  EXPECT_EQ(values[1], std::make_pair("Test value"s, 2.0));
+}
@@ -0,0 +1,132 @@
+/**
+ * @file tests/unit/test_pacer.cpp
+ * @brief Test src/pacer.*
+ */
+#include <src/pacer.h>
+
+#include <tests/conftest.cpp>
+
+using namespace std::literals;
+
+TEST(TokenBucketTests, BurstThenSpacedTest) {
+  // 1 MB/s, so 1000 bytes take 1 ms
+  pacer::token_bucket_t bucket { 1'000'000, 2000 };
+
+  auto now = pacer::clock::now();
+
+  // The burst allowance may be sent right away
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+
+  // After that, data is spaced at the rate
+  EXPECT_EQ(bucket.reserve(1000, now), now + 1ms);
+  EXPECT_EQ(bucket.reserve(1000, now), now + 2ms);
+}
+
+TEST(TokenBucketTests, IdleDoesNotAccumulateTest) {
+  pacer::token_bucket_t bucket { 1'000'000, 1000 };
+
+  auto now = pacer::clock::now();
+  bucket.reserve(1000, now);
+
+  // A long idle period only refills the burst allowance
+  now += 10s;
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+  EXPECT_EQ(bucket.reserve(1000, now), now + 1ms);
+}
+
+TEST(TokenBucketTests, SetRateTest) {
+  pacer::token_bucket_t bucket { 1'000'000, 0 };
+
+  auto now = pacer::clock::now();
+  EXPECT_EQ(bucket.reserve(1000, now), now);
+
+  // Data already reserved keeps its spacing, new data uses the new rate
+  bucket.set_rate(2'000'000);
+  EXPECT_EQ(bucket.reserve(1000, now), now + 1ms);
+  EXPECT_EQ(bucket.reserve(1000, now), now + 1500us);
+}
+
+TEST(EgressTests, EqualSplitTest) {
+  pacer::egress_t egress { 900 };
+
+  auto flow1 = egress.join(pacer::UNLIMITED);
+  EXPECT_EQ(flow1->rate(), 900);
+
+  auto flow2 = egress.join(pacer::UNLIMITED);
+  auto flow3 = egress.join(pacer::UNLIMITED);
+  EXPECT_EQ(flow1->rate(), 300);
+  EXPECT_EQ(flow2->rate(), 300);
+  EXPECT_EQ(flow3->rate(), 300);
+}
+
+TEST(EgressTests, UnusedShareDonatedTest) {
+  pacer::egress_t egress { 900 };
+
+  auto small = egress.join(100);
+  auto large1 = egress.join(pacer::UNLIMITED);
+  auto large2 = egress.join(pacer::UNLIMITED);
+
+  // The small flow only gets its demand, the rest is split between the others
+  EXPECT_EQ(small->rate(), 100);
+  EXPECT_EQ(large1->rate(), 400);
+  EXPECT_EQ(large2->rate(), 400);
+}
+
+TEST(EgressTests, RebalanceOnLeaveTest) {
+  pacer::egress_t egress { 1000 };
+
+  auto flow1 = egress.join(pacer::UNLIMITED);
+  {
+    auto flow2 = egress.join(pacer::UNLIMITED);
+    EXPECT_EQ(flow1->rate(), 500);
+  }
+
+  EXPECT_EQ(flow1->rate(), 1000);
+}
+
+TEST(EgressTests, UnlimitedEgressTest) {
+  pacer::egress_t egress { pacer::UNLIMITED };
+
+  auto capped = egress.join(100);
+  auto uncapped = egress.join(pacer::UNLIMITED);
+
+  EXPECT_EQ(capped->rate(), 100);
+  EXPECT_EQ(uncapped->rate(), pacer::UNLIMITED);
+}
+
+TEST(EgressTests, MeasuredDemandTest) {
+  pacer::egress_t egress { 1000 };
+
+  auto quiet = egress.join(pacer::UNLIMITED);
+  auto busy = egress.join(pacer::UNLIMITED);
+  EXPECT_EQ(busy->rate(), 500);
+
+  // Demand only falls once a measurement window ends
+  auto now = pacer::clock::now();
+  quiet->want(100, now);
+  EXPECT_EQ(busy->rate(), 500);
+
+  quiet->want(100, now + pacer::DEMAND_WINDOW);
+  EXPECT_EQ(quiet->rate(), 100);
+  EXPECT_EQ(busy->rate(), 900);
+
+  // Demand rises right away, up to the fair share
+  quiet->want(800, now + pacer::DEMAND_WINDOW + 1ms);
+  EXPECT_EQ(quiet->rate(), 500);
+  EXPECT_EQ(busy->rate(), 500);
+}
+
+TEST(EgressTests, WantedRateCappedTest) {
+  pacer::egress_t egress { 1000 };
+
+  auto capped = egress.join(200);
+  auto other = egress.join(pacer::UNLIMITED);
+
+  auto now = pacer::clock::now();
+  capped->want(600, now);
+  EXPECT_EQ(capped->rate(), 200);
+  EXPECT_EQ(other->rate(), 800);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file tests/unit/test_rs_cache.cpp
+ * @brief Test src/rs_cache.*
+ */
+#include <src/rs_cache.h>
+
+#include <tests/conftest.cpp>
+
+class RsCacheTest: public BaseTest {
+protected:
+  void
+  SetUp() override {
+    BaseTest::SetUp();
+    reed_solomon_init();
+  }
+};
+
+TEST_F(RsCacheTest, HitMissTest) {
+  rs_cache::cache_t cache { 4 };
+
+  auto rs1 = cache.get(10, 2);
+  ASSERT_NE(rs1, nullptr);
+  auto rs2 = cache.get(10, 2);
+  auto rs3 = cache.get(10, 3);
+
+  // The same geometry reuses the codec, a different one doesn't
+  EXPECT_EQ(rs1, rs2);
+  EXPECT_NE(rs1, rs3);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+}
+
+TEST_F(RsCacheTest, EvictionTest) {
+  rs_cache::cache_t cache { 2 };
+
+  auto rs1 = cache.get(1, 1);
+  cache.get(2, 1);
+
+  // Use the first codec again, so the second one is the least recently used
+  cache.get(1, 1);
+  cache.get(3, 1);
+  EXPECT_EQ(cache.size(), 2);
+
+  EXPECT_EQ(cache.get(1, 1), rs1);
+  EXPECT_EQ(cache.stats().misses, 3);
+
+  cache.get(2, 1);
+  EXPECT_EQ(cache.stats().misses, 4);
+}
+
+TEST_F(RsCacheTest, EvictedCodecStaysValidTest) {
+  rs_cache::cache_t cache { 1 };
+
+  auto rs = cache.get(1, 1);
+  cache.get(2, 1);
+
+  // The evicted codec must still be usable by its current owner
+  uint8_t dataShard[16] = { 1, 2, 3 };
+  uint8_t fecShard[16] = {};
+  uint8_t *shardPtrs[2] = { dataShard, fecShard };
+  ASSERT_EQ(reed_solomon_encode(rs.get(), shardPtrs, 2, sizeof(dataShard)), 0);
+}
+
+TEST_F(RsCacheTest, ConcurrentGetTest) {
+  rs_cache::cache_t cache { 8 };
+
+  std::vector<std::thread> threads;
+  for (auto t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache]() {
+      for (auto x = 0; x < 100; ++x) {
+        ASSERT_NE(cache.get(1 + x % 16, 1 + x % 3), nullptr);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 400);
+  EXPECT_LE(cache.size(), 8);
+}
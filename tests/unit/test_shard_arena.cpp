@@ -0,0 +1,95 @@
+/**
+ * @file tests/unit/test_shard_arena.cpp
+ * @brief Test src/shard_arena.*
+ */
+#include <src/shard_arena.h>
+
+#include <tests/conftest.cpp>
+
+using namespace std::literals;
+
+TEST(ShardArenaTests, AlignedBuffersTest) {
+  auto arena = std::make_shared<shard_arena::arena_t>(1s);
+
+  for (auto size : { 1, 63, 64, 65, 1500, 100000 }) {
+    auto buffer = arena->acquire<char>(size);
+
+    EXPECT_EQ(buffer.size(), size);
+    EXPECT_EQ((std::uintptr_t) buffer.begin() % shard_arena::ALIGNMENT, 0);
+  }
+
+  EXPECT_EQ(arena->acquire<char>(0).begin(), nullptr);
+}
+
+TEST(ShardArenaTests, RecyclesBuffersTest) {
+  auto arena = std::make_shared<shard_arena::arena_t>(1h);
+
+  // The first frame allocates its buffers, the following frames of up to the same size reuse them
+  for (auto frame = 0; frame < 10; ++frame) {
+    auto headers = arena->acquire<char>(100 * 16);
+    auto pointers = arena->acquire<std::uint8_t *>(100);
+    auto shards = arena->acquire<char>(20 * 1400 - frame * 100);
+  }
+
+  auto stats = arena->stats();
+  EXPECT_EQ(stats.acquired, 30);
+  EXPECT_EQ(stats.allocations, 3);
+}
+
+TEST(ShardArenaTests, GrowsToLargestFrameTest) {
+  auto arena = std::make_shared<shard_arena::arena_t>(1h);
+
+  arena->acquire<char>(1000);
+  arena->acquire<char>(100000);
+  arena->acquire<char>(1000);
+  arena->acquire<char>(100000);
+
+  EXPECT_EQ(arena->stats().allocations, 2);
+}
+
+TEST(ShardArenaTests, TrimFreesIdleBuffersTest) {
+  auto arena = std::make_shared<shard_arena::arena_t>(1s);
+  auto now = shard_arena::clock::now();
+
+  // A burst of large blocks, followed by a quiet stream that only needs one at a time
+  {
+    std::vector<shard_arena::buffer_t<char>> burst;
+    for (auto x = 0; x < 4; ++x) {
+      burst.emplace_back(arena->acquire<char>(4096));
+    }
+  }
+  auto burst_bytes = arena->stats().bytes;
+
+  // Nothing is freed until the idle period is over
+  arena->trim(now);
+  EXPECT_EQ(arena->stats().released, 0);
+
+  now += 2s;
+  arena->trim(now);
+  EXPECT_EQ(arena->stats().released, 0);
+
+  // Only as many buffers as the quiet stream used are kept
+  arena->acquire<char>(4096);
+  now += 2s;
+  arena->trim(now);
+
+  auto stats = arena->stats();
+  EXPECT_EQ(stats.released, 3);
+  EXPECT_EQ(stats.bytes, burst_bytes / 4);
+
+  // The remaining buffer is still reused
+  arena->acquire<char>(4096);
+  EXPECT_EQ(arena->stats().allocations, 4);
+}
+
+TEST(ShardArenaTests, BuffersKeepArenaAliveTest) {
+  auto arena = std::make_shared<shard_arena::arena_t>(1s);
+  std::weak_ptr<shard_arena::arena_t> weak = arena;
+
+  auto buffer = arena->acquire<char>(1500);
+  arena.reset();
+
+  EXPECT_FALSE(weak.expired());
+  buffer = {};
+  EXPECT_TRUE(weak.expired());
+}
@@ -2,39 +2,124 @@
  * @file tests/unit/test_stream.cpp
  * @brief Test src/stream.*
  */
+#include <random>
 
-#include <cstdint>
-#include <functional>
-#include <string>
-#include <vector>
+#include <src/stream.h>
 
-namespace stream {
+#include <tests/conftest.cpp>
+
+namespace {
+  /**
+   * @brief Lay out the headers and slices of a sliced payload back to back.
+   * @param sliced The sliced payload.
+   * @return The headers and slices, without the padding of the final slice.
+   */
   std::vector<uint8_t>
-  concat_and_insert(uint64_t insert_size, uint64_t slice_size, const std::string_view &data1, const std::string_view &data2);
-}
+  flatten(stream::sliced_payload_t &sliced) {
+    std::vector<uint8_t> result;
+    for (auto x = 0; x < sliced.size(); ++x) {
+      result.insert(std::end(result), sliced.header(x), sliced.header(x) + sliced.insert_size);
+      result.insert(std::end(result), sliced.slices[x], sliced.slices[x] + sliced.slice_size);
+    }
 
-#include <tests/conftest.cpp>
+    // Padding of the final slice must be zeroed
+    auto size = sliced.size() * sliced.insert_size + sliced.data_size;
+    EXPECT_TRUE(std::all_of(std::begin(result) + size, std::end(result), [](auto b) { return b == 0; }));
+    result.resize(size);
+
+    return result;
+  }
+}  // namespace
 
-TEST(ConcatAndInsertTests, ConcatNoInsertionTest) {
+TEST(SliceAndInsertTests, ConcatNoInsertionTest) {
   char b1[] = { 'a', 'b' };
   char b2[] = { 'c', 'd', 'e' };
-  auto res = stream::concat_and_insert(0, 2, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
+  auto sliced = stream::slice_and_insert(0, 2, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
   auto expected = std::vector<uint8_t> { 'a', 'b', 'c', 'd', 'e' };
-  ASSERT_EQ(res, expected);
+  ASSERT_EQ(flatten(sliced), expected);
 }
 
-TEST(ConcatAndInsertTests, ConcatLargeStrideTest) {
+TEST(SliceAndInsertTests, ConcatLargeStrideTest) {
   char b1[] = { 'a', 'b' };
   char b2[] = { 'c', 'd', 'e' };
-  auto res = stream::concat_and_insert(1, sizeof(b1) + sizeof(b2) + 1, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
+  auto sliced = stream::slice_and_insert(1, sizeof(b1) + sizeof(b2) + 1, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
   auto expected = std::vector<uint8_t> { 0, 'a', 'b', 'c', 'd', 'e' };
-  ASSERT_EQ(res, expected);
+  ASSERT_EQ(flatten(sliced), expected);
 }
 
-TEST(ConcatAndInsertTests, ConcatSmallStrideTest) {
+TEST(SliceAndInsertTests, ConcatSmallStrideTest) {
   char b1[] = { 'a', 'b' };
   char b2[] = { 'c', 'd', 'e' };
-  auto res = stream::concat_and_insert(1, 1, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
+  auto sliced = stream::slice_and_insert(1, 1, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
   auto expected = std::vector<uint8_t> { 0, 'a', 0, 'b', 0, 'c', 0, 'd', 0, 'e' };
-  ASSERT_EQ(res, expected);
+  ASSERT_EQ(flatten(sliced), expected);
+}
+
+TEST(SliceAndInsertTests, SlicesReferencedInPlaceTest) {
+  char b1[] = { 'a', 'b', 'c' };
+  char b2[] = { 'd', 'e', 'f', 'g', 'h', 'i', 'j' };
+  auto sliced = stream::slice_and_insert(1, 2, std::string_view { b1, sizeof(b1) }, std::string_view { b2, sizeof(b2) });
+  auto expected = std::vector<uint8_t> { 0, 'a', 'b', 0, 'c', 'd', 0, 'e', 'f', 0, 'g', 'h', 0, 'i', 'j' };
+  ASSERT_EQ(flatten(sliced), expected);
+
+  // Only the slice spanning both buffers is copied
+  EXPECT_EQ(sliced.slices[0], b1);
+  EXPECT_NE(sliced.slices[1], b1 + 2);
+  EXPECT_EQ(sliced.slices[2], b2 + 1);
+  EXPECT_EQ(sliced.slices[3], b2 + 3);
+  EXPECT_EQ(sliced.slices[4], b2 + 5);
+}
+
+class FecEncodeRangesTest: public BaseTest {
+protected:
+  void
+  SetUp() override {
+    BaseTest::SetUp();
+    reed_solomon_init();
+  }
+};
+
+TEST_F(FecEncodeRangesTest, MatchesSingleThreadedEncodeTest) {
+  thread_pool_util::ThreadPool pool { 3 };
+  std::mt19937 rng { 42 };
+
+  // Shard sizes that aren't a multiple of the range alignment, and range counts that don't divide them evenly
+  std::vector<std::pair<int, int>> geometries { { 1, 1 }, { 4, 2 }, { 7, 3 }, { 50, 10 }, { 200, 55 } };
+  for (auto [data_shards, parity_shards] : geometries) {
+    auto nr_shards = data_shards + parity_shards;
+    auto rs = reed_solomon_new(data_shards, parity_shards);
+    ASSERT_NE(rs, nullptr);
+    auto fg = util::fail_guard([rs]() {
+      reed_solomon_release(rs);
+    });
+
+    for (std::size_t blocksize : { 16, 100, 1392, 4097 }) {
+      for (std::size_t ranges : { 2, 3, 5 }) {
+        std::vector<std::vector<uint8_t>> expected(nr_shards, std::vector<uint8_t>(blocksize));
+        for (auto x = 0; x < data_shards; ++x) {
+          std::generate(std::begin(expected[x]), std::end(expected[x]), [&rng]() {
+            return (uint8_t) rng();
+          });
+        }
+        auto actual = expected;
+
+        std::vector<uint8_t *> expected_p;
+        std::vector<uint8_t *> actual_p;
+        for (auto x = 0; x < nr_shards; ++x) {
+          expected_p.emplace_back(expected[x].data());
+          actual_p.emplace_back(actual[x].data());
+        }
+
+        ASSERT_EQ(reed_solomon_encode(rs, expected_p.data(), nr_shards, blocksize), 0);
+
+        auto tasks = stream::fec::encode_ranges(rs, actual_p.data(), nr_shards, blocksize, ranges, pool);
+        EXPECT_LE(tasks.size(), ranges);
+        for (auto &task : tasks) {
+          task.get();
+        }
+
+        EXPECT_EQ(actual, expected) << data_shards << '+' << parity_shards << " shards of " << blocksize << " bytes in " << ranges << " ranges";
+      }
+    }
+  }
 }
@@ -0,0 +1,124 @@
+/**
+ * @file tests/unit/test_synthetic.cpp
+ * @brief Test src/platform/synthetic.*
+ */
+#include <cstring>
+#include <fstream>
+
+#include <src/config.h>
+#include <src/platform/synthetic.h>
+#include <src/video.h>
+
+#include <tests/conftest.cpp>
+
+namespace {
+  const video::config_t stream_config { 64, 32, 1000 };
+
+  /**
+   * @brief Run a display until it captured a number of frames.
+   * @return The captured frames, and how often the display reported no change.
+   */
+  std::pair<std::vector<std::vector<std::uint8_t>>, int>
+  capture(platf::display_t &disp, std::size_t frames) {
+    std::vector<std::vector<std::uint8_t>> captured;
+    auto unchanged = 0;
+
+    auto push = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) {
+      if (frame_captured) {
+        captured.emplace_back(img->data, img->data + img->height * img->row_pitch);
+      }
+      else {
+        ++unchanged;
+      }
+
+      return captured.size() < frames;
+    };
+    auto pull = [&](std::shared_ptr<platf::img_t> &img_out) {
+      img_out = disp.alloc_img();
+      return true;
+    };
+
+    bool cursor = false;
+    EXPECT_EQ(disp.capture(push, pull, &cursor), platf::capture_e::ok);
+
+    return { captured, unchanged };
+  }
+}  // namespace
+
+TEST(SyntheticDisplayTests, MovingPatternsTest) {
+  for (auto name : { "gradient", "text", "noise" }) {
+    auto disp = platf::synthetic::display(platf::mem_type_e::system, name, stream_config);
+    ASSERT_TRUE(disp) << name;
+    EXPECT_EQ(disp->width, stream_config.width);
+    EXPECT_EQ(disp->height, stream_config.height);
+
+    // Every frame is captured, and differs from the one before
+    auto [frames, unchanged] = capture(*disp, 3);
+    EXPECT_EQ(unchanged, 0) << name;
+    EXPECT_NE(frames[0], frames[1]) << name;
+    EXPECT_NE(frames[1], frames[2]) << name;
+  }
+}
+
+TEST(SyntheticDisplayTests, StaticDesktopTest) {
+  // Large enough for the windows and their caret to fit above the taskbar
+  auto disp = platf::synthetic::display(platf::mem_type_e::system, "desktop", { 320, 240, 1000 });
+  ASSERT_TRUE(disp);
+
+  // The caret blinks every 500 frames at 1000 fps, so only the first frame and the blink are captured
+  auto [frames, unchanged] = capture(*disp, 2);
+  EXPECT_EQ(unchanged, 499);
+  EXPECT_NE(frames[0], frames[1]);
+}
+
+TEST(SyntheticDisplayTests, TinyDisplayTest) {
+  // Too small for a single glyph, let alone the windows and the taskbar
+  for (auto name : { "text", "desktop" }) {
+    auto disp = platf::synthetic::display(platf::mem_type_e::system, name, { 4, 4, 1000 });
+    ASSERT_TRUE(disp) << name;
+
+    auto [frames, unchanged] = capture(*disp, 1);
+    EXPECT_EQ(frames.size(), 1) << name;
+  }
+}
+
+TEST(SyntheticDisplayTests, ReplayTest) {
+  auto path = std::filesystem::temp_directory_path() / "sunshine_synthetic_replay.bgr0";
+  auto frame_size = (std::size_t) stream_config.width * stream_config.height * 4;
+  {
+    std::ofstream file { path, std::ios::binary };
+    for (char x = 1; x <= 3; ++x) {
+      std::vector<char> frame(frame_size, x);
+      file.write(frame.data(), frame.size());
+    }
+  }
+
+  auto old_replay = std::exchange(config::video.synthetic_replay, path.string());
+  auto fg = util::fail_guard([&]() {
+    config::video.synthetic_replay = old_replay;
+    std::filesystem::remove(path);
+  });
+
+  auto names = platf::synthetic::display_names();
+  EXPECT_NE(std::find(std::begin(names), std::end(names), "replay"), std::end(names));
+
+  auto disp = platf::synthetic::display(platf::mem_type_e::system, "replay", stream_config);
+  ASSERT_TRUE(disp);
+
+  // The frames are replayed in a loop
+  auto [frames, unchanged] = capture(*disp, 4);
+  for (auto x = 0; x < 4; ++x) {
+    EXPECT_EQ(frames[x], std::vector<std::uint8_t>(frame_size, x % 3 + 1));
+  }
+}
+
+TEST(SyntheticDisplayTests, UnsupportedTest) {
+  config::video.synthetic_replay.clear();
+
+  auto names = platf::synthetic::display_names();
+  EXPECT_EQ(std::find(std::begin(names), std::end(names), "replay"), std::end(names));
+
+  EXPECT_FALSE(platf::synthetic::display(platf::mem_type_e::system, "replay", stream_config));
+  EXPECT_FALSE(platf::synthetic::display(platf::mem_type_e::system, "unknown", stream_config));
+  EXPECT_FALSE(platf::synthetic::display(platf::mem_type_e::unknown, "gradient", stream_config));
+}
@@ -0,0 +1,107 @@
+/**
+ * @file tests/unit/test_thread_safe.cpp
+ * @brief Test src/thread_safe.*
+ */
+#include <src/thread_safe.h>
+
+#include <tests/conftest.cpp>
+
+TEST(QueueTests, PopsInOrderTest) {
+  safe::queue_t<int> queue { 4 };
+
+  // Draining and refilling reuses the same storage
+  for (auto round = 0; round < 3; ++round) {
+    queue.raise(1);
+    queue.raise(2);
+    queue.raise(3);
+    EXPECT_EQ(*queue.pop(), 1);
+
+    queue.raise(4);
+    EXPECT_EQ(queue.size(), 3);
+    EXPECT_EQ(*queue.pop(), 2);
+    EXPECT_EQ(*queue.pop(), 3);
+    EXPECT_EQ(*queue.pop(), 4);
+    EXPECT_FALSE(queue.peek());
+  }
+}
+
+TEST(QueueTests, StaysBoundedTest) {
+  safe::queue_t<int> queue { 4 };
+
+  // A consumer that falls behind never lets the queue grow beyond its limit
+  for (auto x = 0; x < 100; ++x) {
+    queue.raise(x);
+    if (x % 3 == 0) {
+      queue.pop();
+    }
+
+    EXPECT_LE(queue.size(), 4);
+  }
+
+  EXPECT_EQ(queue.unsafe().size(), queue.size());
+}
+
+TEST(PoolTests, RecyclesObjectsTest) {
+  auto pool = std::make_shared<safe::pool_t<std::vector<float>>>(2, std::vector<float>(10));
+
+  std::vector<float> *first;
+  {
+    auto obj = pool->acquire();
+    EXPECT_EQ(obj->size(), 10);
+    first = obj.get();
+  }
+
+  auto obj = pool->acquire();
+  EXPECT_EQ(obj.get(), first);
+  EXPECT_EQ(pool->size(), 2);
+}
+
+TEST(PoolTests, GrowsWhenExhaustedTest) {
+  auto pool = std::make_shared<safe::pool_t<std::vector<float>>>(2, std::vector<float>(10));
+
+  {
+    auto a = pool->acquire();
+    auto b = pool->acquire();
+    auto c = pool->acquire();
+    EXPECT_EQ(c->size(), 10);
+  }
+  EXPECT_EQ(pool->size(), 3);
+
+  // Once grown, the same number of objects in use doesn't allocate anymore
+  {
+    auto a = pool->acquire();
+    auto b = pool->acquire();
+    auto c = pool->acquire();
+  }
+  EXPECT_EQ(pool->size(), 3);
+}
+
+TEST(PoolTests, ObjectsKeepPoolAliveTest) {
+  auto pool = std::make_shared<safe::pool_t<int>>(1, 0);
+  std::weak_ptr<safe::pool_t<int>> weak = pool;
+
+  auto obj = pool->acquire();
+  pool.reset();
+  EXPECT_FALSE(weak.expired());
+
+  obj.reset();
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(QueueTests, OnRaiseTest) {
+  safe::queue_t<int> queue { 4 };
+
+  int raised = 0;
+  queue.on_raise([&raised]() {
+    ++raised;
+  });
+
+  queue.raise(1);
+  queue.raise(2);
+  EXPECT_EQ(raised, 2);
+
+  queue.on_raise(nullptr);
+  queue.raise(3);
+  EXPECT_EQ(raised, 2);
+  EXPECT_EQ(queue.size(), 3);
+}
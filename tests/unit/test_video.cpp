@@ -2,10 +2,14 @@
  * @file tests/unit/test_video.cpp
  * @brief Test src/video.*.
  */
+#include <src/frame_queue.h>
+#include <src/globals.h>
 #include <src/video.h>
 
 #include <tests/conftest.cpp>
 
+using namespace std::literals;
+
 class EncoderTest: public virtual BaseTest, public PlatformInitBase, public ::testing::WithParamInterface<std::tuple<std::basic_string_view<char>, video::encoder_t *>> {
 protected:
   void
@@ -61,3 +65,160 @@ INSTANTIATE_TEST_SUITE_P(
 TEST_P(EncoderTest, ValidateEncoder) {
   // todo:: test something besides fixture setup
 }
+
+namespace {
+  video::config_t
+  make_config(int bitrate) {
+    return { 1920, 1080, 60, bitrate, 1, 1, 0, 0, 0 };
+  }
+
+  video::packet_t
+  make_frame(std::int64_t index, bool idr = false) {
+    return std::make_unique<video::packet_raw_generic>(std::vector<uint8_t>(100), index, idr);
+  }
+
+  /**
+   * @brief A session of a shared encoder, with its own mail and frame queue.
+   */
+  struct viewer_t {
+    explicit viewer_t(int bitrate):
+        mail { std::make_shared<safe::mail_raw_t>() },
+        packets { 16, 1024 * 1024, 1h, [](std::int64_t, std::int64_t) {} },
+        subscriber { std::make_shared<video::encode_subscriber_t>(video::encode_subscriber_t {
+          mail->event<bool>(mail::shutdown),
+          &packets,
+          mail->event<bool>(mail::idr),
+          mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames),
+          mail->event<int>(mail::bitrate),
+          mail->event<bool>(mail::fixed_bitrate),
+          mail->event<video::hdr_info_t>(mail::hdr),
+          mail->event<input::touch_port_t>(mail::touch_port),
+          this,
+          std::nullopt,
+          bitrate,
+        }) } {}
+
+    /**
+     * @brief Get the frame indices the session received so far.
+     */
+    std::vector<std::int64_t>
+    drain() {
+      std::vector<std::int64_t> frames;
+      while (packets.peek()) {
+        auto packet = packets.pop();
+        EXPECT_EQ(packet->channel_data, this);
+        frames.emplace_back(packet->frame_index());
+      }
+      return frames;
+    }
+
+    safe::mail_t mail;
+    video::frame_queue_t packets;
+    std::shared_ptr<video::encode_subscriber_t> subscriber;
+  };
+
+  /**
+   * @brief Add sessions to a shared encoder without starting its thread.
+   */
+  void
+  join(video::shared_encode_ctx_t &ctx, std::initializer_list<viewer_t *> viewers) {
+    auto lg = ctx.subscribers.lock();
+    for (auto viewer : viewers) {
+      ctx.subscribers->emplace_back(viewer->subscriber);
+    }
+  }
+}  // namespace
+
+TEST(SharedEncodeTests, MergesIdrRequestsTest) {
+  video::shared_encode_ctx_t ctx { make_config(20000) };
+  viewer_t viewer1 { 20000 }, viewer2 { 20000 }, viewer3 { 20000 };
+  join(ctx, { &viewer1, &viewer2, &viewer3 });
+
+  EXPECT_FALSE(video::merge_requests(ctx).idr);
+
+  // A key frame for one session is a key frame for all of them
+  viewer2.subscriber->idr_events->raise(true);
+  viewer3.subscriber->idr_events->raise(true);
+  EXPECT_TRUE(video::merge_requests(ctx).idr);
+
+  // The requests were taken
+  EXPECT_FALSE(video::merge_requests(ctx).idr);
+}
+
+TEST(SharedEncodeTests, LowestBitrateWinsTest) {
+  video::shared_encode_ctx_t ctx { make_config(20000) };
+  viewer_t viewer1 { 20000 }, viewer2 { 20000 }, viewer3 { 20000 };
+  join(ctx, { &viewer1, &viewer2, &viewer3 });
+
+  EXPECT_EQ(video::merge_requests(ctx).bitrate, 20000);
+
+  viewer1.subscriber->bitrate_events->raise(15000);
+  viewer2.subscriber->bitrate_events->raise(8000);
+  EXPECT_EQ(video::merge_requests(ctx).bitrate, 8000);
+
+  // A session's bitrate holds until it asks for another one
+  EXPECT_EQ(video::merge_requests(ctx).bitrate, 8000);
+
+  viewer2.subscriber->bitrate_events->raise(30000);
+  EXPECT_EQ(video::merge_requests(ctx).bitrate, 15000);
+
+  // Once the most congested session is gone, the others get their bitrate back
+  video::unsubscribe(ctx, viewer1.subscriber);
+  EXPECT_EQ(video::merge_requests(ctx).bitrate, 20000);
+}
+
+TEST(SharedEncodeTests, MergesInvalidatedFramesTest) {
+  video::shared_encode_ctx_t ctx { make_config(20000) };
+  viewer_t viewer1 { 20000 }, viewer2 { 20000 }, viewer3 { 20000 };
+  join(ctx, { &viewer1, &viewer2, &viewer3 });
+
+  viewer1.subscriber->frame_offset = 10;
+  viewer2.subscriber->frame_offset = 40;
+
+  // Each range is translated to the encoder's frame indices, then combined
+  viewer1.subscriber->invalidate_ref_frames_events->raise(std::make_pair(3, 5));
+  viewer2.subscriber->invalidate_ref_frames_events->raise(std::make_pair(1, 2));
+
+  // The third session hasn't received a key frame yet, so it has nothing to invalidate
+  viewer3.subscriber->invalidate_ref_frames_events->raise(std::make_pair(100, 200));
+
+  auto requests = video::merge_requests(ctx);
+  ASSERT_TRUE(requests.invalidate_ref_frames);
+  EXPECT_EQ(*requests.invalidate_ref_frames, (std::pair<int64_t, int64_t> { 13, 42 }));
+  EXPECT_FALSE(requests.idr);
+
+  EXPECT_FALSE(video::merge_requests(ctx).invalidate_ref_frames);
+}
+
+TEST(SharedEncodeTests, FanOutAfterDetachTest) {
+  video::shared_encode_ctx_t ctx { make_config(20000) };
+  viewer_t viewer1 { 20000 }, viewer2 { 20000 }, viewer3 { 20000 };
+  join(ctx, { &viewer1, &viewer2, &viewer3 });
+
+  video::fan_out(ctx, make_frame(1, true));
+  video::fan_out(ctx, make_frame(2));
+  video::fan_out(ctx, make_frame(3));
+
+  // A session leaves in the middle of the stream
+  video::unsubscribe(ctx, viewer2.subscriber);
+
+  video::fan_out(ctx, make_frame(4));
+  video::fan_out(ctx, make_frame(5));
+
+  EXPECT_EQ(viewer1.drain(), (std::vector<std::int64_t> { 1, 2, 3, 4, 5 }));
+  EXPECT_EQ(viewer2.drain(), (std::vector<std::int64_t> { 1, 2, 3 }));
+  EXPECT_EQ(viewer3.drain(), (std::vector<std::int64_t> { 1, 2, 3, 4, 5 }));
+
+  // The encoder keeps its frame indices, the session that joins late counts from its first key frame
+  viewer_t viewer4 { 20000 };
+  join(ctx, { &viewer4 });
+
+  video::fan_out(ctx, make_frame(6));
+  video::fan_out(ctx, make_frame(7, true));
+  video::fan_out(ctx, make_frame(8));
+
+  EXPECT_EQ(viewer1.drain(), (std::vector<std::int64_t> { 6, 7, 8 }));
+  EXPECT_TRUE(viewer2.drain().empty());
+  EXPECT_EQ(viewer3.drain(), (std::vector<std::int64_t> { 6, 7, 8 }));
+  EXPECT_EQ(viewer4.drain(), (std::vector<std::int64_t> { 1, 2 }));
+}